@@ -6,6 +6,8 @@
 #include "cinder/Timeline.h"
 #include "cinder/CameraUi.h"
 #include "glm/gtx/matrix_decompose.hpp"
+#include "InstanceBuffer.h"
+#include "InstanceCuller.h"
 
 using namespace ci;
 using namespace ci::app;
@@ -86,19 +88,29 @@ class ImageTransitionsApp : public App {
 	CameraUi	mCamUi;
 	Anim<vec3>  mEyePt;
 	
-	gl::GlslProgRef mShader;
-	ci::gl::VboRef            mInstanceDataVbo;
-	ci::gl::BatchRef		  mBatch;
-	std::vector<InstanceOptions> mOptions;
-	bool			   mIsPaused = false;
-	ci::TimelineRef	   mTimeline;
-	
 	typedef struct InstanceData {
 		ci::mat4 transform;
 		ci::vec4 color;
 		ci::vec4 texBounds;
+
+		static std::vector<InstanceField> getFields()
+		{
+			return { INSTANCE_FIELD( InstanceData, transform, geom::Attrib::CUSTOM_0, "vInstanceTransform" ),
+					 INSTANCE_FIELD( InstanceData, color, geom::Attrib::CUSTOM_1, "vInstanceData" ),
+					 INSTANCE_FIELD( InstanceData, texBounds, geom::Attrib::CUSTOM_2, "vTexCoord" ) };
+		}
 	} InstanceData;
 	
+	gl::GlslProgRef mShader;
+	std::unique_ptr<InstanceBuffer<InstanceData>> mInstances;	// created in setup, once there's a context
+	InstanceCuller			mCuller;
+	std::vector<float>		mBoundsX, mBoundsY, mBoundsZ, mBoundsRadius;
+	std::vector<uint32_t>	mVisible;
+	ci::gl::BatchRef		  mBatch;
+	std::vector<InstanceOptions> mOptions;
+	bool			   mIsPaused = false;
+	ci::TimelineRef	   mTimeline;
+	
 	
 	ci::Anim<float>	mDepthAnim;
 	ci::Anim<float> mCamRotation;
@@ -112,23 +124,14 @@ void ImageTransitionsApp::setup()
 	
 	// Generate array of quads to fill the screen
 	
-	std::vector<InstanceData> instances;
-	
-	// CREATE maximum size instance data buffer.
-	instances.resize( kMaxCount, InstanceData() );
-
-	// DESCRIBE the shader attributes, whcih matches up with how InstanceData is described.
-	geom::BufferLayout instanceDataLayout;
-	instanceDataLayout.append( geom::Attrib::CUSTOM_0, sizeof( mat4 ) / sizeof( float ), sizeof( InstanceData ), offsetof( InstanceData, transform ), 1 /* per instance */ );
-	instanceDataLayout.append( geom::Attrib::CUSTOM_1, sizeof( vec4 ) / sizeof( float ), sizeof( InstanceData ), offsetof( InstanceData, color ), 1 /* per instance */ );
-	instanceDataLayout.append( geom::Attrib::CUSTOM_2, sizeof( vec4 ) / sizeof( float ), sizeof( InstanceData ), offsetof( InstanceData, texBounds ), 1 /* per instance */ );
+	// CREATE maximum size instance data buffer, its layout comes from InstanceData::getFields().
+	mInstances.reset( new InstanceBuffer<InstanceData>( kMaxCount ) );
 	
 	// CREATE instanced batch.
 	mShader = gl::GlslProg::create( loadAsset( "texQuad.vert" ), loadAsset( "texQuad.frag" ) );
-	mInstanceDataVbo = gl::Vbo::create( GL_ARRAY_BUFFER, instances.size() * sizeof( InstanceData ), instances.data(), GL_STATIC_DRAW );
 	auto mesh = gl::VboMesh::create( geom::Rect( Rectf( 0, 0, 1.0, 1.0 ) ) );
-	mesh->appendVbo( instanceDataLayout, mInstanceDataVbo );
-	mBatch = gl::Batch::create( mesh, mShader, { { geom::Attrib::CUSTOM_0, "vInstanceTransform" }, { geom::Attrib::CUSTOM_1, "vInstanceData" }, { geom::Attrib::CUSTOM_2, "vTexCoord" } } );
+	mInstances->appendTo( mesh );
+	mBatch = gl::Batch::create( mesh, mShader, InstanceBuffer<InstanceData>::getAttributeMapping() );
 	
 	// DEFINE the arrow properties
 	Rand::randomize();
@@ -265,13 +268,14 @@ void ImageTransitionsApp::update()
 	mCam.setEyePoint( pt );
 	mCam.lookAt( vec3() );
 	
-	// UPDATE all of the positions of the arrows
-	auto  ptr = (InstanceData *)mInstanceDataVbo->mapReplace();
-	int   count = 0;
-
+	// UPDATE all of the positions of the tiles
+	mBoundsX.resize( kMaxCount );
+	mBoundsY.resize( kMaxCount );
+	mBoundsZ.resize( kMaxCount );
+	mBoundsRadius.resize( kMaxCount, 2.5f * float( M_SQRT2 ) );
 	for( int i = 0; i < kMaxCount; ++i ) {
 
-		auto options = mOptions[count];
+		auto options = mOptions[i];
 		vec3 position = options.getPosition();
 		position.z = options.getDepthFactor() * mDepthAnim();
 		
@@ -281,7 +285,23 @@ void ImageTransitionsApp::update()
 			position.y = randFloat( getWindowHeight() );
 		}*/
 		
-		ptr->transform = glm::translate( position );
+		// BOUND the 5 by 5 tile with a sphere around its center
+		mBoundsX[i] = position.x + 2.5f;
+		mBoundsY[i] = position.y + 2.5f;
+		mBoundsZ[i] = position.z;
+		
+		// UPDATE object
+		mOptions[i] = options.position( position );
+	}
+	
+	// CULL the tiles the camera can't see, only the rest is written and drawn
+	mCuller.setFrustum( mCam.getProjectionMatrix() * mCam.getViewMatrix() );
+	size_t count = mCuller.cull( mBoundsX.data(), mBoundsY.data(), mBoundsZ.data(), mBoundsRadius.data(), kMaxCount, &mVisible );
+	
+	auto ptr = mInstances->map( count );
+	for( size_t i = 0; i < count; ++i ) {
+		const auto &options = mOptions[mVisible[i]];
+		ptr->transform = glm::translate( options.getPosition() );
 		ptr->transform *= glm::scale( vec3( 5.0 ) );
 
 		ColorA color = ColorA( Color( options.getColor() ), 1.0f );
@@ -289,13 +309,9 @@ void ImageTransitionsApp::update()
 		Rectf area = options.getTexCoords();
 		vec4  texCoords = vec4( area.getX1(), area.getY1(), area.getWidth(), area.getHeight() );
 		ptr->texBounds = texCoords;
-		
-		// UPDATE object
-		mOptions[count] = options.position( position );
 		ptr++;
-		count++;
 	}
-	mInstanceDataVbo->unmap();
+	mInstances->unmap();
 	
 }
 
@@ -323,19 +339,27 @@ void ImageTransitionsApp::draw()
 	{
 		gl::cullFace( GL_FRONT );
 		gl::ScopedTextureBind scpTex0( mTexture1, 0 );
-		mBatch->drawInstanced( kMaxCount );
+		mBatch->drawInstanced( GLsizei( mInstances->getCount() ) );
 	}
 	
 	{
 		gl::cullFace( GL_BACK );
 		gl::ScopedTextureBind scpTex0( mTexture2, 0 );
-		mBatch->drawInstanced( kMaxCount );
+		mBatch->drawInstanced( GLsizei( mInstances->getCount() ) );
 	}
 	
 	
 	// draw front with culled back
 	
 	// draw back with culled front
+	
+	// SHOW how many tiles the frustum culling kept
+	{
+		gl::ScopedFaceCulling scpNoCull( false );
+		gl::ScopedDepth scpNoDepth( false );
+		gl::setMatricesWindow( getWindowSize() );
+		gl::drawString( "drawn " + to_string( mCuller.getDrawn() ) + ", culled " + to_string( mCuller.getCulled() ), vec2( 10, 10 ) );
+	}
 }
 
 CINDER_APP( ImageTransitionsApp, RendererGl )
@@ -6,24 +6,27 @@ uniform mat3 ciNormalMatrix;
 uniform mat4 ciModelViewProjection;
 
 uniform vec2 uOffset = vec2( 0.0, 0.0 );
+uniform samplerBuffer uStyles;	// color, then texture bounds, for every arrow
 
 in vec4 ciPosition;
 in vec4 ciColor;
 in vec2 ciTexCoord0;
 
-in mat4 vInstanceTransform;
-in vec4 vInstanceData;
-in vec4 vTexCoord;
+in vec4  vInstancePosition;	// xyz, w is the scale
+in float vInstanceStyle;
 
 out vec4 vertColor;
 out vec2 texCoord;
 
 void main(void)
 {
-	mat4 viewMatrix = ciModelView * vInstanceTransform;
-	vec4 vertPosition = viewMatrix * ciPosition;
-	vertColor = vInstanceData * ciColor;
-	texCoord = ciTexCoord0 * vTexCoord.zw + vTexCoord.xy;
+	int  style = int( vInstanceStyle ) * 2;
+	vec4 color = texelFetch( uStyles, style );
+	vec4 texBounds = texelFetch( uStyles, style + 1 );
+
+	vec4 vertPosition = ciModelView * vec4( ciPosition.xyz * vInstancePosition.w + vInstancePosition.xyz, 1.0 );
+	vertColor = color * ciColor;
+	texCoord = ciTexCoord0 * texBounds.zw + texBounds.xy;
 
     gl_Position = ciProjectionMatrix * vertPosition + vec4( uOffset, 0.0, 0.0 );
 }
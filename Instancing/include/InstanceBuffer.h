@@ -0,0 +1,134 @@
+//
+//  InstanceBuffer.h
+//  Instancing
+//
+//  Per-instance vertex data whose buffer layout and shader attribute names
+//  come from a field list on the instance struct itself, instead of being
+//  written out by hand next to every instanced batch. Capacity grows
+//  geometrically. Header only, so other samples can include it as is.
+//
+
+#pragma once
+
+#include "cinder/gl/Batch.h"
+#include "cinder/gl/Vbo.h"
+#include "cinder/gl/VboMesh.h"
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+//! One member of a per-instance struct: the attribute it feeds, its name in the shader and where it lives.
+struct InstanceField {
+	ci::geom::Attrib attrib;
+	const char      *name;
+	uint8_t          dims;		// floats
+	size_t           offset;
+};
+
+//! Describes \a member of \a Type. Its size and offset are taken from the struct, so they can't go stale.
+#define INSTANCE_FIELD( Type, member, attrib, name ) \
+	InstanceField{ attrib, name, uint8_t( sizeof( decltype( Type::member ) ) / sizeof( float ) ), offsetof( Type, member ) }
+
+//! Buffer of \a T, one per instance. \a T lists its members with a static getFields(), e.g.
+//!
+//!     struct InstanceData {
+//!         ci::mat4 transform;
+//!         static std::vector<InstanceField> getFields()
+//!         {
+//!             return { INSTANCE_FIELD( InstanceData, transform, ci::geom::Attrib::CUSTOM_0, "vInstanceTransform" ) };
+//!         }
+//!     };
+template<typename T>
+class InstanceBuffer {
+	static_assert( std::is_standard_layout<T>::value, "instance data needs a standard layout for offsetof" );
+	static_assert( sizeof( T ) % sizeof( float ) == 0, "instance data is read as floats" );
+
+  public:
+	InstanceBuffer( size_t capacity = 1024, GLenum usage = GL_DYNAMIC_DRAW )
+	    : mCount( 0 )
+	    , mCapacity( std::max<size_t>( capacity, 1 ) )
+	{
+		mVbo = ci::gl::Vbo::create( GL_ARRAY_BUFFER, mCapacity * sizeof( T ), nullptr, usage );
+	}
+
+	//! Makes room for at least \a count instances, at least doubling the capacity when it grows. The GL buffer
+	//! stays the same, so meshes it was appended to keep working, but its contents are dropped.
+	void reserve( size_t count )
+	{
+		if( count <= mCapacity )
+			return;
+
+		mCapacity = std::max( count, mCapacity * 2 );
+		mVbo->ensureMinimumSize( mCapacity * sizeof( T ) );
+	}
+
+	//! Maps \a count instances for writing and replaces whatever was there. Call unmap() once they're written.
+	T *map( size_t count )
+	{
+		reserve( count );
+		mCount = count;
+		if( count == 0 )
+			return nullptr;
+
+		return static_cast<T *>( mVbo->mapBufferRange( 0, count * sizeof( T ), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT ) );
+	}
+
+	void unmap()
+	{
+		if( mCount > 0 )
+			mVbo->unmap();
+	}
+
+	//! Leaves nothing to draw, without touching the buffer.
+	void clear() { mCount = 0; }
+
+	//! Replaces the contents with \a instances.
+	void set( const std::vector<T> &instances )
+	{
+		reserve( instances.size() );
+		mCount = instances.size();
+		if( mCount > 0 )
+			mVbo->bufferSubData( 0, mCount * sizeof( T ), instances.data() );
+	}
+
+	//! Adds the buffer to \a mesh as per-instance attributes.
+	void appendTo( const ci::gl::VboMeshRef &mesh ) const { mesh->appendVbo( getLayout(), mVbo ); }
+
+	size_t                   getCount() const { return mCount; }
+	size_t                   getCapacity() const { return mCapacity; }
+	const ci::gl::VboRef    &getVbo() const { return mVbo; }
+
+	//! Layout of \a T, built once from its fields.
+	static const ci::geom::BufferLayout &getLayout()
+	{
+		static const ci::geom::BufferLayout layout = makeLayout();
+		return layout;
+	}
+
+	//! Shader names of the fields of \a T, for gl::Batch::create().
+	static ci::gl::Batch::AttributeMapping getAttributeMapping()
+	{
+		ci::gl::Batch::AttributeMapping mapping;
+		for( const auto &field : T::getFields() )
+			mapping[field.attrib] = field.name;
+		return mapping;
+	}
+
+	//! Layout of \a T for instances starting \a offset bytes into a buffer.
+	static ci::geom::BufferLayout makeLayout( size_t offset = 0 )
+	{
+		ci::geom::BufferLayout layout;
+		for( const auto &field : T::getFields() ) {
+			assert( field.offset + field.dims * sizeof( float ) <= sizeof( T ) );
+			layout.append( field.attrib, field.dims, sizeof( T ), offset + field.offset, 1 /* per instance */ );
+		}
+		return layout;
+	}
+
+  private:
+
+	ci::gl::VboRef mVbo;
+	size_t         mCount;
+	size_t         mCapacity;
+};
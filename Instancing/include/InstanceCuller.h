@@ -0,0 +1,131 @@
+//
+//  InstanceCuller.h
+//  Instancing
+//
+//  Tests instance bounding spheres against the view frustum and returns the
+//  indices of the ones that can be seen, in order, so only those get written
+//  to the instance buffer and drawn. The spheres come in as separate x, y, z
+//  and radius arrays and are tested in fixed size batches with branch free
+//  loops the compiler can vectorize; large counts are split across threads.
+//  Header only, like InstanceBuffer. The split is done here rather than with
+//  a parallelFor like SpiderWeb's, because each chunk compacts into its own
+//  slice of the output and the slices are joined by chunk index afterwards.
+//
+
+#pragma once
+
+#include "cinder/Vector.h"
+#include "cinder/Matrix.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+class InstanceCuller {
+  public:
+	InstanceCuller()
+	    : mDrawn( 0 )
+	    , mCulled( 0 )
+	{
+		for( auto &plane : mPlanes )
+			plane = ci::vec4( 0 );
+	}
+
+	//! Takes the frustum planes from \a viewProjection, which maps the spheres' space to clip space.
+	void setFrustum( const ci::mat4 &viewProjection )
+	{
+		// left, right, bottom, top, near, far: the rows of the matrix added to or taken from the w row
+		const ci::mat4 &m = viewProjection;
+		ci::vec4 row[4];
+		for( int i = 0; i < 4; ++i )
+			row[i] = ci::vec4( m[0][i], m[1][i], m[2][i], m[3][i] );
+		mPlanes[0] = row[3] + row[0];
+		mPlanes[1] = row[3] - row[0];
+		mPlanes[2] = row[3] + row[1];
+		mPlanes[3] = row[3] - row[1];
+		mPlanes[4] = row[3] + row[2];
+		mPlanes[5] = row[3] - row[2];
+
+		// NORMALIZE, so a plane's distance can be compared with a radius
+		for( auto &plane : mPlanes )
+			plane /= glm::length( ci::vec3( plane ) );
+	}
+
+	//! Writes the indices of the spheres at least partly inside the frustum to \a visible and returns how many
+	//! there are. \a z can be null for spheres in the z = 0 plane.
+	size_t cull( const float *x, const float *y, const float *z, const float *radius, size_t count, std::vector<uint32_t> *visible )
+	{
+		visible->resize( count );
+		if( count == 0 ) {
+			mDrawn = mCulled = 0;
+			return 0;
+		}
+
+		// SPLIT across threads once there's enough work, each chunk compacts into its own slice of the output
+		size_t workers = std::min<size_t>( std::max<unsigned>( std::thread::hardware_concurrency(), 1 ), ( count + kParallelGrain - 1 ) / kParallelGrain );
+		size_t chunk = ( count + workers - 1 ) / workers;
+		std::vector<size_t> found( workers, 0 );
+		std::vector<std::thread> threads;
+		for( size_t w = 1; w < workers; ++w ) {
+			size_t begin = std::min( w * chunk, count );
+			size_t end = std::min( begin + chunk, count );
+			threads.emplace_back( [=, &found] { found[w] = cullRange( x, y, z, radius, begin, end, visible->data() + begin ); } );
+		}
+		found[0] = cullRange( x, y, z, radius, 0, std::min( chunk, count ), visible->data() );
+		for( auto &thread : threads )
+			thread.join();
+
+		// CLOSE the gaps between the slices
+		size_t drawn = found[0];
+		for( size_t w = 1; w < workers; ++w ) {
+			std::memmove( visible->data() + drawn, visible->data() + std::min( w * chunk, count ), found[w] * sizeof( uint32_t ) );
+			drawn += found[w];
+		}
+		visible->resize( drawn );
+
+		mDrawn = drawn;
+		mCulled = count - drawn;
+		return drawn;
+	}
+
+	//! Instances kept and dropped by the last cull().
+	size_t getDrawn() const { return mDrawn; }
+	size_t getCulled() const { return mCulled; }
+
+  private:
+	static const size_t kBatchSize = 256;
+	static const size_t kParallelGrain = 1 << 16;
+
+	size_t cullRange( const float *x, const float *y, const float *z, const float *radius, size_t begin, size_t end, uint32_t *out ) const
+	{
+		size_t  found = 0;
+		uint8_t inside[kBatchSize];
+		float   zeros[kBatchSize] = {};
+		for( size_t batch = begin; batch < end; batch += kBatchSize ) {
+			size_t n = ( end - batch < kBatchSize ) ? end - batch : kBatchSize;
+			const float *bx = x + batch;
+			const float *by = y + batch;
+			const float *bz = z ? z + batch : zeros;
+			const float *br = radius + batch;
+
+			// TEST one plane at a time over the whole batch, no branches so it vectorizes
+			std::fill( inside, inside + n, uint8_t( 1 ) );
+			for( const auto &p : mPlanes ) {
+				for( size_t i = 0; i < n; ++i )
+					inside[i] &= uint8_t( p.x * bx[i] + p.y * by[i] + p.z * bz[i] + p.w + br[i] >= 0.0f );
+			}
+
+			// COMPACT, every index is written and only the visible ones move the cursor on
+			for( size_t i = 0; i < n; ++i ) {
+				out[found] = uint32_t( batch + i );
+				found += inside[i];
+			}
+		}
+		return found;
+	}
+
+	ci::vec4 mPlanes[6];	// xyz inwards normal, w distance
+	size_t   mDrawn;
+	size_t   mCulled;
+};
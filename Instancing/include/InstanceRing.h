@@ -0,0 +1,149 @@
+//
+//  InstanceRing.h
+//  Instancing
+//
+//  Per-instance data streamed through one buffer split into three frame
+//  regions. Each frame writes the region the GPU finished with longest ago,
+//  and a fence per region makes sure it really has, so the CPU never writes
+//  over data a draw is still reading and the driver never has to orphan or
+//  synchronize behind our back. Where GL_ARB_buffer_storage is available the
+//  buffer is mapped persistently, once; otherwise each region is mapped
+//  unsynchronized, which the fences make just as safe.
+//
+
+#pragma once
+
+#include "cinder/gl/Vbo.h"
+#include "cinder/gl/scoped.h"
+#include "cinder/gl/wrapper.h"
+#include "cinder/Timer.h"
+#include "InstanceBuffer.h"
+
+template<typename T>
+class InstanceRing {
+  public:
+	static const size_t kRegionCount = 3;
+
+	InstanceRing( size_t capacity )
+	    : mCapacity( std::max<size_t>( capacity, 1 ) )
+	    , mCount( 0 )
+	    , mRegion( 0 )
+	    , mMapped( nullptr )
+	    , mStalls( 0 )
+	    , mWaitSeconds( 0.0 )
+	{
+		for( auto &fence : mFences )
+			fence = nullptr;
+
+		GLsizeiptr bytes = GLsizeiptr( kRegionCount * mCapacity * sizeof( T ) );
+#if defined( GL_MAP_PERSISTENT_BIT )
+		if( ci::gl::isExtensionAvailable( "GL_ARB_buffer_storage" ) ) {
+			// MAP once, coherent, so writes land without a flush
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			mVbo = ci::gl::Vbo::create( GL_ARRAY_BUFFER );
+			ci::gl::ScopedBuffer scpBuffer( mVbo );
+			glBufferStorage( GL_ARRAY_BUFFER, bytes, nullptr, flags );
+			mMapped = static_cast<T *>( glMapBufferRange( GL_ARRAY_BUFFER, 0, bytes, flags ) );
+			return;
+		}
+#endif
+		mVbo = ci::gl::Vbo::create( GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW );
+	}
+
+	~InstanceRing()
+	{
+		for( auto &fence : mFences ) {
+			if( fence )
+				glDeleteSync( fence );
+		}
+
+		if( mMapped ) {
+			ci::gl::ScopedBuffer scpBuffer( mVbo );
+			glUnmapBuffer( GL_ARRAY_BUFFER );
+		}
+	}
+
+	//! Moves on to the next region and returns it for \a count instances, waiting only if the GPU is still reading
+	//! it from three frames ago. \a count can't be more than the capacity. Call unmap() once they're written.
+	T *map( size_t count )
+	{
+		assert( count <= mCapacity );
+
+		mRegion = ( mRegion + 1 ) % kRegionCount;
+		waitFor( mRegion );
+		mCount = count;
+		if( count == 0 )
+			return nullptr;
+
+		if( mMapped )
+			return mMapped + mRegion * mCapacity;
+
+		return static_cast<T *>( mVbo->mapBufferRange( getRegionOffset( mRegion ), count * sizeof( T ),
+		                                               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT ) );
+	}
+
+	void unmap()
+	{
+		if( ! mMapped && mCount > 0 )
+			mVbo->unmap();
+	}
+
+	//! Leaves nothing to draw.
+	void clear() { mCount = 0; }
+
+	//! Marks the current region as in use by the draws issued so far. Call it after drawing.
+	void fence()
+	{
+		GLsync &fence = mFences[mRegion];
+		if( fence )
+			glDeleteSync( fence );
+		fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	}
+
+	//! Region written by the last map(), the one to draw.
+	size_t getRegion() const { return mRegion; }
+	//! Byte offset of \a region in the buffer.
+	size_t getRegionOffset( size_t region ) const { return region * mCapacity * sizeof( T ); }
+	//! Layout of \a region, for a mesh that draws it.
+	ci::geom::BufferLayout getLayout( size_t region ) const { return InstanceBuffer<T>::makeLayout( getRegionOffset( region ) ); }
+
+	size_t                getCount() const { return mCount; }
+	size_t                getCapacity() const { return mCapacity; }
+	bool                  isPersistent() const { return mMapped != nullptr; }
+	const ci::gl::VboRef &getVbo() const { return mVbo; }
+
+	//! Times map() had to wait on the GPU, and for how long in total.
+	size_t getStalls() const { return mStalls; }
+	double getWaitSeconds() const { return mWaitSeconds; }
+
+  private:
+	void waitFor( size_t region )
+	{
+		GLsync &fence = mFences[region];
+		if( ! fence )
+			return;
+
+		// POLL first, a region three frames old is nearly always done with
+		GLenum result = glClientWaitSync( fence, 0, 0 );
+		if( result == GL_TIMEOUT_EXPIRED ) {
+			ci::Timer timer( true );
+			while( result == GL_TIMEOUT_EXPIRED )
+				result = glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 /* 1ms */ );
+			mWaitSeconds += timer.getSeconds();
+			mStalls++;
+		}
+
+		glDeleteSync( fence );
+		fence = nullptr;
+	}
+
+	ci::gl::VboRef mVbo;
+	size_t         mCapacity;	// instances per region
+	size_t         mCount;
+	size_t         mRegion;
+	T             *mMapped;		// the whole buffer, when it's persistently mapped
+	GLsync         mFences[kRegionCount];
+
+	size_t mStalls;
+	double mWaitSeconds;
+};
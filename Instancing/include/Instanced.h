@@ -7,39 +7,172 @@
 #include "cinder/gl/Batch.h"
 #include "cinder/gl/Vbo.h"
 #include "cinder/gl/VboMesh.h"
+#include "cinder/Timer.h"
+#include "InstanceBuffer.h"
+#include "InstanceRing.h"
+#include <memory>
 
+//! Batch drawn once per instance of \a T, see InstanceBuffer for what \a T has to provide. Subclasses write their
+//! instances between mapInstances() and unmapInstances(), which either replace a single buffer or, when streaming,
+//! fill the next region of an InstanceRing.
+template<typename T>
 class InstancedBase {
   public:
-	struct Data {
-		ci::mat4 transform;
-		ci::vec4 data;
-	};
-
-  public:
-	InstancedBase( size_t maxCount = 1024 );
+	InstancedBase( size_t capacity = 1024 )
+	    : mInstances( capacity )
+	    , mUploadSeconds( 0.0 )
+	    , mUploadCount( 0 )
+	{
+	}
 	virtual ~InstancedBase() {}
 
 	virtual void update( double elapsed = 0.0 ) = 0;
 
 	//! Draws the batch.
-	virtual void draw();
+	virtual void draw()
+	{
+		if( mRing ) {
+			if( mRing->getCount() > 0 ) {
+				// the region's offset is baked into its batch's attribute pointers
+				mRingBatches[mRing->getRegion()]->drawInstanced( GLsizei( mRing->getCount() ) );
+				mRing->fence();
+			}
+		}
+		else if( mBatch && mInstances.getCount() > 0 ) {
+			mBatch->drawInstanced( GLsizei( mInstances.getCount() ) );
+		}
+	}
 	//! Replaces the batch's shader.
-	virtual void replaceGlslProg( const ci::gl::GlslProgRef &glsl );
+	virtual void replaceGlslProg( const ci::gl::GlslProgRef &glsl )
+	{
+		mGlsl = glsl;
+		if( mBatch )
+			mBatch->replaceGlslProg( glsl );
+		for( auto &batch : mRingBatches )
+			batch->replaceGlslProg( glsl );
+	}
 
-  protected:
-	size_t mInstanceCount;
+	//! Streams the instances through a fenced, triple-buffered ring instead of replacing one buffer every update.
+	//! Whatever was written before is dropped, so call it before the next update.
+	virtual void setStreaming( bool streaming )
+	{
+		if( streaming == isStreaming() )
+			return;
+
+		if( streaming )
+			createRing( mInstances.getCapacity() );
+		else {
+			mRing.reset();
+			mRingBatches.clear();
+		}
+		mInstances.clear();
+	}
+	bool isStreaming() const { return mRing != nullptr; }
+
+	size_t getInstanceCount() const { return mRing ? mRing->getCount() : mInstances.getCount(); }
 
+	//! Average time spent writing the instances, including any wait for the GPU, since the last reset.
+	double getUploadMs() const { return mUploadCount > 0 ? 1000.0 * mUploadSeconds / mUploadCount : 0.0; }
+	//! Times the ring had to wait on the GPU.
+	size_t getStalls() const { return mRing ? mRing->getStalls() : 0; }
+	void   resetUploadStats()
+	{
+		mUploadSeconds = 0.0;
+		mUploadCount = 0;
+	}
+
+  protected:
 	//! Creates a batch from a geom::Source.
-	void createBatch( const ci::geom::Source &source, const ci::gl::GlslProgRef &glsl );
+	void createBatch( const ci::geom::Source &source, const ci::gl::GlslProgRef &glsl )
+	{
+		// Create mesh.
+		createBatch( ci::gl::VboMesh::create( source ), glsl );
+	}
+
+	//! Creates a batch from a VboMeshRef. \a mapping names the attributes of any buffers already appended to \a mesh.
+	void createBatch( const ci::gl::VboMeshRef &mesh, const ci::gl::GlslProgRef &glsl, ci::gl::Batch::AttributeMapping mapping = ci::gl::Batch::AttributeMapping() )
+	{
+		mMesh = mesh;
+		mGlsl = glsl;
+
+		auto instanceMapping = InstanceBuffer<T>::getAttributeMapping();
+		mapping.insert( instanceMapping.begin(), instanceMapping.end() );
+		mMapping = mapping;
+
+		// Create batch.
+		mBatch = ci::gl::Batch::create( withInstances( InstanceBuffer<T>::getLayout(), mInstances.getVbo() ), mGlsl, mMapping );
+		if( mRing )
+			createRing( mRing->getCapacity() );
+	}
 
-	//! Creates a batch from a VboMeshRef
-	void createBatch( const ci::gl::VboMeshRef &mesh, const ci::gl::GlslProgRef &glsl );
+	//! Returns room for \a count instances, growing the buffers if needed. Call unmapInstances() once they're written.
+	T *mapInstances( size_t count )
+	{
+		mUploadTimer.start();
+		if( ! mRing )
+			return mInstances.map( count );
+
+		// a ring can't grow in place, so a bigger one replaces it along with its batches
+		if( count > mRing->getCapacity() )
+			createRing( std::max( count, mRing->getCapacity() * 2 ) );
+		return mRing->map( count );
+	}
+
+	void unmapInstances()
+	{
+		if( mRing )
+			mRing->unmap();
+		else
+			mInstances.unmap();
+
+		mUploadTimer.stop();
+		mUploadSeconds += mUploadTimer.getSeconds();
+		mUploadCount++;
+	}
+
+	//! Leaves nothing to draw.
+	void clearInstances()
+	{
+		if( mRing )
+			mRing->clear();
+		mInstances.clear();
+	}
+
+  private:
+	//! A mesh sharing the vertices and indices of mMesh, with \a vbo added as per-instance data.
+	ci::gl::VboMeshRef withInstances( const ci::geom::BufferLayout &layout, const ci::gl::VboRef &vbo ) const
+	{
+		auto buffers = mMesh->getVertexArrayLayoutVbos();
+		buffers.push_back( std::make_pair( layout, vbo ) );
+		return ci::gl::VboMesh::create( mMesh->getNumVertices(), mMesh->getGlPrimitive(), buffers,
+		                                mMesh->getNumIndices(), mMesh->getIndexDataType(), mMesh->getIndexVbo() );
+	}
+
+	void createRing( size_t capacity )
+	{
+		mRing.reset( new InstanceRing<T>( capacity ) );
+		mRingBatches.clear();
+		if( ! mMesh )
+			return;
+
+		// one batch per region, each reading the ring from that region's offset
+		for( size_t region = 0; region < InstanceRing<T>::kRegionCount; ++region )
+			mRingBatches.push_back( ci::gl::Batch::create( withInstances( mRing->getLayout( region ), mRing->getVbo() ), mGlsl, mMapping ) );
+	}
 
   protected:
-	const size_t mMaxCount;
+	InstanceBuffer<T>  mInstances;
+
+	ci::gl::VboMeshRef mMesh;
+	ci::gl::BatchRef   mBatch;
+
+  private:
+	ci::gl::GlslProgRef                  mGlsl;
+	ci::gl::Batch::AttributeMapping      mMapping;
+	std::unique_ptr<InstanceRing<T>>     mRing;
+	std::vector<ci::gl::BatchRef>        mRingBatches;
 
-	ci::gl::VboMeshRef     mMesh;
-	ci::gl::BatchRef       mBatch;
-	ci::gl::VboRef         mDataVbo;
-	ci::geom::BufferLayout mLayout;
-};
\ No newline at end of file
+	ci::Timer mUploadTimer;
+	double    mUploadSeconds;
+	size_t    mUploadCount;
+};
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "cinder/Timeline.h"
+#include "cinder/gl/BufferTexture.h"
 #include "Instanced.h"
+#include "InstanceCuller.h"
+#include "SpriteAtlas.h"
 
 typedef std::shared_ptr<class InstancedArrows> InstancedArrowsRef;
 typedef std::shared_ptr<class InstancedDots>   InstancedDotsRef;
@@ -63,34 +66,96 @@ class ArrowOptions {
 };
 
 
+// ------------------------------------------------------------------------------------------------- Per-instance data
+
+//! Where an arrow is, rewritten every frame the arrows moved. Only the visible arrows are written when culling,
+//! so each one says which style it has.
+struct ArrowPosition {
+	ci::vec4 position;	// xyz, w is the scale
+	float    style;		// index into the style buffer
+
+	static std::vector<InstanceField> getFields()
+	{
+		return { INSTANCE_FIELD( ArrowPosition, position, ci::geom::Attrib::CUSTOM_0, "vInstancePosition" ),
+				 INSTANCE_FIELD( ArrowPosition, style, ci::geom::Attrib::CUSTOM_1, "vInstanceStyle" ) };
+	}
+};
+
+//! Never changes once the arrow is added, uploaded a single time. The shader fetches it from a buffer texture.
+struct ArrowStyle {
+	ci::vec4 color;
+	ci::vec4 texBounds;
+};
+
+struct DotInstance {
+	ci::mat4 transform;
+	ci::vec4 data;
+
+	static std::vector<InstanceField> getFields()
+	{
+		return { INSTANCE_FIELD( DotInstance, transform, ci::geom::Attrib::CUSTOM_0, "vInstanceTransform" ),
+				 INSTANCE_FIELD( DotInstance, data, ci::geom::Attrib::CUSTOM_1, "vInstanceData" ) };
+	}
+};
+
+
 // ------------------------------------------------------------------------------------------------- Instanced Arrows
 
-class InstancedArrows {
+class InstancedArrows : public InstancedBase<ArrowPosition> {
   public:
-	static InstancedArrowsRef create() { return std::make_shared<InstancedArrows>(); };
+	static InstancedArrowsRef create( size_t count = 30 ) { return std::make_shared<InstancedArrows>( count ); };
 	
-	InstancedArrows();
+	InstancedArrows( size_t count = 30 );
 	~InstancedArrows(){};
 	
-	typedef struct InstanceData {
-		ci::mat4 transform;
-		ci::vec4 color;
-		ci::vec4 texBounds;
-	} InstanceData;
+	//! Replaces the arrows with \a count new ones, the buffers grow to fit.
+	void setCount( size_t count );
+	size_t getCount() const { return mArrows.size(); }
 	
-	void update( double elapsed = 0.0 );
-	void draw();
+	//! Moves the arrows one fixed step. Only touches the CPU side, the positions are uploaded once per draw.
+	void update( double elapsed = 0.0 ) override;
+	void draw() override;
+	void setStreaming( bool streaming ) override;
+	
+	//! Only uploads and draws the arrows inside the view.
+	void setCulling( bool culling );
+	bool isCulling() const { return mIsCulling; }
+	const InstanceCuller &getCuller() const { return mCuller; }
 
   private:
+	//! Arrow properties stored field by field, so the update runs over tightly packed floats
+	struct ArrowStore {
+		std::vector<float>     positionsX;
+		std::vector<float>     positionsY;
+		std::vector<float>     speeds;
+		std::vector<float>     scales;
+		std::vector<float>     radii;		// bounding sphere around the arrow's corner
+		std::vector<ci::vec4>  colors;
+		std::vector<ci::vec4>  texBounds;	// x, y, width, height
+
+		size_t size() const { return positionsX.size(); }
+		void   clear();
+		void   reserve( size_t count );
+		void   push_back( const ArrowOptions &options );
+	};
+	
+	void upload();
+	
 	double					  mTime;
-	ci::gl::TextureRef	      mArrowTexture;
+	SpriteAtlas				  mAtlas;
+	ci::gl::TextureRef	      mArrowTexture;		// the atlas page the arrows are on
 	ci::gl::GlslProgRef       mShader;
-	ci::gl::VboRef            mInstanceDataVbo;
-	ci::gl::BatchRef		  mBatch;
-	std::vector<ArrowOptions> mOptions;
+	InstanceBuffer<ArrowStyle> mStyles;
+	std::vector<ci::Rectf>	  mAreas;			// sprites on the atlas page
+	ArrowStore				  mArrows;
+	bool					  mIsDirty;			// moved since the last upload
 	bool					  mIsPaused = false;
 	
-	static const int kMaxCount = 30;
+	ci::gl::BufferTextureRef  mStyleTexture;	// mStyles, two texels per arrow
+	InstanceCuller			  mCuller;
+	std::vector<uint32_t>	  mVisible;
+	ci::mat4				  mViewProjection;	// the frustum was last taken from this
+	bool					  mIsCulling = false;
 };
 
 
@@ -103,7 +168,7 @@ class InstancedDots {
 	InstancedDots();
 	~InstancedDots(){};
 	
-	class Dots : public InstancedBase {
+	class Dots : public InstancedBase<DotInstance> {
 	  public:
 		typedef struct DotData {
 			ci::vec2 direction;
@@ -114,7 +179,7 @@ class InstancedDots {
 	  public:
 		Dots();
 
-		void update( double elapsed = 0.0 );
+		void update( double elapsed = 0.0 ) override;
 
 	  private:
 		ci::gl::GlslProgRef  mShader;
@@ -128,6 +193,8 @@ class InstancedDots {
 	void update( double elapsed = 0.0 );
 	void draw();
 	
+	void setStreaming( bool streaming ) { mDots.setStreaming( streaming ); }
+	
   private:
   
 	const int kViewportSize = 150;
@@ -0,0 +1,97 @@
+//
+//  SpriteAtlas.h
+//  Instancing
+//
+//  Packs named sprite images onto as few texture pages as it can, so
+//  instances showing different sprites share a texture and a draw. Sprites
+//  are placed bottom-left on a skyline, each inside a gutter of its own edge
+//  pixels so filtering and the mip levels the content needs never pull in a
+//  neighbour.
+//  A packed atlas is written to a cache directory, the pages as PNGs with
+//  the placements next to them, and later launches with the same sources
+//  load that instead of packing again.
+//
+
+#pragma once
+
+#include "cinder/Area.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Surface.h"
+#include "cinder/gl/Texture.h"
+#include <map>
+#include <string>
+#include <vector>
+
+//! Where a sprite was packed
+typedef struct Sprite {
+	int      page;
+	ci::Area bounds;		// in the page's pixels, without the gutter
+	ci::vec4 texBounds;		// x, y, width, height in texture coordinates, the way the instance data wants them
+} Sprite;
+
+class SpriteAtlas {
+  public:
+	//! Pages are at most \a pageSize square. \a padding is left empty between neighbouring gutters. \a mipLevels is how
+	//! many levels below full size the sprites are drawn at, which sets the gutter to 2^mipLevels pixels.
+	SpriteAtlas( int pageSize = 2048, int padding = 2, int mipLevels = 4 );
+
+	//! Adds \a surface as \a name.
+	void   add( const std::string &name, const ci::Surface8u &surface );
+	//! Adds the image at \a path as \a name. It's only decoded if the atlas has to be packed.
+	void   add( const std::string &name, const ci::fs::path &path );
+	//! Adds every image in \a directory, named after its file without the extension. Returns how many it found.
+	size_t addDirectory( const ci::fs::path &directory );
+
+	//! Loads the atlas from \a cacheDirectory if it was packed from the same sources before, otherwise packs them and
+	//! writes the result there. Then creates the textures. An empty path always packs and never touches the disk.
+	bool build( const ci::fs::path &cacheDirectory = ci::fs::path() );
+
+	//! Returns the sprite called \a name, or nullptr.
+	const Sprite *find( const std::string &name ) const;
+	//! Texture bounds of \a name, the whole page if there is no such sprite.
+	ci::vec4      getTexBounds( const std::string &name ) const;
+
+	std::vector<std::string>  getNames() const;
+	size_t                    getPageCount() const { return mTextures.size(); }
+	const ci::gl::TextureRef &getTexture( int page ) const { return mTextures[page]; }
+	bool                      isFromCache() const { return mIsFromCache; }
+
+  private:
+	typedef struct Source {
+		std::string   name;
+		ci::Surface8u surface;	// or read from the path when packing
+		ci::fs::path  path;
+	} Source;
+
+	//! One segment of a page's skyline, the top edge of everything packed below it
+	typedef struct Segment {
+		int x, y, width;
+	} Segment;
+
+	typedef struct Page {
+		ci::Surface8u        surface;
+		std::vector<Segment> skyline;
+		ci::ivec2            used;		// the page is cropped to this once everything is packed
+	} Page;
+
+	uint64_t hashSources() const;
+	bool     pack();
+	bool     findPosition( const Page &page, const ci::ivec2 &size, ci::ivec2 *position, size_t *segment ) const;
+	void     place( Page *page, size_t segment, const ci::ivec2 &position, const ci::ivec2 &size );
+	void     blit( const ci::Surface8u &image, const ci::ivec2 &position, ci::Surface8u *page ) const;
+	void     updateTexBounds();
+
+	bool     save( const ci::fs::path &metadataFile ) const;
+	bool     load( const ci::fs::path &metadataFile );
+	static ci::fs::path getPageFile( const ci::fs::path &metadataFile, size_t page );
+
+	int                           mPageSize;
+	int                           mPadding;
+	int                           mMipLevels;
+	int                           mGutter;		// also what cells are aligned to, so every level splits them cleanly
+	std::vector<Source>           mSources;
+	std::map<std::string, Sprite> mSprites;
+	std::vector<ci::Surface8u>    mPages;		// dropped once the textures exist
+	std::vector<ci::gl::TextureRef> mTextures;
+	bool                          mIsFromCache;
+};
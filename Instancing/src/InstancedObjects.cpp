@@ -7,67 +7,83 @@
 #include "cinder/gl/GlslProg.h"
 #include "cinder/Rand.h"
 #include "cinder/Log.h"
+#include "cinder/Utilities.h"
 #include "InstancedObjects.h"
 
 using namespace ci;
 using namespace ci::app;
 using namespace std;
 
-InstancedArrows::InstancedArrows()
+InstancedArrows::InstancedArrows( size_t count )
+	: InstancedBase( count )
+	// the sprites are 800px wide and drawn 80 to 200px wide, so down to level 3.3
+	, mAtlas( 2048, 2, 4 )
+	, mStyles( count, GL_STATIC_DRAW )
+	, mIsDirty( false )
 {
 	mTime = 0.0;
 	
-	// LOAD the spritesheet texture
-	auto fmt = gl::Texture2d::Format().mipmap().minFilter( GL_LINEAR_MIPMAP_LINEAR ).wrap( GL_CLAMP_TO_EDGE ).loadTopDown();
-	mArrowTexture = gl::Texture::create( loadImage( loadAsset( "arrows.png" ) ), fmt );
-
-	// ADD the arrows to a vbo mesh
-	std::vector<InstanceData> instances;
+	// PACK the sprites into an atlas, later launches load the packed pages from the cache
+	mAtlas.addDirectory( getAssetPath( "sprites" ) );
+	mAtlas.build( getDocumentsDirectory() / "InstancingSpriteAtlas" );
 	
-	// CREATE maximum size instance data buffer.
-	instances.resize( kMaxCount, InstanceData() );
-
-	// DESCRIBE the shader attributes, whcih matches up with how InstanceData is described.
-	geom::BufferLayout instanceDataLayout;
-	instanceDataLayout.append( geom::Attrib::CUSTOM_0, sizeof( mat4 ) / sizeof( float ), sizeof( InstanceData ), offsetof( InstanceData, transform ), 1 /* per instance */ );
-	instanceDataLayout.append( geom::Attrib::CUSTOM_1, sizeof( vec4 ) / sizeof( float ), sizeof( InstanceData ), offsetof( InstanceData, color ), 1 /* per instance */ );
-	instanceDataLayout.append( geom::Attrib::CUSTOM_2, sizeof( vec4 ) / sizeof( float ), sizeof( InstanceData ), offsetof( InstanceData, texBounds ), 1 /* per instance */ );
-
-
-	// CREATE instanced batch.
+	// CREATE instanced batch. The positions are per instance, the styles are looked up by index from a buffer texture
 	mShader = gl::GlslProg::create( loadAsset( "arrows.vert" ), loadAsset( "arrows.frag" ) );
-	mInstanceDataVbo = gl::Vbo::create( GL_ARRAY_BUFFER, instances.size() * sizeof( InstanceData ), instances.data(), GL_STATIC_DRAW );
-	auto mesh = gl::VboMesh::create( geom::Rect( Rectf( 0, 0, 1.0, 0.25 ) ) );
-	mesh->appendVbo( instanceDataLayout, mInstanceDataVbo );
-	mBatch = gl::Batch::create( mesh, mShader, { { geom::Attrib::CUSTOM_0, "vInstanceTransform" }, { geom::Attrib::CUSTOM_1, "vInstanceData" }, { geom::Attrib::CUSTOM_2, "vTexCoord" } } );
-	
-	// DEFINE possible sprite sheet texture coords
-	ivec2 cellSize = ivec2( 800, 200 );
-	std::vector<Rectf> areas;
-	areas.resize( 4 );
-	areas[0] = mArrowTexture->getAreaTexCoords( Area( ivec2( 2, 2 ), ivec2( 2, 2 ) + cellSize ) );
-	areas[1] = mArrowTexture->getAreaTexCoords( Area( ivec2( 2, 204 ), ivec2( 2, 204 ) + cellSize ) );
-	areas[2] = mArrowTexture->getAreaTexCoords( Area( ivec2( 2, 406 ), ivec2( 2, 406 ) + cellSize ) );
-	areas[3] = mArrowTexture->getAreaTexCoords( Area( ivec2( 2, 608 ), ivec2( 2, 608 ) + cellSize ) );
+	mShader->uniform( "uTex0", 0 );
+	mShader->uniform( "uStyles", 1 );
+	createBatch( geom::Rect( Rectf( 0, 0, 1.0, 0.25 ) ), mShader );
+	
+	// USE every sprite on the first page, so they all share one texture and one draw
+	for( const auto &name : mAtlas.getNames() ) {
+		const Sprite *sprite = mAtlas.find( name );
+		if( sprite->page == 0 ) {
+			vec4 bounds = sprite->texBounds;
+			mAreas.push_back( Rectf( bounds.x, bounds.y, bounds.x + bounds.z, bounds.y + bounds.w ) );
+		}
+	}
+	if( mAtlas.getPageCount() > 0 )
+		mArrowTexture = mAtlas.getTexture( 0 );
+	else {
+		CI_LOG_E( "no sprites in " << getAssetPath( "sprites" ).string() );
+		mAreas.push_back( Rectf( 0, 0, 1, 1 ) );
+	}
+	
+	Rand::randomize();
+	setCount( count );
+}
 
+void InstancedArrows::setCount( size_t count )
+{
 	// DEFINE the arrow properties
-	Rand::randomize();
-	int rows = 5;
-	int cols = 5;
+	int rows = std::max( 5, int( sqrt( double( count ) ) ) );
+	int cols = rows;
 	float xFactor = 1.0f / float( cols );
 	float yFactor = 1.0f / float( rows );
 	
-	for( int i = 0; i < kMaxCount; ++i )
+	mArrows.clear();
+	mArrows.reserve( count );
+	for( size_t i = 0; i < count; ++i )
 	{
-		Rectf  texCoords = areas[randInt( areas.size() )];
+		Rectf  texCoords = mAreas[randInt( mAreas.size() )];
 		ColorA color = ColorA( CM_HSV, randFloat( 0, 0.5), 0.7, 0.5 );
 		float  y = ( float( floor( i / cols ) ) * yFactor ) + randFloat( -0.25, 0.25 );
 		float  x = ( float( i % rows ) * xFactor ) + randFloat( -0.25, 0.25 );
 		float  scale = randFloat( 0.4, 1.0 );
 		
 		ArrowOptions options = ArrowOptions().position( vec3( x * getWindowWidth(), y * getWindowHeight(), scale ) ).texCoords( texCoords ).color( color ).scale( scale ).speed( scale * 4.0 );
-		mOptions.push_back( options );
+		mArrows.push_back( options );
 	}
+	
+	// CREATE the static instance data, it's written once here and never again
+	std::vector<ArrowStyle> styles( count );
+	for( size_t i = 0; i < count; ++i ) {
+		styles[i].color = mArrows.colors[i];
+		styles[i].texBounds = mArrows.texBounds[i];
+	}
+	mStyles.set( styles );
+	mStyleTexture = gl::BufferTexture::create( mStyles.getVbo(), GL_RGBA32F );
+	
+	mIsDirty = true;
 }
 
 void InstancedArrows::update( double elapsed )
@@ -75,50 +91,145 @@ void InstancedArrows::update( double elapsed )
 	if( elapsed < 0.001 )
 		return;
 	
-	// UPDATE all of the positions of the arrows
-	auto  ptr = (InstanceData *)mInstanceDataVbo->mapReplace();
-	int   count = 0;
-
-	for( int i = 0; i < kMaxCount; ++i ) {
+	// MOVE every arrow, a plain loop over packed floats the compiler can vectorize
+	size_t count = mArrows.size();
+	float       *x = mArrows.positionsX.data();
+	const float *speed = mArrows.speeds.data();
+	for( size_t i = 0; i < count; ++i )
+		x[i] += speed[i];
+	
+	// WRAP the arrows that left the window, few of them on any one step
+	float width = getWindowWidth();
+	float height = getWindowHeight();
+	float *y = mArrows.positionsY.data();
+	const float *scale = mArrows.scales.data();
+	for( size_t i = 0; i < count; ++i ) {
+		if( x[i] > width ) {
+			x[i] -= ( width + ( 200.0f * scale[i] ) );
+			y[i] = randFloat( height );
+		}
+	}
+	
+	mIsDirty = true;
+}
 
-		auto options = mOptions[count];
-		vec3 position = options.getPosition();
-		position.x += options.getSpeed();
-		if( position.x > getWindowWidth() ){
-			position.x -= ( getWindowWidth() + ( 200.0 * options.getScale() ) );
-			position.y = randFloat( getWindowHeight() );
+void InstancedArrows::upload()
+{
+	// WRITE the positions once per frame, however many steps ran since the last one
+	mIsDirty = false;
+	size_t count = mArrows.size();
+	const float *x = mArrows.positionsX.data();
+	const float *y = mArrows.positionsY.data();
+	const float *scale = mArrows.scales.data();
+	
+	// CULL the arrows outside the view, the scale doubles as the depth
+	if( mIsCulling )
+		count = mCuller.cull( x, y, scale, mArrows.radii.data(), count, &mVisible );
+	
+	if( count == 0 ) {
+		clearInstances();
+		return;
+	}
+	
+	auto ptr = mapInstances( count );
+	if( mIsCulling ) {
+		// COMPACT the visible arrows to the front of the buffer
+		const uint32_t *visible = mVisible.data();
+		for( size_t i = 0; i < count; ++i ) {
+			uint32_t index = visible[i];
+			ptr[i].position = vec4( x[index], y[index], scale[index], scale[index] * 200.0f );
+			ptr[i].style = float( index );
 		}
-		
-		ptr->transform = glm::translate( position );
-		ptr->transform *= glm::scale( vec3( options.getScale() * 200.0 ) );
-
-		float alpha = options.getScale();
-		ColorA color = ColorA( Color( options.getColor() ), alpha );
-		ptr->color = vec4( color );
-		Rectf area = options.getTexCoords();
-		vec4  texCoords = vec4( area.getX1(), area.getY1(), area.getWidth(), area.getHeight() );
-		ptr->texBounds = texCoords;
-		
-		// UPDATE object
-		mOptions[count] = options.position( position );
-		ptr++;
-		count++;
 	}
-	mInstanceDataVbo->unmap();
+	else {
+		for( size_t i = 0; i < count; ++i ) {
+			ptr[i].position = vec4( x[i], y[i], scale[i], scale[i] * 200.0f );
+			ptr[i].style = float( i );
+		}
+	}
+	unmapInstances();
 }
 
 void InstancedArrows::draw()
 {
+	// FOLLOW the view, whatever is visible changes with it
+	if( mIsCulling ) {
+		mat4 viewProjection = gl::getProjectionMatrix() * gl::getViewMatrix() * gl::getModelMatrix();
+		if( viewProjection != mViewProjection ) {
+			mViewProjection = viewProjection;
+			mCuller.setFrustum( viewProjection );
+			mIsDirty = true;
+		}
+	}
+	
+	if( mIsDirty )
+		upload();
+	
 	// DRAW the arrows
-	if( mArrowTexture )
+	if( mArrowTexture && mStyleTexture )
 	{
 		gl::ScopedDepth( true );
 		gl::ScopedModelMatrix scpMtrx;
 		gl::ScopedTextureBind scpTex0( mArrowTexture, 0 );
-		mBatch->drawInstanced( kMaxCount );
+		mStyleTexture->bindTexture( 1 );
+		InstancedBase::draw();
+		mStyleTexture->unbindTexture( 1 );
 	}
 }
 
+void InstancedArrows::setCulling( bool culling )
+{
+	mIsCulling = culling;
+	mViewProjection = mat4( 0 );
+	mIsDirty = true;
+}
+
+void InstancedArrows::setStreaming( bool streaming )
+{
+	InstancedBase::setStreaming( streaming );
+	
+	// the new buffers start out empty, even while paused
+	mIsDirty = true;
+}
+
+void InstancedArrows::ArrowStore::clear()
+{
+	positionsX.clear();
+	positionsY.clear();
+	speeds.clear();
+	scales.clear();
+	radii.clear();
+	colors.clear();
+	texBounds.clear();
+}
+
+void InstancedArrows::ArrowStore::reserve( size_t count )
+{
+	positionsX.reserve( count );
+	positionsY.reserve( count );
+	speeds.reserve( count );
+	scales.reserve( count );
+	radii.reserve( count );
+	colors.reserve( count );
+	texBounds.reserve( count );
+}
+
+void InstancedArrows::ArrowStore::push_back( const ArrowOptions &options )
+{
+	// the depth is the scale, smaller arrows sit further back
+	positionsX.push_back( options.getPosition().x );
+	positionsY.push_back( options.getPosition().y );
+	speeds.push_back( options.getSpeed() );
+	scales.push_back( options.getScale() );
+	// the arrow is 200 by 50 at scale 1 and (x, y) is its corner, so this reaches its far corner
+	radii.push_back( options.getScale() * 206.2f );
+	
+	float alpha = options.getScale();
+	colors.push_back( vec4( ColorA( Color( options.getColor() ), alpha ) ) );
+	Rectf area = options.getTexCoords();
+	texBounds.push_back( vec4( area.getX1(), area.getY1(), area.getWidth(), area.getHeight() ) );
+}
+
 
 // ------------------------------------------------------------------------------------------------- Instanced Dots
 
@@ -181,10 +292,9 @@ void InstancedDots::Dots::update( double elapsed )
 	mTime += elapsed;
 	double progress = mTime;
 
-	auto ptr = (Data *)mDataVbo->mapReplace();
-	mInstanceCount = 0;
+	auto ptr = mapInstances( mDotData.size() );
 	float maxDist = 60.0;
-	for( int i = 0; i < mMaxCount; ++i ) {
+	for( size_t i = 0; i < mDotData.size(); ++i ) {
 		DotData d = mDotData[i];
 		
 		float distance = fmod( (0.25f * d.offset) + progress, 1.0f );
@@ -195,9 +305,8 @@ void InstancedDots::Dots::update( double elapsed )
 
 		ptr->data = vec4( d.color, alpha );
 		ptr++;
-		mInstanceCount++;
 	}
-	mDataVbo->unmap();
+	unmapInstances();
 }
 
 
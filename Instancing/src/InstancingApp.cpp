@@ -1,6 +1,8 @@
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/gl.h"
+#include "cinder/Log.h"
+#include "cinder/Timer.h"
 #include "InstancedObjects.h"
 
 using namespace ci;
@@ -15,11 +17,15 @@ class InstancingApp : public App {
 	void update() override;
 	void draw() override;
 	
+	//! Times the arrows' uploads at 10k, 100k and 1M instances, replacing one buffer and streaming through the ring.
+	void runUploadBenchmark();
 	
   private:
 	InstancedArrowsRef mArrows;
 	InstancedDotsRef   mDots;
 	bool			   mIsPaused = false;
+	bool			   mIsStreaming = false;
+	bool			   mRunBenchmark = false;
 	
 	typedef enum { MODE_ARROWS, MODE_DOTS } Mode;
 	Mode mMode;
@@ -49,6 +55,33 @@ void InstancingApp::keyDown( KeyEvent event )
 		case KeyEvent::KEY_2:
 			mMode = MODE_DOTS;
 			break;
+		
+		case KeyEvent::KEY_UP:
+			// MORE arrows, up to a million
+			mArrows->setCount( std::min<size_t>( mArrows->getCount() * 10, 1000000 ) );
+			break;
+		
+		case KeyEvent::KEY_DOWN:
+			mArrows->setCount( std::max<size_t>( mArrows->getCount() / 10, 30 ) );
+			break;
+		
+		case KeyEvent::KEY_s:
+			// STREAM the instances through a fenced ring instead of replacing the buffer every frame
+			mIsStreaming = !mIsStreaming;
+			mArrows->setStreaming( mIsStreaming );
+			mDots->setStreaming( mIsStreaming );
+			CI_LOG_I( ( mIsStreaming ? "streaming through the ring" : "replacing the buffer" ) );
+			break;
+		
+		case KeyEvent::KEY_c:
+			// CULL the arrows outside the window
+			mArrows->setCulling( !mArrows->isCulling() );
+			break;
+		
+		case KeyEvent::KEY_b:
+			// RUN it from draw, where the window's context is current
+			mRunBenchmark = true;
+			break;
 	}
 }
 
@@ -87,6 +120,11 @@ void InstancingApp::update()
 
 void InstancingApp::draw()
 {
+	if( mRunBenchmark ) {
+		mRunBenchmark = false;
+		runUploadBenchmark();
+	}
+	
 	gl::clear( Color( 0, 0, 0 ) );
 	
 	switch( mMode ){
@@ -98,6 +136,45 @@ void InstancingApp::draw()
 			mDots->draw();
 			break;
 	}
+	
+	// SHOW how much the culling saved
+	if( mMode == MODE_ARROWS && mArrows->isCulling() ) {
+		const InstanceCuller &culler = mArrows->getCuller();
+		gl::drawString( "drawn " + to_string( culler.getDrawn() ) + ", culled " + to_string( culler.getCulled() ), vec2( 10, 10 ) );
+	}
+}
+
+
+void InstancingApp::runUploadBenchmark()
+{
+	// START the app with LIBGL_ALWAYS_SOFTWARE=1 to run this on Mesa's software driver
+	static const int kFrames = 60;
+	CI_LOG_I( "upload benchmark, " << kFrames << " frames each on " << (const char *)glGetString( GL_RENDERER ) );
+	
+	size_t count = mArrows->getCount();
+	for( size_t instances : { 10000, 100000, 1000000 } ) {
+		mArrows->setCount( instances );
+		for( bool streaming : { false, true } ) {
+			// DRAW once outside the timing, the first upload allocates
+			mArrows->setStreaming( streaming );
+			mArrows->draw();
+			glFinish();
+			mArrows->resetUploadStats();
+			
+			Timer timer( true );
+			for( int frame = 0; frame < kFrames; ++frame ) {
+				mArrows->update( 1.0 / 60.0 );
+				mArrows->draw();
+			}
+			glFinish();
+			
+			CI_LOG_I( instances << ( streaming ? " ring:       " : " orphaned:   " ) << mArrows->getUploadMs() << " ms upload, "
+			          << 1000.0 * timer.getSeconds() / kFrames << " ms frame, " << mArrows->getStalls() << " stalls" );
+		}
+	}
+	
+	mArrows->setCount( count );
+	mArrows->setStreaming( mIsStreaming );
 }
 
 CINDER_APP( InstancingApp, RendererGl( RendererGl::Options().msaa( 8 ) ) )
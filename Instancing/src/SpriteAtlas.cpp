@@ -0,0 +1,429 @@
+//
+//  SpriteAtlas.cpp
+//  Instancing
+//
+
+#include "SpriteAtlas.h"
+#include "cinder/DataSource.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Log.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const char     CACHE_MAGIC[4] = { 'S', 'P', 'A', 'T' };
+const uint32_t CACHE_VERSION = 1;
+
+// FNV-1a, enough to tell sources apart
+uint64_t hashBytes( const void *data, size_t size, uint64_t hash = 14695981039346656037ULL )
+{
+	const uint8_t *bytes = static_cast<const uint8_t *>( data );
+	for( size_t i = 0; i < size; ++i ) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+template<typename T>
+void writeValue( ofstream &out, const T &value )
+{
+	out.write( reinterpret_cast<const char *>( &value ), sizeof( T ) );
+}
+
+template<typename T>
+bool readValue( ifstream &in, T *value )
+{
+	in.read( reinterpret_cast<char *>( value ), sizeof( T ) );
+	return bool( in );
+}
+
+int alignUp( int value, int alignment )
+{
+	return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+bool isImageFile( const fs::path &path )
+{
+	string ext = path.extension().string();
+	std::transform( ext.begin(), ext.end(), ext.begin(), ::tolower );
+	return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tif" || ext == ".tiff" || ext == ".bmp";
+}
+
+} // anonymous namespace
+
+SpriteAtlas::SpriteAtlas( int pageSize, int padding, int mipLevels )
+	: mPageSize( pageSize )
+	, mPadding( std::max( padding, 0 ) )
+	, mMipLevels( std::max( mipLevels, 0 ) )
+	, mGutter( 1 << mMipLevels )
+	, mIsFromCache( false )
+{
+}
+
+void SpriteAtlas::add( const std::string &name, const Surface8u &surface )
+{
+	Source source;
+	source.name = name;
+	source.surface = surface;
+	mSources.push_back( source );
+}
+
+void SpriteAtlas::add( const std::string &name, const fs::path &path )
+{
+	Source source;
+	source.name = name;
+	source.path = path;
+	mSources.push_back( source );
+}
+
+size_t SpriteAtlas::addDirectory( const fs::path &directory )
+{
+	if( directory.empty() || ! fs::is_directory( directory ) )
+		return 0;
+
+	size_t count = 0;
+	for( fs::directory_iterator iter( directory ), end; iter != end; ++iter ) {
+		if( fs::is_regular_file( iter->path() ) && isImageFile( iter->path() ) ) {
+			add( iter->path().stem().string(), iter->path() );
+			count++;
+		}
+	}
+	return count;
+}
+
+bool SpriteAtlas::build( const fs::path &cacheDirectory )
+{
+	// SORT by name, so the same sources always hash and pack the same way however they were added
+	std::stable_sort( mSources.begin(), mSources.end(), []( const Source &a, const Source &b ) { return a.name < b.name; } );
+
+	fs::path metadataFile;
+	if( ! cacheDirectory.empty() ) {
+		char name[32];
+		std::snprintf( name, sizeof( name ), "%016llx.atlas", (unsigned long long)hashSources() );
+		metadataFile = cacheDirectory / name;
+	}
+
+	mIsFromCache = ! metadataFile.empty() && fs::exists( metadataFile ) && load( metadataFile );
+	if( ! mIsFromCache ) {
+		if( ! pack() )
+			return false;
+		if( ! metadataFile.empty() && ! save( metadataFile ) )
+			CI_LOG_W( "unable to cache the sprite atlas in " << cacheDirectory.string() );
+	}
+
+	// CREATE the textures, only as many mip levels as the gutter keeps apart
+	auto fmt = gl::Texture2d::Format().mipmap().maxMipmapLevel( mMipLevels ).minFilter( GL_LINEAR_MIPMAP_LINEAR ).wrap( GL_CLAMP_TO_EDGE ).loadTopDown();
+
+	mTextures.clear();
+	for( const auto &page : mPages )
+		mTextures.push_back( gl::Texture2d::create( page, fmt ) );
+	mPages.clear();
+	mSources.clear();
+
+	CI_LOG_I( ( mIsFromCache ? "loaded " : "packed " ) << mSprites.size() << " sprites on " << mTextures.size() << " pages" );
+	return true;
+}
+
+const Sprite *SpriteAtlas::find( const std::string &name ) const
+{
+	auto iter = mSprites.find( name );
+	return iter != mSprites.end() ? &iter->second : nullptr;
+}
+
+vec4 SpriteAtlas::getTexBounds( const std::string &name ) const
+{
+	const Sprite *sprite = find( name );
+	return sprite ? sprite->texBounds : vec4( 0, 0, 1, 1 );
+}
+
+vector<string> SpriteAtlas::getNames() const
+{
+	vector<string> names;
+	for( const auto &sprite : mSprites )
+		names.push_back( sprite.first );
+	return names;
+}
+
+uint64_t SpriteAtlas::hashSources() const
+{
+	// the settings change the packing too
+	int32_t settings[] = { int32_t( CACHE_VERSION ), mPageSize, mPadding, mGutter };
+	uint64_t hash = hashBytes( settings, sizeof( settings ) );
+
+	for( const auto &source : mSources ) {
+		hash = hashBytes( source.name.data(), source.name.size() + 1, hash );
+		if( source.surface.getData() ) {
+			int32_t size[] = { source.surface.getWidth(), source.surface.getHeight() };
+			hash = hashBytes( size, sizeof( size ), hash );
+			for( int32_t y = 0; y < size[1]; ++y )
+				hash = hashBytes( source.surface.getData( ivec2( 0, y ) ), size[0] * source.surface.getPixelInc(), hash );
+		}
+		else {
+			// the file's bytes, hashing them is much quicker than decoding
+			try {
+				BufferRef buffer = loadFile( source.path )->getBuffer();
+				hash = hashBytes( buffer->getData(), buffer->getSize(), hash );
+			}
+			catch( const std::exception &exc ) {
+				CI_LOG_W( "unable to read " << source.path.string() << ": " << exc.what() );
+			}
+		}
+	}
+	return hash;
+}
+
+bool SpriteAtlas::pack()
+{
+	// LOAD the images that came as paths, every one with alpha so the pages all share a format
+	vector<pair<string, Surface8u>> images;
+	for( const auto &source : mSources ) {
+		Surface8u image = source.surface;
+		if( ! image.getData() ) {
+			try {
+				image = Surface8u( loadImage( source.path ), SurfaceConstraintsDefault(), true );
+			}
+			catch( const std::exception &exc ) {
+				CI_LOG_E( "unable to load " << source.path.string() << ": " << exc.what() );
+				continue;
+			}
+		}
+		images.push_back( make_pair( source.name, image ) );
+	}
+
+	// PACK the tallest first, a skyline fills up best that way
+	std::stable_sort( images.begin(), images.end(), []( const pair<string, Surface8u> &a, const pair<string, Surface8u> &b ) {
+		return a.second.getHeight() > b.second.getHeight();
+	} );
+
+	vector<Page> pages;
+	mSprites.clear();
+	for( const auto &image : images ) {
+		ivec2 inner = image.second.getSize();
+		ivec2 cell = ivec2( alignUp( inner.x + 2 * mGutter + mPadding, mGutter ), alignUp( inner.y + 2 * mGutter + mPadding, mGutter ) );
+		if( cell.x > mPageSize || cell.y > mPageSize ) {
+			CI_LOG_E( "sprite " << image.first << " is bigger than a " << mPageSize << " page" );
+			continue;
+		}
+
+		// FIND room on a page, or start a new one
+		ivec2  position;
+		size_t segment = 0;
+		size_t index = 0;
+		while( index < pages.size() && ! findPosition( pages[index], cell, &position, &segment ) )
+			index++;
+		if( index == pages.size() ) {
+			Page page;
+			page.surface = Surface8u( mPageSize, mPageSize, true );
+			std::fill( page.surface.getData(), page.surface.getData() + page.surface.getRowBytes() * mPageSize, uint8_t( 0 ) );
+			page.skyline.push_back( Segment{ 0, 0, mPageSize } );
+			page.used = ivec2( 0 );
+			pages.push_back( page );
+			findPosition( pages.back(), cell, &position, &segment );
+		}
+
+		Page &page = pages[index];
+		place( &page, segment, position, cell );
+		blit( image.second, position + ivec2( mGutter ), &page.surface );
+
+		Sprite &sprite = mSprites[image.first];
+		sprite.page = int( index );
+		sprite.bounds = Area( position + ivec2( mGutter ), position + ivec2( mGutter ) + inner );
+	}
+
+	// CROP every page to what it used
+	mPages.clear();
+	for( const auto &page : pages )
+		mPages.push_back( page.surface.clone( Area( ivec2( 0 ), page.used ) ) );
+
+	updateTexBounds();
+	return ! mSprites.empty();
+}
+
+bool SpriteAtlas::findPosition( const Page &page, const ivec2 &size, ivec2 *position, size_t *segment ) const
+{
+	// BOTTOM LEFT, the spot whose top ends lowest, and on a tie the one sitting on the narrowest segment
+	const auto &skyline = page.skyline;
+	int  bestTop = mPageSize + 1;
+	int  bestWidth = mPageSize + 1;
+	bool found = false;
+	for( size_t i = 0; i < skyline.size(); ++i ) {
+		int x = skyline[i].x;
+		if( x + size.x > mPageSize )
+			break;
+
+		// REST on the highest segment the cell spans
+		int y = 0;
+		int left = size.x;
+		for( size_t j = i; left > 0 && j < skyline.size(); ++j ) {
+			y = std::max( y, skyline[j].y );
+			left -= skyline[j].width;
+		}
+		if( y + size.y > mPageSize )
+			continue;
+
+		if( y + size.y < bestTop || ( y + size.y == bestTop && skyline[i].width < bestWidth ) ) {
+			bestTop = y + size.y;
+			bestWidth = skyline[i].width;
+			*position = ivec2( x, y );
+			*segment = i;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void SpriteAtlas::place( Page *page, size_t segment, const ivec2 &position, const ivec2 &size )
+{
+	auto &skyline = page->skyline;
+	skyline.insert( skyline.begin() + segment, Segment{ position.x, position.y + size.y, size.x } );
+
+	// TRIM the segments the new one covers
+	size_t i = segment + 1;
+	while( i < skyline.size() ) {
+		int covered = skyline[i - 1].x + skyline[i - 1].width - skyline[i].x;
+		if( covered <= 0 )
+			break;
+
+		skyline[i].x += covered;
+		skyline[i].width -= covered;
+		if( skyline[i].width > 0 )
+			break;
+		skyline.erase( skyline.begin() + i );
+	}
+
+	// MERGE neighbours at the same height
+	for( i = 0; i + 1 < skyline.size(); ) {
+		if( skyline[i].y == skyline[i + 1].y ) {
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase( skyline.begin() + i + 1 );
+		}
+		else
+			++i;
+	}
+
+	// the padding is only needed between cells, not against the page's edge
+	page->used = glm::max( page->used, ivec2( std::min( position.x + size.x, mPageSize ), std::min( position.y + size.y, mPageSize ) ) );
+}
+
+void SpriteAtlas::blit( const Surface8u &image, const ivec2 &position, Surface8u *page ) const
+{
+	ivec2 size = image.getSize();
+	page->copyFrom( image, image.getBounds(), position );
+
+	// EXTRUDE the edges into the gutter, first the columns then whole rows so the corners get filled as well
+	for( int g = 1; g <= mGutter; ++g ) {
+		page->copyFrom( image, Area( 0, 0, 1, size.y ), position + ivec2( -g, 0 ) );
+		page->copyFrom( image, Area( size.x - 1, 0, size.x, size.y ), position + ivec2( g, 0 ) );
+	}
+	Area top( position.x - mGutter, position.y, position.x + size.x + mGutter, position.y + 1 );
+	Area bottom( position.x - mGutter, position.y + size.y - 1, position.x + size.x + mGutter, position.y + size.y );
+	for( int g = 1; g <= mGutter; ++g ) {
+		page->copyFrom( *page, top, ivec2( 0, -g ) );
+		page->copyFrom( *page, bottom, ivec2( 0, g ) );
+	}
+}
+
+void SpriteAtlas::updateTexBounds()
+{
+	for( auto &sprite : mSprites ) {
+		Sprite &s = sprite.second;
+		vec2    pageSize = vec2( mPages[s.page].getSize() );
+		vec2    ul = vec2( s.bounds.getUL() ) / pageSize;
+		vec2    size = vec2( s.bounds.getSize() ) / pageSize;
+		s.texBounds = vec4( ul.x, ul.y, size.x, size.y );
+	}
+}
+
+bool SpriteAtlas::save( const fs::path &metadataFile ) const
+{
+	try {
+		fs::create_directories( metadataFile.parent_path() );
+		for( size_t i = 0; i < mPages.size(); ++i )
+			writeImage( getPageFile( metadataFile, i ), mPages[i] );
+	}
+	catch( const std::exception &exc ) {
+		CI_LOG_E( "unable to write the atlas pages: " << exc.what() );
+		return false;
+	}
+
+	ofstream out( metadataFile.string().c_str(), ios::binary | ios::trunc );
+	if( ! out )
+		return false;
+
+	out.write( CACHE_MAGIC, sizeof( CACHE_MAGIC ) );
+	writeValue( out, CACHE_VERSION );
+	writeValue( out, uint32_t( mPages.size() ) );
+	writeValue( out, uint32_t( mSprites.size() ) );
+	for( const auto &sprite : mSprites ) {
+		writeValue( out, uint32_t( sprite.first.size() ) );
+		out.write( sprite.first.data(), sprite.first.size() );
+		writeValue( out, int32_t( sprite.second.page ) );
+		writeValue( out, int32_t( sprite.second.bounds.x1 ) );
+		writeValue( out, int32_t( sprite.second.bounds.y1 ) );
+		writeValue( out, int32_t( sprite.second.bounds.x2 ) );
+		writeValue( out, int32_t( sprite.second.bounds.y2 ) );
+	}
+	return bool( out );
+}
+
+bool SpriteAtlas::load( const fs::path &metadataFile )
+{
+	ifstream in( metadataFile.string().c_str(), ios::binary );
+	char     magic[4];
+	uint32_t version, pageCount, spriteCount;
+	in.read( magic, sizeof( magic ) );
+	if( ! in || ! std::equal( magic, magic + 4, CACHE_MAGIC ) )
+		return false;
+	if( ! readValue( in, &version ) || version != CACHE_VERSION )
+		return false;
+	if( ! readValue( in, &pageCount ) || pageCount == 0 || ! readValue( in, &spriteCount ) )
+		return false;
+
+	vector<Surface8u> pages;
+	try {
+		for( uint32_t i = 0; i < pageCount; ++i )
+			pages.push_back( Surface8u( loadImage( getPageFile( metadataFile, i ) ), SurfaceConstraintsDefault(), true ) );
+	}
+	catch( const std::exception &exc ) {
+		CI_LOG_W( "ignoring the cached atlas, a page won't load: " << exc.what() );
+		return false;
+	}
+
+	map<string, Sprite> sprites;
+	for( uint32_t i = 0; i < spriteCount; ++i ) {
+		uint32_t length;
+		if( ! readValue( in, &length ) || length > 1024 )
+			return false;
+		string name( length, '\0' );
+		in.read( &name[0], length );
+
+		int32_t page, x1, y1, x2, y2;
+		if( ! readValue( in, &page ) || ! readValue( in, &x1 ) || ! readValue( in, &y1 ) || ! readValue( in, &x2 ) || ! readValue( in, &y2 ) )
+			return false;
+		if( page < 0 || page >= int32_t( pageCount ) || x1 < 0 || y1 < 0 || x1 > x2 || y1 > y2
+		    || x2 > pages[page].getWidth() || y2 > pages[page].getHeight() )
+			return false;
+
+		Sprite &sprite = sprites[name];
+		sprite.page = page;
+		sprite.bounds = Area( x1, y1, x2, y2 );
+	}
+
+	mPages.swap( pages );
+	mSprites.swap( sprites );
+	updateTexBounds();
+	return true;
+}
+
+fs::path SpriteAtlas::getPageFile( const fs::path &metadataFile, size_t page )
+{
+	fs::path file = metadataFile;
+	return file.replace_extension( "." + to_string( page ) + ".png" );
+}
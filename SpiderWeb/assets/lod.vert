@@ -0,0 +1,20 @@
+#version 330 core
+
+layout (location = 0) in vec3 position;	// POSITION_INDEX
+
+uniform mat4 ciModelViewProjection;
+uniform vec2 uViewportSize;
+
+out VertexData {
+	vec2 screenPos;
+	flat int id;
+} vVertexOut;
+
+void main(void)
+{
+	vec4 clip = ciModelViewProjection * vec4(position, 1.0);
+	vVertexOut.screenPos = 0.5 * uViewportSize * clip.xy / clip.w;
+	// with drawElements this is the point index, which is what the compacted buffer stores
+	vVertexOut.id = gl_VertexID;
+	gl_Position = clip;
+}
@@ -0,0 +1,31 @@
+#version 330 core
+
+// Rebuilds every web point from the simulated skeleton (see WebSkeleton.h).
+// A point is placed at its rest fraction along the span between the two
+// skeleton points around it on the same ray.
+
+layout (location = 0) in ivec2 skeletonPair;	// SKELETON_PAIR_INDEX
+layout (location = 1) in float along;			// SKELETON_ALONG_INDEX
+
+// RGBA32F view of the skeleton positions
+uniform samplerBuffer uSkeletonPositions;
+// R32F view of the skeleton velocities, which are tightly packed vec3s
+uniform samplerBuffer uSkeletonVelocities;
+
+out vec4 tf_position_mass;
+out vec3 tf_velocity;
+
+vec3 fetchVelocity( int index )
+{
+	return vec3( texelFetch( uSkeletonVelocities, index * 3 ).r,
+				 texelFetch( uSkeletonVelocities, index * 3 + 1 ).r,
+				 texelFetch( uSkeletonVelocities, index * 3 + 2 ).r );
+}
+
+void main(void)
+{
+	vec4 a = texelFetch( uSkeletonPositions, skeletonPair.x );
+	vec4 b = texelFetch( uSkeletonPositions, skeletonPair.y );
+	tf_position_mass = mix( a, b, along );
+	tf_velocity = mix( fetchVelocity( skeletonPair.x ), fetchVelocity( skeletonPair.y ), along );
+}
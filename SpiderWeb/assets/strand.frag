@@ -0,0 +1,28 @@
+#version 330 core
+
+uniform float uFeather = 1.0;
+
+in VertexData {
+	noperspective float edgeDist;
+	noperspective float halfWidth;
+	noperspective float capDist;
+	flat float strandLength;
+	float coverage;
+	vec4 color;
+	vec3 vel;
+} vVertexIn;
+
+layout (location = 0) out vec4 color;
+
+
+void main(void)
+{
+	// analytic coverage of the pixel by the strand, falling off over uFeather pixels
+	float edge = clamp( ( vVertexIn.halfWidth - abs( vVertexIn.edgeDist ) ) / uFeather + 0.5, 0.0, 1.0 );
+	// same at the caps, half covered right at each point so strands meeting there don't double up
+	float cap = clamp( min( vVertexIn.capDist, vVertexIn.strandLength - vVertexIn.capDist ) / uFeather + 0.5, 0.0, 1.0 );
+	
+	// same shading as render.frag
+	vec3 colorSpectrum = clamp( normalize( abs( vVertexIn.vel ) ), vec3( 0.1 ), vec3( 1.0 ) );
+	color = vec4( vVertexIn.color.rgb, vVertexIn.color.a * colorSpectrum.r * edge * cap * vVertexIn.coverage );
+}
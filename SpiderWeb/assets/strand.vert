@@ -0,0 +1,19 @@
+#version 330 core
+
+layout (location = 0) in vec3 position;	// POSITION_INDEX
+layout (location = 1) in vec3 velocity;	// VELOCITY_INDEX
+layout (location = 4) in vec4 color;	// COLOR_INDEX
+
+uniform mat4 ciModelViewProjection;
+
+out VertexData {
+	vec4 color;
+	vec3 vel;
+} vVertexOut;
+
+void main(void)
+{
+	gl_Position = ciModelViewProjection * vec4(position, 1.0);
+	vVertexOut.vel = velocity;
+	vVertexOut.color = color;
+}
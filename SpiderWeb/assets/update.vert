@@ -12,18 +12,26 @@ layout (location = 1) in vec3 velocity;			// VELOCITY_INDEX
 layout (location = 2) in ivec4 connection;		// CONNECTION_INDEX
 // This is our connection length
 layout (location = 3) in vec4 connectionLen;	// CONNECTION_LEN_INDEX
+// tf_flags written by the previous iteration
+layout (location = 5) in int prev_flags;		// PREV_FLAGS_INDEX
 
 
 // This is a TBO that will be bound to the same buffer as the
 // position_mass input attribute
 uniform samplerBuffer tex_position;
 
-uniform vec3 rayPosition = vec3(100.0, 100.0, 0.0 );
 uniform float ciElapsedSeconds;
 
 // The outputs of the vertex shader are the same as the inputs
 out vec4 tf_position_mass;
 out vec3 tf_velocity;
+// Solver health bits, read back by SolverStats (see WebStats.h). They add up over
+// a frame's iterations, the first one starts them over with uAccumulateFlags off.
+flat out int tf_flags;
+uniform bool uAccumulateFlags = false;
+
+const int FLAG_CLAMPED		= 1;
+const int FLAG_NON_FINITE	= 2;
 
 // A uniform to hold the timestep. The application can update this.
 uniform float t = 0.07;
@@ -45,17 +53,28 @@ uniform float c = 2.8;
 uniform float rest_length = 0.88;
 //uniform float rest_length = 0.1;
 
-vec3 calcRayIntersection( vec3 pos )
+// Force probes (see WebProbes.h). Each probe is vec4( position.xy, radius, strength ),
+// binned on the CPU into a uniform grid so a particle only tests the probes in its own cell.
+uniform samplerBuffer	uProbes;
+uniform isamplerBuffer	uProbeCells;		// ivec2( start, count ) into uProbeIndices, per cell
+uniform isamplerBuffer	uProbeIndices;
+uniform ivec2			uProbeGridSize = ivec2( 1, 1 );
+uniform float			uProbeCellSize = 64.0;
+uniform int				uProbeCount = 0;
+
+vec3 applyProbes( vec3 pos )
 {
 	vec3 retPos = pos;
-	if (rayPosition.x > pos.x - 30 &&
-		rayPosition.x < pos.x + 30 &&
-		rayPosition.y > pos.y - 30 &&
-		rayPosition.y < pos.y + 30 &&
-		rayPosition.z > pos.z - 30 &&
-		rayPosition.z < pos.z + 30 &&
-		connection[0] != -1 && connection[1] != -1) {
-		retPos = vec3(rayPosition.x, rayPosition.y, rayPosition.z);
+	if( uProbeCount == 0 || connection[0] == -1 || connection[1] == -1 )
+		return retPos;
+	
+	ivec2 cell = clamp( ivec2( floor( pos.xy / uProbeCellSize ) ), ivec2( 0 ), uProbeGridSize - ivec2( 1 ) );
+	ivec2 range = texelFetch( uProbeCells, cell.y * uProbeGridSize.x + cell.x ).xy;
+	for( int i = range.x; i < range.x + range.y; i++ ) {
+		vec4 probe = texelFetch( uProbes, texelFetch( uProbeIndices, i ).x );
+		if( distance( retPos.xy, probe.xy ) < probe.z ) {
+			retPos.xy = mix( retPos.xy, probe.xy, clamp( probe.w, 0.0, 1.0 ) );
+		}
 	}
 	return retPos;
 }
@@ -63,7 +82,7 @@ vec3 calcRayIntersection( vec3 pos )
 void main(void)
 {
 	vec3 p = position_mass.xyz;    // p can be our position
-	p = calcRayIntersection( p );
+	p = applyProbes( p );
 	
 	float m = position_mass.w;     // m is the mass of our vertex
 	vec3 u = velocity;             // u is the initial velocity
@@ -91,7 +110,10 @@ void main(void)
 		}
 	}
 	
-	F += avgF / count;
+	// isolated nodes have no springs to average
+	if( count > 0.0 ) {
+		F += avgF / count;
+	}
 	
 	// If this is a fixed node, reset force to zero
 	if( fixed_node ) {
@@ -107,11 +129,21 @@ void main(void)
 	// Final velocity
 	vec3 v = u + a * t;
 	
+	int flags = uAccumulateFlags ? prev_flags : 0;
+	if( any( greaterThan( abs(s), vec3(25.0) ) ) ) {
+		flags |= FLAG_CLAMPED;
+	}
+	
 	// Constrain the absolute value of the displacement per step
 	s = clamp(s, vec3(-25.0), vec3(25.0));
 	
+	if( any( isnan( p + s ) ) || any( isinf( p + s ) ) || any( isnan( v ) ) || any( isinf( v ) ) ) {
+		flags |= FLAG_NON_FINITE;
+	}
+	
 	// Write the outputs
 	tf_position_mass = vec4(p + s, m);
 //	tf_position_mass = vec4(p, m);
 	tf_velocity = v;
+	tf_flags = flags;
 }
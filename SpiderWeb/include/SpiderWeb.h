@@ -6,6 +6,10 @@
 //
 //
 
+#pragma once
+
+#include "cinder/Rand.h"
+#include "cinder/Rect.h"
 
 using ParticleRef = std::shared_ptr<class Particle>;
 
@@ -72,17 +76,17 @@ using WebRayRef = std::shared_ptr<class WebRay>;
 class WebRay {
 	
 public:
-	static std::shared_ptr<WebRay> create( int order, ParticleRef startPt, ParticleRef endPt, float noise )
+	static std::shared_ptr<WebRay> create( int order, ParticleRef startPt, ParticleRef endPt, float noise, ci::Rand *rand )
 	{
 		auto p = std::make_shared<WebRay>();
-		p->setup( order, startPt, endPt, noise );
+		p->setup( order, startPt, endPt, noise, rand );
 		return p;
 	}
 	
-	static float getRandomPoint( ci::vec2 vec, float range, float maxLength)
+	static float getRandomPoint( ci::Rand &rand, ci::vec2 vec, float range, float maxLength)
 	{
 		float pointDist = sqrt( ( vec.x * vec.x ) + ( vec.y * vec.y ) )
-						+ ( ( ci::randFloat() * ( range * 2.0 ) ) - range );
+						+ ( ( rand.nextFloat() * ( range * 2.0 ) ) - range );
 		// make sure they are not connecting to points that don't exist
 		pointDist = (pointDist > maxLength) ? maxLength : pointDist;
 		return pointDist;
@@ -117,8 +121,9 @@ public:
 	float mAngle;
 	
 private:
-	void setup( int order, ParticleRef &startPt, const ParticleRef &endPt, float noise )
+	void setup( int order, ParticleRef &startPt, const ParticleRef &endPt, float noise, ci::Rand *rand )
 	{
+		mRand = rand;
 		mOrder = order;
 		mStartPt = startPt;
 		mEndPt = endPt;
@@ -132,6 +137,7 @@ private:
 	
 	int							mOrder, mRayPointAmt;
 	float						mNoise;
+	ci::Rand					*mRand;		// owned by the SpiderWeb
 	std::vector<ParticleRef>	mPoints;
 	
 	ParticleRef					mWebCenter;
@@ -154,7 +160,8 @@ public:
 	typedef class Options {
 	public:
 		Options()
-		: mAnchorCount( 5 ), mRadiusBase( 200.0f ), mRayPointCount( 10 ), mRaySpacing( 40.0 )
+		: mAnchorCount( 5 ), mRadiusBase( 200.0f ), mRayPointCount( 10 ), mRaySpacing( 40.0 ),
+		  mSeed( ci::randUint() ), mBounds( 0, 0, 0, 0 )
 		{ }
 		
 		// NUMBER of anchor strands
@@ -173,12 +180,22 @@ public:
 		Options& raySpacing( float spacing ) { mRaySpacing = spacing; return *this; }
 		float getRaySpacing() const { return mRaySpacing; }
 		
+		// SEED of the web's own random generator, so webs can be made on any thread
+		Options& seed( uint32_t seed ) { mSeed = seed; return *this; }
+		uint32_t getSeed() const { return mSeed; }
+		
+		// AREA to lay the web out in. Empty uses the window bounds, which only works on the main thread
+		Options& bounds( const ci::Rectf &bounds ) { mBounds = bounds; return *this; }
+		const ci::Rectf& getBounds() const { return mBounds; }
+		
 		
 	private:
 		int			mAnchorCount;
 		float		mRadiusBase;
 		int			mRayPointCount;
 		float		mRaySpacing;
+		uint32_t	mSeed;
+		ci::Rectf	mBounds;
 		
 	} Options;
 	
@@ -224,6 +241,7 @@ public:
 	void make();
 	void reset();
 	std::vector<ParticleRef>	getPoints() { return mPoints; };
+	std::vector<WebRayRef>		getRays() { return mRays; };
 	std::vector<std::pair<ParticleRef, ParticleRef>> getStrands() { return mStrands; };
 	std::vector<std::pair<ParticleRef, ParticleRef>> getUniqueStrands() { return mUniqueStrands; };
 	
@@ -244,4 +262,6 @@ private:
 	float								mAvgLen;
 	std::vector<WebRayRef>				mRays;
 	Options								mOptions;
+	ci::Rand							mRand;		// per web, the global ci::Rand isn't thread safe
+	ci::Rectf							mBounds;
 };
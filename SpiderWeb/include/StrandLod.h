@@ -0,0 +1,37 @@
+//
+//  StrandLod.h
+//  SpiderWeb
+//
+//  Screen-space level of detail for web strands. Strands whose projected length is
+//  below a pixel threshold are dropped and the survivors are compacted into a
+//  contiguous index range. This is the CPU reference for the lod.vert/lod.geom pass.
+//
+
+#pragma once
+
+#include "cinder/Vector.h"
+#include "cinder/Matrix.h"
+#include <vector>
+
+class StrandLod {
+  public:
+	struct Stats {
+		Stats() : total( 0 ), drawn( 0 ) {}
+		size_t getCulled() const { return total - drawn; }
+		
+		size_t total;
+		size_t drawn;
+	};
+	
+	//! Returns the length in pixels of the segment \a a - \a b after projecting by \a mvp into a viewport of \a viewportSize.
+	static float	getProjectedLength( const ci::vec3 &a, const ci::vec3 &b, const ci::mat4 &mvp, const ci::vec2 &viewportSize );
+	
+	//! Returns the window-space position of \a pos relative to the viewport center, matching lod.vert.
+	static ci::vec2	project( const ci::vec3 &pos, const ci::mat4 &mvp, const ci::vec2 &viewportSize );
+	
+	//! Writes the index pairs of every strand at least \a minPixels long to \a outIndices, keeping their order.
+	//! \a indices holds two point indices per strand. Returns the drawn and total strand counts.
+	static Stats	cull( const std::vector<ci::vec4> &positions, const std::vector<uint32_t> &indices,
+						  const ci::mat4 &mvp, const ci::vec2 &viewportSize, float minPixels,
+						  std::vector<uint32_t> *outIndices );
+};
@@ -0,0 +1,86 @@
+//
+//  WebCandidates.h
+//  SpiderWeb
+//
+//  Best-of-N web generation. Candidates are made concurrently, flattened into
+//  a plain graph, scored on a coarse coverage raster, and the best one that
+//  finished inside the time budget wins.
+//
+
+#pragma once
+
+#include "SpiderWeb.h"
+#include "cinder/Rect.h"
+#include <vector>
+
+//! Flat copy of a web: point positions and index pairs of its unique strands.
+struct WebGraph {
+	static WebGraph create( const SpiderWebRef &web );
+	
+	std::vector<ci::vec2>					positions;
+	std::vector<std::pair<int32_t, int32_t>>	strands;
+};
+
+struct WebScore {
+	WebScore() : coverage( 0.0f ), uniformity( 0.0f ), density( 0.0f ), degree( 0.0f ), total( 0.0f ) {}
+	
+	float	coverage;	// fraction of raster cells inside the web that a strand passes through
+	float	uniformity;	// 1 when every block of the web is equally covered
+	float	density;	// 1 at the target strand length per area, falling off either side
+	float	degree;		// fraction of points with 2 to 4 neighbors
+	float	total;		// weighted sum of the above
+};
+
+class WebCandidates {
+  public:
+	
+	typedef class Options {
+	  public:
+		Options()
+		: mTimeBudget( 0.05 ), mRasterSize( 96, 72 ), mBlockCount( 6, 6 ), mTargetDensity( 0.05f ),
+		  mCoverageWeight( 1.0f ), mUniformityWeight( 1.0f ), mDensityWeight( 0.5f ), mDegreeWeight( 0.5f )
+		{ }
+		
+		// SECONDS to wait for candidates. If none finish in time the first one is made on the calling thread
+		Options& timeBudget( double seconds ) { mTimeBudget = seconds; return *this; }
+		double getTimeBudget() const { return mTimeBudget; }
+		
+		// SIZE of the coverage raster over the bounds, and the blocks uniformity is measured over
+		Options& rasterSize( const ci::ivec2 &size ) { mRasterSize = size; return *this; }
+		Options& blockCount( const ci::ivec2 &count ) { mBlockCount = count; return *this; }
+		
+		// LENGTH of strand per square pixel a good web has
+		Options& targetDensity( float density ) { mTargetDensity = density; return *this; }
+		
+		// WEIGHTS of each score in the total
+		Options& weights( float coverage, float uniformity, float density, float degree )
+		{
+			mCoverageWeight = coverage; mUniformityWeight = uniformity; mDensityWeight = density; mDegreeWeight = degree;
+			return *this;
+		}
+		
+		double		mTimeBudget;
+		ci::ivec2	mRasterSize, mBlockCount;
+		float		mTargetDensity;
+		float		mCoverageWeight, mUniformityWeight, mDensityWeight, mDegreeWeight;
+	} Options;
+	
+	WebCandidates( const Options &options = Options() ) : mOptions( options ), mLastFinished( 0 ) {}
+	
+	//! Makes a web from each of \a webOptions concurrently and returns the best scoring one.
+	//! Never waits on the workers past the time budget, see Options::timeBudget().
+	//! The options need explicit bounds and seeds, see SpiderWeb::Options.
+	SpiderWebRef	pick( const std::vector<SpiderWeb::Options> &webOptions );
+	
+	//! Scores a web laid out in \a bounds. Cheap enough to run per candidate on its own worker.
+	WebScore		score( const WebGraph &graph, const ci::Rectf &bounds ) const;
+	
+	//! Score of the last picked web, and how many candidates finished in time.
+	const WebScore&	getLastScore() const		{ return mLastScore; }
+	int				getLastFinished() const		{ return mLastFinished; }
+	
+  private:
+	Options		mOptions;
+	WebScore	mLastScore;
+	int			mLastFinished;
+};
@@ -0,0 +1,28 @@
+//
+//  WebNoise.h
+//  SpiderWeb
+//
+//  Batched fBm evaluation for colorizing web points, spread over the worker threads.
+//
+
+#pragma once
+
+#include "cinder/Perlin.h"
+#include <vector>
+
+class BatchFbm {
+  public:
+	//! Matches the defaults of ci::Perlin so the output is identical to Perlin().fBm( x, y ).
+	BatchFbm( uint8_t octaves = 4, int32_t seed = 0x214 );
+
+	//! Evaluates fBm for \a count points, writing one value per point into \a out.
+	//! The points are split into contiguous chunks across the worker threads.
+	void eval( const ci::vec2 *points, size_t count, float *out ) const;
+	std::vector<float> eval( const std::vector<ci::vec2> &points ) const;
+
+  private:
+	//! Evaluates a contiguous chunk on the calling thread, one Perlin::fBm() call per point.
+	void evalChunk( const ci::vec2 *points, size_t count, float *out ) const;
+
+	ci::Perlin	mPerlin;
+};
@@ -0,0 +1,56 @@
+//
+//  WebProbes.h
+//  SpiderWeb
+//
+//  Pointer interaction as a batch of force probes, binned into a uniform grid
+//  so each particle only tests the probes that overlap its own cell.
+//
+
+#pragma once
+
+#include "cinder/Vector.h"
+#include <vector>
+
+struct ForceProbe {
+	ForceProbe() : position( 0.0f ), radius( 30.0f ), strength( 1.0f ) {}
+	ForceProbe( const ci::vec2 &pos, float r, float s ) : position( pos ), radius( r ), strength( s ) {}
+	
+	ci::vec2	position;	// window position in pixels
+	float		radius;		// pixels
+	float		strength;	// 0 leaves particles alone, 1 snaps them onto the probe
+};
+
+class ProbeGrid {
+  public:
+	ProbeGrid( const ci::vec2 &bounds = ci::vec2( 1024, 768 ), float cellSize = 64.0f );
+	
+	//! Resizes the grid. Clears any binned probes.
+	void		setBounds( const ci::vec2 &bounds, float cellSize );
+	
+	//! Rebuilds the per-cell probe lists. A probe is added to every cell its radius overlaps.
+	void		bin( const std::vector<ForceProbe> &probes );
+	
+	//! Returns the cell containing \a pos, clamped to the grid.
+	ci::ivec2	getCell( const ci::vec2 &pos ) const;
+	//! Returns the flat index of the cell containing \a pos.
+	int			getCellIndex( const ci::vec2 &pos ) const;
+	
+	//! CPU reference of the probe pass in update.vert.
+	ci::vec3	apply( const ci::vec3 &pos ) const;
+	
+	const std::vector<ForceProbe>&	getProbes() const		{ return mProbes; }
+	//! (start, count) into getCellIndices() for every cell, row major.
+	const std::vector<ci::ivec2>&	getCellRanges() const	{ return mCellRanges; }
+	const std::vector<int32_t>&		getCellIndices() const	{ return mCellIndices; }
+	ci::ivec2						getGridSize() const		{ return mGridSize; }
+	float							getCellSize() const		{ return mCellSize; }
+	
+  private:
+	void		getCellSpan( const ForceProbe &probe, ci::ivec2 *minCell, ci::ivec2 *maxCell ) const;
+	
+	ci::ivec2					mGridSize;
+	float						mCellSize;
+	std::vector<ForceProbe>		mProbes;
+	std::vector<ci::ivec2>		mCellRanges;
+	std::vector<int32_t>		mCellIndices;
+};
@@ -0,0 +1,56 @@
+//
+//  WebReadback.h
+//  SpiderWeb
+//
+//  Gets the simulated buffers back for SolverStats without stalling on the physics
+//  pass. Each request copies positions, velocities and flags into one of two staging
+//  buffers on the GPU and fences it. The copy is mapped a frame or more later, once
+//  the fence says it's done. Same scheme as ParticleReadback in TextParticles.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include <functional>
+
+class SolverReadback {
+  public:
+	//! A finished copy, only valid inside the poll() callback
+	struct Frame {
+		const ci::vec4	*positionMass;
+		const ci::vec3	*velocities;
+		const int32_t	*flags;
+		size_t			count;
+		int				frame;		// what was passed to request()
+		double			time;
+	};
+	
+	SolverReadback();
+	~SolverReadback();
+	
+	//! Queues a copy of the first \a count points of each buffer. Returns false when both staging buffers
+	//! are still waiting to be read, the caller can just try again later.
+	bool	request( const ci::gl::VboRef &positions, const ci::gl::VboRef &velocities, const ci::gl::VboRef &flags, size_t count, int frame, double time );
+	//! Maps the oldest copy if the GPU is done with it and hands it to \a fn. Never waits, returns false if nothing
+	//! was ready. Copies are consumed in request order, even one that fails to map and never reaches \a fn.
+	bool	poll( const std::function<void( const Frame& )> &fn );
+	//! Drops the copies in flight, for when the simulated buffers are replaced.
+	void	clear();
+	
+	size_t	getPendingCount() const		{ return mPending; }
+	
+  private:
+	struct Slot {
+		Slot() : fence( 0 ), count( 0 ), frame( 0 ), time( 0.0 ) {}
+		
+		ci::gl::VboRef	buffer;
+		GLsync			fence;
+		size_t			count;
+		int				frame;
+		double			time;
+	};
+	
+	Slot	mSlots[2];
+	size_t	mReadIndex;		// oldest copy in flight
+	size_t	mPending;
+};
@@ -0,0 +1,54 @@
+//
+//  WebSkeleton.h
+//  SpiderWeb
+//
+//  Decimated "skeleton" of a web for the coarse-simulation, fine-render mode. Only the
+//  skeleton points are simulated. Every other ray point is rebuilt each frame from its
+//  parametric position between the two skeleton points around it on the same ray.
+//
+
+#pragma once
+
+#include "cinder/Vector.h"
+#include "SpiderWeb.h"
+#include <utility>
+#include <vector>
+
+class WebSkeleton {
+  public:
+	//! A full web point is mix( skeleton[a], skeleton[b], t ). Skeleton points map to themselves with t = 0.
+	struct Link {
+		Link() : a( 0 ), b( 0 ), t( 0.0f ) {}
+		Link( int32_t a, int32_t b, float t ) : a( a ), b( b ), t( t ) {}
+		
+		int32_t	a, b;
+		float	t;
+	};
+	
+	//! (skeleton index, rest length)
+	typedef std::vector<std::pair<int32_t, float>> NeighborList;
+	
+	WebSkeleton() {}
+	
+	//! Picks the skeleton from \a web, keeping every \a stride -th point along each ray plus
+	//! the ends of each ray and every point that isn't on a ray (anchors, edges, y-strand joints).
+	void build( const SpiderWebRef &web, int stride );
+	
+	//! CPU reference of reconstruct.vert, writes a position for every web point.
+	void reconstruct( const ci::vec4 *skeletonPositions, ci::vec4 *fullPositions ) const;
+	
+	size_t							getPointCount() const		{ return mLinks.size(); }
+	size_t							getSkeletonCount() const	{ return mSkeletonIds.size(); }
+	//! Web point id of every skeleton point.
+	const std::vector<int32_t>&		getSkeletonIds() const		{ return mSkeletonIds; }
+	//! Springs between skeleton points, runs of dropped ray points are folded into one spring and
+	//! springs to a dropped point are moved to the skeleton point nearest it.
+	const std::vector<NeighborList>& getNeighbors() const		{ return mNeighbors; }
+	//! One link per web point, indexed by web point id.
+	const std::vector<Link>&		getLinks() const			{ return mLinks; }
+	
+  private:
+	std::vector<int32_t>		mSkeletonIds;
+	std::vector<NeighborList>	mNeighbors;
+	std::vector<Link>			mLinks;
+};
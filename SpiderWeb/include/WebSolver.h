@@ -0,0 +1,56 @@
+//
+//  WebSolver.h
+//  SpiderWeb
+//
+//  CPU port of update.vert, for running webs without a GL context.
+//
+
+#pragma once
+
+#include "SpiderWeb.h"
+#include "cinder/Vector.h"
+#include <vector>
+
+class WebSolver {
+  public:
+	//! Mirrors the uniforms of update.vert
+	struct Params {
+		Params() : springConstant( 8.5f ), damping( 2.8f ), tension( 0.8f ), timestep( 0.2f ), gravity( 0.0f, 0.08f, 0.0f ) {}
+		
+		float		springConstant;	// k
+		float		damping;		// c
+		float		tension;
+		float		timestep;		// t
+		ci::vec3	gravity;
+	};
+	
+	WebSolver() : mThreaded( true ) {}
+	
+	//! Flattens \a web into the same four-connection layout setupBuffers() hands to the GPU.
+	void setup( const SpiderWebRef &web );
+	//! Advances the web by \a iterations steps of update.vert.
+	void step( int iterations = 1 );
+	
+	void			setParams( const Params &params )	{ mParams = params; }
+	const Params&	getParams() const					{ return mParams; }
+	//! Splits each step across worker threads. Turn it off when several solvers already run side by side.
+	void			setThreaded( bool threaded )		{ mThreaded = threaded; }
+	
+	size_t							getPointCount() const		{ return mPositions.size(); }
+	const std::vector<ci::vec4>&	getPositions() const		{ return mPositions; }
+	const std::vector<ci::vec4>&	getRestPositions() const	{ return mRestPositions; }
+	const std::vector<ci::vec3>&	getVelocities() const		{ return mVelocities; }
+	//! SolverStats::Flags of the last step
+	const std::vector<int32_t>&		getFlags() const			{ return mFlags; }
+	
+  private:
+	void stepRange( size_t begin, size_t end );
+	
+	Params					mParams;
+	bool					mThreaded;
+	std::vector<ci::vec4>	mPositions, mRestPositions, mNextPositions;
+	std::vector<ci::vec3>	mVelocities, mNextVelocities;
+	std::vector<ci::ivec4>	mConnections;
+	std::vector<ci::vec4>	mConnectionLen;
+	std::vector<int32_t>	mFlags;
+};
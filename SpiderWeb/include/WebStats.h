@@ -0,0 +1,69 @@
+//
+//  WebStats.h
+//  SpiderWeb
+//
+//  Solver health numbers, sampled from the simulated buffers every few frames,
+//  plus what was lost when the web was flattened into four connections per point.
+//
+
+#pragma once
+
+#include "cinder/Filesystem.h"
+#include "cinder/Vector.h"
+#include <deque>
+
+//! One sample of the solver state.
+struct SolverSample {
+	SolverSample() : frame( 0 ), time( 0.0 ), kineticEnergy( 0.0f ), maxVelocity( 0.0f ), clampedCount( 0 ), nonFiniteCount( 0 ) {}
+	
+	int		frame;
+	double	time;
+	float	kineticEnergy;	// sum of 0.5 * m * |v|^2
+	float	maxVelocity;
+	int		clampedCount;	// points whose displacement hit the clamp in update.vert
+	int		nonFiniteCount;	// points with a NaN or inf position or velocity
+};
+
+//! Connection stats of the web as it was handed to the solver.
+struct GenerationStats {
+	GenerationStats() : pointCount( 0 ), truncatedCount( 0 ), droppedConnections( 0 ), isolatedCount( 0 ), maxNeighbors( 0 ) {}
+	
+	//! Records a point with \a neighborCount connections, of which only \a cap are kept.
+	void addPoint( size_t neighborCount, size_t cap );
+	
+	int		pointCount;
+	int		truncatedCount;		// points that had more neighbors than the cap
+	int		droppedConnections;	// connections lost to the cap
+	int		isolatedCount;		// points without any neighbor
+	int		maxNeighbors;
+};
+
+class SolverStats {
+  public:
+	//! Bits written to tf_flags by update.vert
+	enum Flags { FLAG_CLAMPED = 1, FLAG_NON_FINITE = 2 };
+	
+	SolverStats( size_t maxHistory = 3600 ) : mMaxHistory( maxHistory ) {}
+	
+	//! Measures \a count points. \a flags may be null, then clamping isn't counted and
+	//! non-finite values are detected from the positions and velocities alone. Batches smaller than \a grain run inline.
+	static SolverSample measure( const ci::vec4 *positionMass, const ci::vec3 *velocities, const int32_t *flags, size_t count, size_t grain = 4096 );
+	
+	void	record( const SolverSample &sample );
+	void	clear()										{ mHistory.clear(); }
+	void	setGeneration( const GenerationStats &stats )	{ mGeneration = stats; }
+	
+	const SolverSample&				getLast() const			{ return mLast; }
+	const GenerationStats&			getGeneration() const	{ return mGeneration; }
+	const std::deque<SolverSample>&	getHistory() const		{ return mHistory; }
+	
+	//! Writes the generation stats as a comment header followed by one row per sample.
+	//! Returns false if the file couldn't be opened.
+	bool	writeCsv( const ci::fs::path &path ) const;
+	
+  private:
+	size_t						mMaxHistory;
+	SolverSample				mLast;
+	GenerationStats				mGeneration;
+	std::deque<SolverSample>	mHistory;
+};
@@ -0,0 +1,83 @@
+//
+//  WebSweep.h
+//  SpiderWeb
+//
+//  Runs a grid of solver parameters over a set of seeded webs on the CPU,
+//  one combination per worker, and reports how each one settles.
+//
+
+#pragma once
+
+#include "WebSolver.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Rect.h"
+#include <string>
+#include <vector>
+
+class ParameterSweep {
+  public:
+	
+	typedef class Options {
+	  public:
+		Options();
+		
+		// VALUES to try for each solver parameter
+		Options& springConstants( const std::vector<float> &values ) { mSpringConstants = values; return *this; }
+		Options& dampings( const std::vector<float> &values ) { mDampings = values; return *this; }
+		Options& tensions( const std::vector<float> &values ) { mTensions = values; return *this; }
+		Options& timesteps( const std::vector<float> &values ) { mTimesteps = values; return *this; }
+		
+		// SEEDS of the webs every combination runs on
+		Options& seeds( const std::vector<int32_t> &seeds ) { mSeeds = seeds; return *this; }
+		// AREA the generated webs are laid out in, and their radius base. Defaults to the app's window size
+		Options& bounds( const ci::Rectf &bounds ) { mBounds = bounds; return *this; }
+		Options& radiusBase( float radius ) { mRadiusBase = radius; return *this; }
+		
+		// NUMBER of frames to simulate, and solver iterations per frame
+		Options& frames( int frames ) { mFrames = frames; return *this; }
+		Options& iterationsPerFrame( int iterations ) { mIterationsPerFrame = iterations; return *this; }
+		
+		// AMOUNT of kinetic energy per point below which the web counts as settled
+		Options& settleEnergy( float energy ) { mSettleEnergy = energy; return *this; }
+		
+		//! Sets the option called \a name from comma separated \a values, e.g. ( "dampings", "2.0,2.8,6.0" ).
+		//! Names are those of the setters above, except bounds and radiusBase. Returns false if either can't be read.
+		bool parse( const std::string &name, const std::string &values );
+		//! Reads one "name values" option per line from \a path, skipping blank lines and # comments.
+		//! Returns false, and logs the line, at the first one that can't be read.
+		bool load( const ci::fs::path &path );
+		
+		std::vector<float>		mSpringConstants, mDampings, mTensions, mTimesteps;
+		std::vector<int32_t>	mSeeds;
+		ci::Rectf				mBounds;
+		float					mRadiusBase;
+		int						mFrames, mIterationsPerFrame;
+		float					mSettleEnergy;
+	} Options;
+	
+	struct Result {
+		WebSolver::Params	params;
+		int32_t				seed;
+		int					pointCount;
+		int					settleFrame;		// first frame after which the web stays settled, -1 if it never does
+		float				peakDisplacement;	// largest distance of any point from its rest position
+		float				finalSag;			// mean downward displacement on the last frame
+		float				finalEnergy;
+		int					clampedFrames;		// frames in which any point hit the displacement clamp
+		bool				stable;				// settled without ever producing NaN or inf
+	};
+	
+	ParameterSweep( const Options &options = Options() ) : mOptions( options ) {}
+	
+	//! Generates the seeded webs, then simulates every combination across all cores.
+	//! Touches neither the window nor GL, so it can run before the app has either.
+	std::vector<Result>	run() const;
+	
+	//! Writes one row per result. Returns false if the file couldn't be opened.
+	static bool writeCsv( const std::vector<Result> &results, const ci::fs::path &path );
+	
+  private:
+	Result simulate( const WebSolver &web, int32_t seed, const WebSolver::Params &params ) const;
+	
+	Options		mOptions;
+};
@@ -56,7 +56,7 @@ void WebRay::makePoints( ParticleRef webCenter, float avgLen, int pointCount )
 
 void WebRay::connectStrands( const std::vector<WebRayRef> &rays )
 {
-	float radialNoise = randFloat( 100 );
+	float radialNoise = mRand->nextFloat( 100 );
 	vector<vec2> strands;
 	vec2 webCenter = mWebCenter->getPosition();
 	
@@ -71,7 +71,7 @@ void WebRay::connectStrands( const std::vector<WebRayRef> &rays )
 		float floatI = float( i );
 		
 		// randomly DON'T draw a line
-		int randomChance = randInt( 20 );
+		int randomChance = mRand->nextInt( 20 );
 //		randomChance = 0;
 //		randomChance = 4;
 		if (randomChance == 0 || randomChance == 19 || randomChance == 18) { continue; }
@@ -94,8 +94,8 @@ void WebRay::connectStrands( const std::vector<WebRayRef> &rays )
 		
 		// Get a random distance to place the starting point at. it will be within a range above and
 		// below the original point. The further away from the center, the more variation it can have
-		float pointDist = getRandomPoint( diffFromCenter, floatI * 0.2, mStrandLength);	// random across
-//		float pointDist = getRandomPoint( diffFromCenter, 1.0, mStrandLength);		// uniform across
+		float pointDist = getRandomPoint( *mRand, diffFromCenter, floatI * 0.2, mStrandLength);	// random across
+//		float pointDist = getRandomPoint( *mRand, diffFromCenter, 1.0, mStrandLength);		// uniform across
 		
 		// make sure they are not connecting to points that don't exist
 		pointDist = (pointDist > mStrandLength) ? mStrandLength : pointDist;
@@ -105,13 +105,13 @@ void WebRay::connectStrands( const std::vector<WebRayRef> &rays )
 													   webCenter.y + sin( mAngle ) * pointDist ) );
 		
 		// next point distance
-		int randomizeNext = randInt( 4 );
+		int randomizeNext = mRand->nextInt( 4 );
 //		randomizeNext = 1;
 		switch (randomizeNext)
 		{
 			case 0:
 				// randomize within a range of the parallel strand point
-				pointDist = distance( nextStrand->getPtByIndex( i )->getPosition(), ( mWebCenter->getPosition() ) ) + randFloat( floatI * -1.2, floatI * 1.2 );
+				pointDist = distance( nextStrand->getPtByIndex( i )->getPosition(), ( mWebCenter->getPosition() ) ) + mRand->nextFloat( floatI * -1.2, floatI * 1.2 );
 				if( pointDist > nextStrand->mStrandLength )
 					pointDist = nextStrand->mStrandLength;
 				break;
@@ -138,7 +138,7 @@ void WebRay::connectStrands( const std::vector<WebRayRef> &rays )
 		// draw another line from the point
 		if (randomChance == 2)
 		{
-			pointDist = getRandomPoint( diffFromCenter, floatI * 0.8, nextStrand->mStrandLength);
+			pointDist = getRandomPoint( *mRand, diffFromCenter, floatI * 0.8, nextStrand->mStrandLength);
 			addStrand( thisPoint, nextAngle, nextStrand, pointDist );
 		}
 		
@@ -146,20 +146,20 @@ void WebRay::connectStrands( const std::vector<WebRayRef> &rays )
 		// draws a much longer line from the start point (which can be from either side.)
 		else if (randomChance == 3)
 		{
-			float startAngle = (round(randFloat()) == 0) ? nextAngle : mAngle;
+			float startAngle = (round(mRand->nextFloat()) == 0) ? nextAngle : mAngle;
 			
 			if( startAngle == nextAngle )
 			{
 				auto startPoint = thisPoint;
 				float strandLen = nextStrand->mStrandLength;
-				float pointDist = getRandomPoint( diffFromCenter, floatI * randFloat() * 4 + 6, strandLen);
+				float pointDist = getRandomPoint( *mRand, diffFromCenter, floatI * mRand->nextFloat() * 4 + 6, strandLen);
 				addStrand( startPoint, startAngle, nextStrand, pointDist );
 			}
 			else
 			{
 				auto startPoint = thisPoint;
 				float strandLen = nextStrand->mStrandLength;
-				float pointDist = getRandomPoint( diffFromCenter, floatI * randFloat() * -4 - 6, strandLen);
+				float pointDist = getRandomPoint( *mRand, diffFromCenter, floatI * mRand->nextFloat() * -4 - 6, strandLen);
 				addStrand( startPoint, nextAngle, nextStrand, pointDist );
 			}
 		}
@@ -174,17 +174,17 @@ void WebRay::addYStrand( ParticleRef thisPoint, ParticleRef nextPoint, float nex
 	float nextPointDist = distance( nextPoint->getPosition(), ( mWebCenter->getPosition() ) );
 	float thisPointDist = distance( thisPoint->getPosition(), ( mWebCenter->getPosition() ) );
 	
-	float randPart = randFloat( 0.2, 0.8 );		// percentage between 2 points
+	float randPart = mRand->nextFloat( 0.2, 0.8 );		// percentage between 2 points
 	auto partialPoint = Particle::create( thisPoint->getPosition() + ((nextPoint->getPosition() - thisPoint->getPosition()) * vec2(randPart, randPart)) );
 //	addRayPoint( partialPoint );
 	mAllPoints.push_back( partialPoint );
 	
 	// find extra points for "y" shape
-	float pointDev = randFloat( 2.0, 8.0 );
+	float pointDev = mRand->nextFloat( 2.0, 8.0 );
 	float startAngle, endAngle;
 	ParticleRef startPt, endPt;
 	float startDist, endDist;
-	if( randBool() ) {
+	if( mRand->nextBool() ) {
 		startAngle = nextAngle;
 		endAngle = mAngle;
 		startPt = thisPoint;
@@ -286,6 +286,11 @@ void WebRay::connectRay()
 SpiderWeb::SpiderWeb( const Options &options )
 {
 	mOptions = options;
+	mRand.seed( options.getSeed() );
+	// default to the window when no bounds are given
+	mBounds = options.getBounds();
+	if( mBounds.calcArea() <= 0.0f )
+		mBounds = Rectf( getWindowBounds() );
 }
 
 
@@ -341,21 +346,21 @@ void SpiderWeb::addAchors()
 {
 	int anchorCount = mOptions.getAnchorCount();
 	float angleDiff = (M_PI * 2.0f) / anchorCount;
-	float maxX = GUTTER;
-	float minX = getWindowWidth() - GUTTER;
-	float maxY = GUTTER;
-	float minY = getWindowHeight() - GUTTER;
+	float maxX = mBounds.x1 + GUTTER;
+	float minX = mBounds.x2 - GUTTER;
+	float maxY = mBounds.y1 + GUTTER;
+	float minY = mBounds.y2 - GUTTER;
 	float radiusSum = 0.0f;
 	
 	
 	// generate anchors
 	for( int i = 0; i < anchorCount; i++ )
 	{
-		float angle = ( i * angleDiff ) + randFloat( -0.5, 0.5 );
-		float r = mOptions.getRadiusBase() * (randFloat() + 0.5);
+		float angle = ( i * angleDiff ) + mRand.nextFloat( -0.5, 0.5 );
+		float r = mOptions.getRadiusBase() * (mRand.nextFloat() + 0.5);
 		radiusSum += r;
-		float pX = getWindowCenter().x + cos( angle ) * r;
-		float pY = getWindowCenter().y + sin( angle ) * r;
+		float pX = mBounds.getCenter().x + cos( angle ) * r;
+		float pY = mBounds.getCenter().y + sin( angle ) * r;
 		
 		pX = (pX > maxX) ? pX : maxX;
 		pX = (pX < minX) ? pX : minX;
@@ -386,10 +391,10 @@ ci::vec2 SpiderWeb::findEdgePoint( const ci::vec2 &origPos )
 	vec2 intersection = vec2(NAN, NAN);
 	vec2 centerPos = mWebCenter->getPosition();
 	vec2 pos = centerPos + ( normalize( origPos - centerPos ) * vec2( 1000, 1000 ) ); // extend line out
-	vec2 UL = vec2(getWindowBounds().getUL());
-	vec2 UR = vec2(getWindowBounds().getUL()) + vec2( getWindowWidth(), 0 );
-	vec2 LR = vec2(getWindowBounds().getLR());
-	vec2 LL = vec2(getWindowBounds().getUL()) + vec2( 0, getWindowHeight() );
+	vec2 UL = mBounds.getUpperLeft();
+	vec2 UR = mBounds.getUpperRight();
+	vec2 LR = mBounds.getLowerRight();
+	vec2 LL = mBounds.getLowerLeft();
 	int wall = 0;
 	while( isnan( intersection.x ) && wall < 4 ){
 		switch( wall ){
@@ -414,7 +419,7 @@ ci::vec2 SpiderWeb::findEdgePoint( const ci::vec2 &origPos )
 
 void SpiderWeb::addSubAnchors()
 {
-	float spacingNoise = randFloat( 10.0f );
+	float spacingNoise = mRand.nextFloat( 10.0f );
 	
 	// between each anchor, place new points for rays to anchor to
 	for( auto iter = mAnchors.begin(); iter != mAnchors.end(); ++iter ) {
@@ -428,7 +433,7 @@ void SpiderWeb::addSubAnchors()
 		float dist			= length( diff );
 		float angle			= atan2(diff.y, diff.x);
 		int linePointAmt	= floor( dist / mOptions.getRaySpacing() );
-		float rAngleFactor	= randFloat(0.05, 0.3);
+		float rAngleFactor	= mRand.nextFloat(0.05, 0.3);
 		
 		// make the curve more random so that it's not perfect
 		float angleDif = M_PI * rAngleFactor;   // the random angle that will be sloped between points
@@ -445,7 +450,7 @@ void SpiderWeb::addSubAnchors()
 		vector<ParticleRef> bezPts;
 		vector<ParticleRef> rayPoints;
 		
-		auto r = WebRay::create( mRays.size(), (*iter), mWebCenter, spacingNoise );
+		auto r = WebRay::create( mRays.size(), (*iter), mWebCenter, spacingNoise, &mRand );
 		mRays.push_back( r );
 		
 		for( int i = 1; i < linePointAmt; i++ )
@@ -462,7 +467,7 @@ void SpiderWeb::addSubAnchors()
 			
 			// create rays (which contain particle vector)
 			auto rayPoint = bezPts[i-1];
-			auto r = WebRay::create( mRays.size(), rayPoint, mWebCenter, spacingNoise );
+			auto r = WebRay::create( mRays.size(), rayPoint, mWebCenter, spacingNoise, &mRand );
 			mRays.push_back( r );
 			
 			if( i>0 ){
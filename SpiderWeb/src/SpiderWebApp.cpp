@@ -3,21 +3,58 @@
 #include "cinder/gl/gl.h"
 #include "cinder/Rand.h"
 #include "cinder/gl/BufferTexture.h"
+#include "cinder/gl/Fbo.h"
+#include "cinder/ImageIo.h"
 #include "cinder/Log.h"
+#include "cinder/Timer.h"
+#include "cinder/Utilities.h"
 #include "cinder/params/Params.h"
-#include "cinder/perlin.h"
 #include "SpiderWeb.h"
+#include "WebNoise.h"
+#include "WebProbes.h"
+#include "WebSkeleton.h"
+#include "WebReadback.h"
+#include "WebStats.h"
+#include "WebSweep.h"
+#include "WebCandidates.h"
+#include "StrandLod.h"
+#include <cstddef>
+#include <future>
+#include <map>
+#include <set>
 
 using namespace ci;
 using namespace ci::app;
 using namespace std;
 
-const uint32_t MAX_POINTS = 50000;
 const uint32_t POSITION_INDEX		= 0;
 const uint32_t VELOCITY_INDEX		= 1;
 const uint32_t CONNECTION_INDEX		= 2;
 const uint32_t CONNECTION_LEN_INDEX	= 3;
 const uint32_t COLOR_INDEX			= 4;
+const uint32_t PREV_FLAGS_INDEX		= 5;	// tf_flags of the previous iteration, accumulated by update.vert
+const uint32_t SOLVER_FLAGS_INDEX	= 2;	// transform feedback binding of tf_flags
+
+// attributes of the coarse mode reconstruction pass
+const uint32_t SKELETON_PAIR_INDEX	= 0;
+const uint32_t SKELETON_ALONG_INDEX	= 1;
+
+const uint32_t MAX_PROBES			= 32;
+const uint32_t MOUSE_PROBE_ID		= 0xFFFFFFFF;	// touch ids never reach this
+
+//! Copies the first \a count elements of \a vbo back, waiting on the GPU. Only for the checks, never per frame.
+template<typename T>
+static vector<T> readBack( const gl::VboRef &vbo, size_t count )
+{
+	vector<T> result;
+	const T *data = (const T*)vbo->mapBufferRange( 0, count * sizeof(T), GL_MAP_READ_BIT );
+	if( data ) {
+		result.assign( data, data + count );
+		vbo->unmap();
+	}
+	return result;
+}
+const float    PROBE_CELL_SIZE		= 64.0f;
 
 typedef class Options {
 	public:
@@ -62,11 +99,30 @@ class SpiderWebApp : public App {
 	void mouseDrag( MouseEvent event ) override;
 	void mouseUp( MouseEvent event ) override;
 	void keyDown( KeyEvent event ) override;
+	void touchesBegan( TouchEvent event ) override;
+	void touchesMoved( TouchEvent event ) override;
+	void touchesEnded( TouchEvent event ) override;
 	
 	void updateRayPosition( const ci::ivec2 &mousePos, bool useDistance );
+	void updateProbes();
+	void checkProbes();
+	void setupProbeBuffers();
+	void updateLod();
+	void runLodPass( const gl::VboRef &indices, GLuint query );
+	void checkLod();
+	void drawStrands( bool quads, const vec2 &viewportSize );
+	void benchmarkStrands();
+	void checkStrands();
+	void setupReconstructBuffers( const vec4 *colors );
+	void reconstructWeb();
+	void checkReconstruct();
+	gl::VaoRef getRenderVao();
+	void sampleSolver();
+	void exportStats();
 	
 	void reset();
 	void generateWeb();
+	SpiderWeb::Options randomWebOptions();
 	void setupBuffers();
 	void setupGlsl();
 	
@@ -75,24 +131,79 @@ class SpiderWebApp : public App {
 	
 	std::array<gl::VaoRef, 2>			mVaos;
 	std::array<gl::VboRef, 2>			mPositions, mVelocities, mConnections, mConnectionLen, mColors;
-	std::array<gl::BufferTextureRef, 2>	mPositionBufTexs;
+	std::array<gl::BufferTextureRef, 2>	mPositionBufTexs, mVelocityBufTexs;
 	gl::VboRef							mLineIndices;
 	
 	gl::TransformFeedbackObjRef			mFeedbackObj[2];
 	
-	gl::GlslProgRef						mUpdateGlsl, mRenderGlsl;
+	gl::GlslProgRef						mUpdateGlsl, mRenderGlsl, mStrandGlsl, mLodGlsl, mReconstructGlsl;
 	uint32_t							mIterationsPerFrame, mIterationIndex;
 	CameraPersp							mCam;
 	float								mCurrentCamRotation;
 	params::InterfaceGlRef				mParams;
 	std::shared_ptr<Options>			mOptions;
+	bool								mDrawStrands;		// anti-aliased quads instead of GL_LINES
+	float								mStrandWidth;
+	GLuint								mStrandTimeQuery;	// GL_TIME_ELAPSED for the strands drawn each frame
+	bool								mStrandTimePending;
+	float								mStrandMs;			// GPU time of the last timed strand draw
+	float								mLinesMs, mQuadsMs;	// per draw of the web offscreen, from benchmarkStrands()
+	int									mStrandMaxDiff;		// largest difference from the MSAA lines, from checkStrands()
+	
+	// pointer interaction, one probe per touch plus one for the mouse
+	std::map<uint32_t, ForceProbe>		mProbeMap;
+	ProbeGrid							mProbeGrid;
+	gl::VboRef							mProbeVbo, mProbeCellVbo, mProbeIndexVbo;
+	gl::BufferTextureRef				mProbeTex, mProbeCellTex, mProbeIndexTex;
+	float								mProbeRadius, mProbeStrength;
+	
+	// strand level of detail, see StrandLod.h
+	gl::VboRef							mLodIndices[2];		// compacted index pairs of the strands that survive, one drawn while the other is written
+	int									mLodDrawIndex;		// the buffer mStrandsDrawn counts
+	GLuint								mLodQuery;			// GL_PRIMITIVES_WRITTEN for the lod pass
+	bool								mLodEnabled, mLodPending;
+	float								mLodMinLength;		// strands shorter than this many pixels are culled
+	int									mStrandsTotal, mStrandsDrawn;
+	
+	// coarse simulation, fine render. Only the skeleton is simulated, the
+	// rest of the points are rebuilt from it every frame into the render buffers.
+	bool								mCoarseMode;
+	int									mSkeletonStride;	// keep every nth point along each ray
+	int									mSimulatedCount, mPointCount;
+	WebSkeleton							mSkeleton;
+	gl::VaoRef							mReconstructVao, mRenderVao;
+	gl::VboRef							mSkeletonLinks, mRenderPositions, mRenderVelocities, mRenderColors;
+	
+	// solver health, see WebStats.h
+	SolverStats							mSolverStats;
+	SolverSample						mSolverSample;		// last sample, shown in the params
+	GenerationStats						mGenerationStats;
+	std::array<gl::VboRef, 2>			mSolverFlags;		// tf_flags of each frame's iterations so far, next to mPositions
+	SolverReadback						mSolverReadback;
+	bool								mStatsEnabled;
+	int									mStatsInterval;		// frames between readbacks
+	
+	// best-of-n generation, see WebCandidates.h
+	bool								mBestOfN;
+	int									mCandidateCount;
+	float								mWebScore;
+	int									mCandidatesFinished;	// how many made the time budget
 	
 	gl::TextureRef						mTreesBg;
+	BatchFbm							mAlphaNoise;		// shared between resets instead of a new Perlin per web
 };
 
 SpiderWebApp::SpiderWebApp()
 : mIterationsPerFrame( 5 ), mIterationIndex( 0 ),
 	mCurrentCamRotation( 0.0f ),
+	mDrawStrands( true ), mStrandWidth( 1.0f ),
+	mStrandTimeQuery( 0 ), mStrandTimePending( false ), mStrandMs( 0.0f ), mLinesMs( 0.0f ), mQuadsMs( 0.0f ), mStrandMaxDiff( 0 ),
+	mProbeRadius( 30.0f ), mProbeStrength( 1.0f ),
+	mLodDrawIndex( 0 ), mLodQuery( 0 ), mLodEnabled( true ), mLodPending( false ), mLodMinLength( 1.0f ),
+	mStrandsTotal( 0 ), mStrandsDrawn( 0 ),
+	mCoarseMode( false ), mSkeletonStride( 4 ), mSimulatedCount( 0 ), mPointCount( 0 ),
+	mStatsEnabled( true ), mStatsInterval( 30 ),
+	mBestOfN( true ), mCandidateCount( 4 ), mWebScore( 0.0f ), mCandidatesFinished( 0 ),
 	mCam( getWindowWidth(), getWindowHeight(), 60.0f, 0.01f, 1000.0f )
 {
 //	vec3 eye = vec3( getWindowCenter().x, getWindowCenter().y, 1000.0f );
@@ -128,11 +239,63 @@ SpiderWebApp::SpiderWebApp()
 			mUpdateGlsl->uniform( "t", mOptions->getTimestep() );
 		});
 	mParams->addSeparator();
+	mParams->addParam( "AA Strands", &mDrawStrands ).key( "a" );
+	mParams->addParam( "Strand Width", &mStrandWidth ).min( 0.25f ).max( 4.0f ).precision( 2 ).step( 0.05f ).updateFn(
+		[&](){
+			mStrandGlsl->uniform( "uStrandWidth", mStrandWidth );
+		});
+	mParams->addParam( "Strands GPU ms", &mStrandMs, true );
+	mParams->addButton( "Benchmark Strands", bind( &SpiderWebApp::benchmarkStrands, this ) );
+	mParams->addParam( "Lines ms", &mLinesMs, true );
+	mParams->addParam( "Quads ms", &mQuadsMs, true );
+	mParams->addButton( "Check Strands", bind( &SpiderWebApp::checkStrands, this ) );
+	mParams->addParam( "Strand Max Diff", &mStrandMaxDiff, true );
+	mParams->addParam( "Probe Radius", &mProbeRadius ).min( 5.0f ).max( 200.0f ).step( 1.0f );
+	mParams->addParam( "Probe Strength", &mProbeStrength ).min( 0.0f ).max( 1.0f ).precision( 2 ).step( 0.05f );
+	mParams->addButton( "Check Probe Pass", bind( &SpiderWebApp::checkProbes, this ) );
+	mParams->addSeparator();
+	mParams->addParam( "LOD Strands", &mLodEnabled ).key( "l" );
+	mParams->addParam( "LOD Min Pixels", &mLodMinLength ).min( 0.0f ).max( 8.0f ).precision( 2 ).step( 0.25f );
+	mParams->addParam( "Strands Total", &mStrandsTotal, true );
+	mParams->addParam( "Strands Drawn", &mStrandsDrawn, true );
+	mParams->addButton( "Check LOD Pass", bind( &SpiderWebApp::checkLod, this ) );
+	mParams->addSeparator();
+	mParams->addParam( "Coarse Sim", &mCoarseMode ).updateFn(
+		[&](){
+			mIterationIndex = 0;
+			setupBuffers();
+		});
+	mParams->addParam( "Skeleton Stride", &mSkeletonStride ).min( 1 ).max( 16 ).updateFn(
+		[&](){
+			if( mCoarseMode ) {
+				mIterationIndex = 0;
+				setupBuffers();
+			}
+		});
+	mParams->addParam( "Simulated Points", &mSimulatedCount, true );
+	mParams->addButton( "Check Reconstruct Pass", bind( &SpiderWebApp::checkReconstruct, this ) );
+	mParams->addSeparator();
+	mParams->addParam( "Solver Stats", &mStatsEnabled );
+	mParams->addParam( "Stats Interval", &mStatsInterval ).min( 1 ).max( 600 );
+	mParams->addParam( "Kinetic Energy", &mSolverSample.kineticEnergy, true );
+	mParams->addParam( "Max Velocity", &mSolverSample.maxVelocity, true );
+	mParams->addParam( "Clamped", &mSolverSample.clampedCount, true );
+	mParams->addParam( "NaN / Inf", &mSolverSample.nonFiniteCount, true );
+	mParams->addParam( "Truncated Points", &mGenerationStats.truncatedCount, true );
+	mParams->addParam( "Dropped Links", &mGenerationStats.droppedConnections, true );
+	mParams->addParam( "Isolated Points", &mGenerationStats.isolatedCount, true );
+	mParams->addButton( "Export Stats", bind( &SpiderWebApp::exportStats, this ) );
+	mParams->addSeparator();
+	mParams->addParam( "Best Of N", &mBestOfN );
+	mParams->addParam( "Candidates", &mCandidateCount ).min( 1 ).max( 16 );
+	mParams->addParam( "Web Score", &mWebScore, true );
+	mParams->addParam( "Candidates In Time", &mCandidatesFinished, true );
 	mParams->addButton( "Randomize Web", bind( &SpiderWebApp::reset, this ) );
 	
 	mTreesBg = gl::Texture::create( loadImage( loadAsset( "trees.jpg" ) ) );
 	
 	setupGlsl();
+	setupProbeBuffers();
 	generateWeb();
 	setupBuffers();
 }
@@ -189,13 +352,33 @@ void SpiderWebApp::generateWeb()
 {
 	randSeed( (int32_t)time( NULL ) );
 //	randSeed( 50 );
-	mWeb = SpiderWeb::create( SpiderWeb::Options()
+	if( mBestOfN ) {
+		// MAKE a few webs at once and keep the one that fills the window best
+		vector<SpiderWeb::Options> candidates;
+		for( int i = 0; i < mCandidateCount; ++i )
+			candidates.push_back( randomWebOptions() );
+		
+		WebCandidates picker;
+		mWeb = picker.pick( candidates );
+		mWebScore = picker.getLastScore().total;
+		mCandidatesFinished = picker.getLastFinished();
+		return;
+	}
+	
+	mWeb = SpiderWeb::create( randomWebOptions() );
+	mWeb->make();
+}
+
+SpiderWeb::Options SpiderWebApp::randomWebOptions()
+{
+	// explicit bounds and seed let the web be made off the main thread
+	return SpiderWeb::Options()
 		.anchorCount( randInt(3, 8) )
 		.radiusBase( getWindowWidth() / 2.0 )
 		.rayPointCount( randInt( 20, 50 ) )
 		.raySpacing( randFloat( 20.0, 150.0) )
-	);
-	mWeb->make();
+		.seed( randUint() )
+		.bounds( Rectf( getWindowBounds() ) );
 }
 
 void SpiderWebApp::setupBuffers()
@@ -203,48 +386,93 @@ void SpiderWebApp::setupBuffers()
 	
 	// get all of the points from the spider web
 	
-	 // buffer the positions
-	std::array<vec4, MAX_POINTS> positions;
-	std::array<vec3, MAX_POINTS> velocities;
-	std::array<ivec4, MAX_POINTS> connections;
-	std::array<vec4, MAX_POINTS> connectionLen;
-	std::array<vec4, MAX_POINTS> colors;
-	
 	vector<ParticleRef> webPoints = mWeb->getPoints();
-	int n = 0;
-	Perlin p = Perlin();
+	
+	// staging data is sized from the web, large webs would overflow a fixed array on the stack
+	vector<vec4> positions;
+	vector<vec3> velocities;
+	vector<ivec4> connections;
+	vector<vec4> connectionLen;
+	vector<vec4> colors( webPoints.size() );
+	
+	// START the alpha noise on a worker so it runs while the other buffers are filled and uploaded
+	vector<vec2> noisePoints( webPoints.size() );
 	for( auto iter = webPoints.begin(); iter != webPoints.end(); ++iter ) {
-		auto point = (*iter);
-		vec2 pos = point->getPosition();
-		// create our initial positions
-		positions[point->getId()] = vec4(
-			pos.x, pos.y,
-			0.0,
-			1.0f );
-		// zero out velocities
-		velocities[point->getId()] = vec3( 0.0f );
-		
-		connections[n] = ivec4( -1 );
-		connectionLen[n] = vec4( 0.0 );
-		auto conn = point->getNeighbors();
-		// use first 4 connections of there are more
-		int max = min(int(conn.size()), 4);
-
-		for( int i = 0; i < max; ++i ){
-			auto connection = conn[i];
-			connections[n][i] = connection->getId();
-//			connectionLen[n][i] = distance( normalize(pos), normalize(connection->getPosition()) );
-			connectionLen[n][i] = distance( pos, connection->getPosition() );
+		noisePoints[(*iter)->getId()] = (*iter)->getPosition() / vec2( getWindowSize() );
+	}
+	auto alphaFuture = std::async( std::launch::async, [this, &noisePoints]() {
+		return mAlphaNoise.eval( noisePoints );
+	});
+	
+	mPointCount = webPoints.size();
+	mGenerationStats = GenerationStats();
+	if( mCoarseMode ) {
+		// SIMULATE only the skeleton, the rest of the web is rebuilt from it in reconstructWeb()
+		mSkeleton.build( mWeb, mSkeletonStride );
+		auto &skeletonIds = mSkeleton.getSkeletonIds();
+		auto &neighbors = mSkeleton.getNeighbors();
+		mSimulatedCount = skeletonIds.size();
+		positions.resize( mSimulatedCount );
+		velocities.resize( mSimulatedCount );
+		connections.resize( mSimulatedCount );
+		connectionLen.resize( mSimulatedCount );
+		for( size_t n = 0; n < skeletonIds.size(); ++n ) {
+			vec2 pos = webPoints[skeletonIds[n]]->getPosition();
+			positions[n] = vec4( pos.x, pos.y, 0.0, 1.0f );
+			velocities[n] = vec3( 0.0f );
+			
+			connections[n] = ivec4( -1 );
+			connectionLen[n] = vec4( 0.0 );
+			// use first 4 connections of there are more
+			mGenerationStats.addPoint( neighbors[n].size(), 4 );
+			int max = min( int( neighbors[n].size() ), 4 );
+			for( int i = 0; i < max; ++i ){
+				connections[n][i] = neighbors[n][i].first;
+				connectionLen[n][i] = neighbors[n][i].second;
+			}
 		}
-		n++;
-		
-		// DEFINE alpha - helps make the line thickness look a bit varied
-		float x = pos.x / getWindowWidth();
-		float y = pos.y / getWindowHeight();
-		float a = p.fBm( x, y ) * 2.0;
-		a += 0.35;
-		colors[point->getId()] = vec4( vec3( 1.0 ), a );
 	}
+	else {
+		mSimulatedCount = mPointCount;
+		positions.resize( mSimulatedCount );
+		velocities.resize( mSimulatedCount );
+		connections.resize( mSimulatedCount );
+		connectionLen.resize( mSimulatedCount );
+		int n = 0;
+		for( auto iter = webPoints.begin(); iter != webPoints.end(); ++iter ) {
+			auto point = (*iter);
+			vec2 pos = point->getPosition();
+			// create our initial positions
+			positions[point->getId()] = vec4(
+				pos.x, pos.y,
+				0.0,
+				1.0f );
+			// zero out velocities
+			velocities[point->getId()] = vec3( 0.0f );
+			
+			connections[n] = ivec4( -1 );
+			connectionLen[n] = vec4( 0.0 );
+			auto conn = point->getNeighbors();
+			// use first 4 connections of there are more
+			mGenerationStats.addPoint( conn.size(), 4 );
+			int max = min(int(conn.size()), 4);
+	
+			for( int i = 0; i < max; ++i ){
+				auto connection = conn[i];
+				connections[n][i] = connection->getId();
+	//			connectionLen[n][i] = distance( normalize(pos), normalize(connection->getPosition()) );
+				connectionLen[n][i] = distance( pos, connection->getPosition() );
+			}
+			n++;
+		}
+	}
+	mSolverStats.clear();
+	mSolverStats.setGeneration( mGenerationStats );
+	mSolverReadback.clear();
+	if( mGenerationStats.truncatedCount > 0 )
+		CI_LOG_W( mGenerationStats.truncatedCount << " points lost " << mGenerationStats.droppedConnections << " connections to the 4 neighbor cap" );
+	
+	vector<int32_t> flags( mSimulatedCount, 0 );
 	
 	for ( int i = 0; i < 2; i++ ) {
 		mVaos[i] = gl::Vao::create();
@@ -284,6 +512,17 @@ void SpiderWebApp::setupBuffers()
 				gl::enableVertexAttribArray( CONNECTION_LEN_INDEX );
 			}
 			
+			// wait for the alpha noise only once the colors are actually needed
+			if( alphaFuture.valid() ) {
+				vector<float> alphas = alphaFuture.get();
+				for( size_t id = 0; id < alphas.size(); ++id ) {
+					// DEFINE alpha - helps make the line thickness look a bit varied
+					float a = alphas[id] * 2.0;
+					a += 0.35;
+					colors[id] = vec4( vec3( 1.0 ), a );
+				}
+			}
+			
 			// buffer the colors
 			mColors[i] = gl::Vbo::create( GL_ARRAY_BUFFER, colors.size() * sizeof(vec4), colors.data(), GL_STATIC_DRAW );
 			{
@@ -293,6 +532,14 @@ void SpiderWebApp::setupBuffers()
 				gl::enableVertexAttribArray( COLOR_INDEX );
 			}
 			
+			// buffer the solver flags, each iteration ORs its own into the previous ones
+			mSolverFlags[i] = gl::Vbo::create( GL_ARRAY_BUFFER, flags.size() * sizeof(int32_t), flags.data(), GL_STREAM_COPY );
+			{
+				gl::ScopedBuffer scopeBuffer( mSolverFlags[i] );
+				gl::vertexAttribIPointer( PREV_FLAGS_INDEX, 1, GL_INT, 0, (const GLvoid*) 0 );
+				gl::enableVertexAttribArray( PREV_FLAGS_INDEX );
+			}
+			
 			// Create a TransformFeedbackObj, which is similar to Vao
 			// It's used to capture the output of a glsl and uses the
 			// index of the feedback's varying variable names.
@@ -302,28 +549,40 @@ void SpiderWebApp::setupBuffers()
 			mFeedbackObj[i]->bind();
 			gl::bindBufferBase( GL_TRANSFORM_FEEDBACK_BUFFER, POSITION_INDEX, mPositions[i] );
 			gl::bindBufferBase( GL_TRANSFORM_FEEDBACK_BUFFER, VELOCITY_INDEX, mVelocities[i] );
+			gl::bindBufferBase( GL_TRANSFORM_FEEDBACK_BUFFER, SOLVER_FLAGS_INDEX, mSolverFlags[i] );
 			mFeedbackObj[i]->unbind();
 		}
 	}
 	// create your two BufferTextures that correspond to your position buffers.
 	mPositionBufTexs[0] = gl::BufferTexture::create( mPositions[0], GL_RGBA32F );
 	mPositionBufTexs[1] = gl::BufferTexture::create( mPositions[1], GL_RGBA32F );
+	// velocities are tightly packed vec3s, read one component at a time when reconstructing
+	mVelocityBufTexs[0] = gl::BufferTexture::create( mVelocities[0], GL_R32F );
+	mVelocityBufTexs[1] = gl::BufferTexture::create( mVelocities[1], GL_R32F );
+	
+	if( mCoarseMode )
+		setupReconstructBuffers( colors.data() );
 	
 	auto strands = mWeb->getUniqueStrands();
 	int lines = strands.size();
 	mConnectionCount = lines;
 	// create the indices to draw links between the cloth points
-	mLineIndices = gl::Vbo::create( GL_ELEMENT_ARRAY_BUFFER, lines * 2 * sizeof(int), nullptr, GL_STATIC_DRAW );
-
-	auto e = (int *) mLineIndices->mapReplace();
+	vector<uint32_t> lineIndices;
+	lineIndices.reserve( lines * 2 );
 	for( auto iter = strands.begin(); iter != strands.end(); ++iter ){
 		auto strand = *iter;
-		*e++ = strand.first->getId();
-		*e++ = strand.second->getId();
+		lineIndices.push_back( strand.first->getId() );
+		lineIndices.push_back( strand.second->getId() );
 	}
+	mLineIndices = gl::Vbo::create( GL_ELEMENT_ARRAY_BUFFER, lineIndices.size() * sizeof(int), lineIndices.data(), GL_STATIC_DRAW );
 	
-	
-	mLineIndices->unmap();
+	// the lod pass writes one of these while the other is drawn. Both start with every strand.
+	for( auto &indices : mLodIndices )
+		indices = gl::Vbo::create( GL_TRANSFORM_FEEDBACK_BUFFER, lineIndices.size() * sizeof(int), lineIndices.data(), GL_STREAM_COPY );
+	mLodDrawIndex = 0;
+	mStrandsTotal = lines;
+	mStrandsDrawn = lines;
+	mLodPending = false;
 }
 
 
@@ -335,6 +594,9 @@ void SpiderWebApp::setupGlsl()
 		"tf_position_mass",
 		"tf_velocity"
 	});
+	// the solver also writes its health flags, in their own buffer
+	std::vector<std::string> updateVaryings( feedbackVaryings );
+	updateVaryings.push_back( "tf_flags" );
 	
 	gl::GlslProg::Format updateFormat;
 	updateFormat.vertex( loadAsset( "update.vert" ) )
@@ -342,12 +604,15 @@ void SpiderWebApp::setupGlsl()
 				// to capture attributes, we're using GL_SEPERATE_ATTRIBS
 				.feedbackFormat( GL_SEPARATE_ATTRIBS )
 				// We also send the names of the attributes to capture
-				.feedbackVaryings( feedbackVaryings );
+				.feedbackVaryings( updateVaryings );
 	
 	mUpdateGlsl = gl::GlslProg::create( updateFormat );
-	// Set this, otherwise it will be set to vec3( 0, 0, 0 ),
-	// which is in the center of the cloth
-	mUpdateGlsl->uniform( "rayPosition", vec3( 0 ) );
+	// The probe buffers use their own texture units so they don't
+	// collide with the position buffer on unit 0
+	mUpdateGlsl->uniform( "uProbes", 1 );
+	mUpdateGlsl->uniform( "uProbeCells", 2 );
+	mUpdateGlsl->uniform( "uProbeIndices", 3 );
+	mUpdateGlsl->uniform( "uProbeCount", 0 );
 	mUpdateGlsl->uniform( "gravity", vec3(0, 0.08f, 0) );
 //	mUpdateGlsl->uniform( "rest_length", 20.0 );
 	mUpdateGlsl->uniform( "c", mOptions->getDamping() );
@@ -360,6 +625,39 @@ void SpiderWebApp::setupGlsl()
 				.fragment( loadAsset( "render.frag" ) );
 	
 	mRenderGlsl = gl::GlslProg::create( renderFormat );
+	
+	// Writes the index pairs of the strands that are long enough on screen
+	// to a buffer through transform feedback
+	gl::GlslProg::Format lodFormat;
+	lodFormat.vertex( loadAsset( "lod.vert" ) )
+			 .geometry( loadAsset( "lod.geom" ) )
+			 .feedbackFormat( GL_INTERLEAVED_ATTRIBS )
+			 .feedbackVaryings( { "tf_strand" } );
+	
+	mLodGlsl = gl::GlslProg::create( lodFormat );
+	
+	// Rebuilds the full web from the simulated skeleton in coarse mode
+	gl::GlslProg::Format reconstructFormat;
+	reconstructFormat.vertex( loadAsset( "reconstruct.vert" ) )
+					 .feedbackFormat( GL_SEPARATE_ATTRIBS )
+					 .feedbackVaryings( feedbackVaryings );
+	
+	mReconstructGlsl = gl::GlslProg::create( reconstructFormat );
+	mReconstructGlsl->uniform( "uSkeletonPositions", 0 );
+	mReconstructGlsl->uniform( "uSkeletonVelocities", 1 );
+	glGenQueries( 1, &mLodQuery );
+	glGenQueries( 1, &mStrandTimeQuery );
+	
+	// Expands each line into a quad with analytic edge coverage, so the
+	// app doesn't need MSAA to get smooth strands
+	gl::GlslProg::Format strandFormat;
+	strandFormat.vertex( loadAsset( "strand.vert" ) )
+				.geometry( loadAsset( "strand.geom" ) )
+				.fragment( loadAsset( "strand.frag" ) );
+	
+	mStrandGlsl = gl::GlslProg::create( strandFormat );
+	mStrandGlsl->uniform( "uStrandWidth", mStrandWidth );
+	mStrandGlsl->uniform( "uFeather", 1.0f );
 }
 
 
@@ -387,20 +685,141 @@ void SpiderWebApp::keyDown( KeyEvent event )
 	}
 }
 
+void SpiderWebApp::touchesBegan( TouchEvent event )
+{
+	for( const auto &touch : event.getTouches() ) {
+		mProbeMap[touch.getId()] = ForceProbe( touch.getPos(), mProbeRadius, mProbeStrength );
+	}
+	updateProbes();
+}
+
+void SpiderWebApp::touchesMoved( TouchEvent event )
+{
+	for( const auto &touch : event.getTouches() ) {
+		mProbeMap[touch.getId()] = ForceProbe( touch.getPos(), mProbeRadius, mProbeStrength );
+	}
+	updateProbes();
+}
+
+void SpiderWebApp::touchesEnded( TouchEvent event )
+{
+	for( const auto &touch : event.getTouches() ) {
+		mProbeMap.erase( touch.getId() );
+	}
+	updateProbes();
+}
+
 void SpiderWebApp::updateRayPosition( const ci::ivec2 &mousePos, bool useDistance )
 {
-//	auto ray = mCam.generateRay( mousePos, getWindowSize() );
-//	auto dist = ci::distance( mCam.getEyePoint(), vec3() );
-//	auto rayPosition = ray.calcPosition( useDistance ? dist : 0 );
-//	vec3 rayPosition = vec3( mousePos.x, mousePos.y, 0.0 ) - vec3( getWindowCenter().x, getWindowCenter().y, 0.0 );
-//	rayPosition /= vec3( getWindowWidth(), getWindowHeight(), 1.0 );
-//	rayPosition *= vec3( 25.0, 25.0, 1.0 );
-//	vec3 rayPosition = vec3( vec2(mousePos) / vec2(getWindowSize()), 0.0 );
-	vec3 rayPosition = vec3();
+	// the mouse is just another probe
 	if( useDistance )
-		rayPosition = vec3( vec2(mousePos), 0.0 );
-	mUpdateGlsl->uniform( "rayPosition", rayPosition );
-//	CI_LOG_V( rayPosition );
+		mProbeMap[MOUSE_PROBE_ID] = ForceProbe( vec2( mousePos ), mProbeRadius, mProbeStrength );
+	else
+		mProbeMap.erase( MOUSE_PROBE_ID );
+	
+	updateProbes();
+}
+
+void SpiderWebApp::setupProbeBuffers()
+{
+	mProbeGrid.setBounds( vec2( getWindowSize() ), PROBE_CELL_SIZE );
+	
+	// the probe and cell buffers have a fixed size, the index list is resized as probes are binned
+	auto cellCount = mProbeGrid.getGridSize().x * mProbeGrid.getGridSize().y;
+	mProbeVbo = gl::Vbo::create( GL_TEXTURE_BUFFER, MAX_PROBES * sizeof(vec4), nullptr, GL_DYNAMIC_DRAW );
+	mProbeCellVbo = gl::Vbo::create( GL_TEXTURE_BUFFER, cellCount * sizeof(ivec2), mProbeGrid.getCellRanges().data(), GL_DYNAMIC_DRAW );
+	mProbeIndexVbo = gl::Vbo::create( GL_TEXTURE_BUFFER, MAX_PROBES * sizeof(int32_t), nullptr, GL_DYNAMIC_DRAW );
+	
+	mProbeTex = gl::BufferTexture::create( mProbeVbo, GL_RGBA32F );
+	mProbeCellTex = gl::BufferTexture::create( mProbeCellVbo, GL_RG32I );
+	mProbeIndexTex = gl::BufferTexture::create( mProbeIndexVbo, GL_R32I );
+	
+	mUpdateGlsl->uniform( "uProbeGridSize", mProbeGrid.getGridSize() );
+	mUpdateGlsl->uniform( "uProbeCellSize", mProbeGrid.getCellSize() );
+}
+
+void SpiderWebApp::updateProbes()
+{
+	vector<ForceProbe> probes;
+	for( const auto &entry : mProbeMap ) {
+		if( probes.size() == MAX_PROBES )
+			break;
+		probes.push_back( entry.second );
+	}
+	mProbeGrid.bin( probes );
+	
+	// UPLOAD probes as vec4( position, radius, strength )
+	vector<vec4> probeData;
+	for( const auto &probe : probes ) {
+		probeData.push_back( vec4( probe.position, probe.radius, probe.strength ) );
+	}
+	if( ! probeData.empty() )
+		mProbeVbo->bufferSubData( 0, probeData.size() * sizeof(vec4), probeData.data() );
+	
+	const auto &ranges = mProbeGrid.getCellRanges();
+	mProbeCellVbo->bufferSubData( 0, ranges.size() * sizeof(ivec2), ranges.data() );
+	
+	const auto &indices = mProbeGrid.getCellIndices();
+	if( indices.size() * sizeof(int32_t) > mProbeIndexVbo->getSize() )
+		mProbeIndexVbo->bufferData( indices.size() * sizeof(int32_t), indices.data(), GL_DYNAMIC_DRAW );
+	else if( ! indices.empty() )
+		mProbeIndexVbo->bufferSubData( 0, indices.size() * sizeof(int32_t), indices.data() );
+	
+	mUpdateGlsl->uniform( "uProbeCount", int( probes.size() ) );
+}
+
+void SpiderWebApp::checkProbes()
+{
+	// a probe in the middle of the window if none is held down, so there's something to compare
+	bool addedProbe = mProbeMap.empty();
+	if( addedProbe )
+		mProbeMap[MOUSE_PROBE_ID] = ForceProbe( getWindowCenter(), mProbeRadius * 4.0f, mProbeStrength );
+	updateProbes();
+	
+	// RUN the update pass once with a zero timestep, which leaves the probes as the only thing moving the
+	// points. It writes the buffers the next iteration overwrites anyway
+	size_t count = mSimulatedCount;
+	int source = mIterationIndex & 1, target = 1 - source;
+	{
+		gl::ScopedGlslProg	scopeGlsl( mUpdateGlsl );
+		gl::ScopedState		scopeState( GL_RASTERIZER_DISCARD, true );
+		gl::ScopedTextureBind scopeProbes( mProbeTex->getTarget(), mProbeTex->getId(), 1 );
+		gl::ScopedTextureBind scopeProbeCells( mProbeCellTex->getTarget(), mProbeCellTex->getId(), 2 );
+		gl::ScopedTextureBind scopeProbeIndices( mProbeIndexTex->getTarget(), mProbeIndexTex->getId(), 3 );
+		gl::ScopedVao		scopeVao( mVaos[source] );
+		mUpdateGlsl->uniform( "t", 0.0f );
+		mFeedbackObj[target]->bind();
+		gl::beginTransformFeedback( GL_POINTS );
+		gl::drawArrays( GL_POINTS, 0, count );
+		gl::endTransformFeedback();
+		mFeedbackObj[target]->unbind();
+		mUpdateGlsl->uniform( "t", mOptions->getTimestep() );
+	}
+	
+	vector<vec4> before = readBack<vec4>( mPositions[source], count );
+	vector<vec4> after = readBack<vec4>( mPositions[target], count );
+	vector<ivec4> connections = readBack<ivec4>( mConnections[source], count );
+	
+	if( before.size() == count && after.size() == count && connections.size() == count ) {
+		// APPLY the same probes on the CPU, leaving the points update.vert leaves alone
+		float maxError = 0.0f;
+		size_t moved = 0;
+		for( size_t i = 0; i < count; ++i ) {
+			vec3 pos = vec3( before[i] );
+			vec3 expected = ( connections[i].x == -1 || connections[i].y == -1 ) ? pos : mProbeGrid.apply( pos );
+			if( expected != pos )
+				moved++;
+			maxError = std::max( maxError, distance( expected, vec3( after[i] ) ) );
+		}
+		CI_LOG_I( "probe pass vs ProbeGrid::apply over " << count << " points, " << moved << " moved by the probes, max error " << maxError << "px" );
+	}
+	else
+		CI_LOG_E( "couldn't read the probe pass back" );
+	
+	if( addedProbe ) {
+		mProbeMap.erase( MOUSE_PROBE_ID );
+		updateProbes();
+	}
 }
 
 void SpiderWebApp::update()
@@ -408,6 +827,9 @@ void SpiderWebApp::update()
 
 	gl::ScopedGlslProg	scopeGlsl( mUpdateGlsl );
 	gl::ScopedState		scopeState( GL_RASTERIZER_DISCARD, true );
+	gl::ScopedTextureBind scopeProbes( mProbeTex->getTarget(), mProbeTex->getId(), 1 );
+	gl::ScopedTextureBind scopeProbeCells( mProbeCellTex->getTarget(), mProbeCellTex->getId(), 2 );
+	gl::ScopedTextureBind scopeProbeIndices( mProbeIndexTex->getTarget(), mProbeIndexTex->getId(), 3 );
 	
 //	mIterationIndex = 1 - mIterationIndex;
 	for( auto i = mIterationsPerFrame; i != 0; --i ) {
@@ -437,10 +859,12 @@ void SpiderWebApp::update()
 		// exists by itself
 	
 		mFeedbackObj[mIterationIndex & 1]->bind();
+		// the first iteration of a frame starts the flags over, the rest add to them
+		mUpdateGlsl->uniform( "uAccumulateFlags", ( i == mIterationsPerFrame ) ? 0 : 1 );
 		gl::beginTransformFeedback( GL_POINTS );
 		// Now we issue our draw command which puts all of the
 		// setup in motion and processes all the vertices
-		gl::drawArrays( GL_POINTS, 0, MAX_POINTS );
+		gl::drawArrays( GL_POINTS, 0, mSimulatedCount );
 		// After that we issue an endTransformFeedback command
 		// to tell OpenGL that we're finished capturing vertices
 		gl::endTransformFeedback();
@@ -449,6 +873,216 @@ void SpiderWebApp::update()
 	
 		
 	}
+	
+	if( mStatsEnabled )
+		sampleSolver();
+	
+	if( mCoarseMode )
+		reconstructWeb();
+	
+	if( mLodEnabled )
+		updateLod();
+}
+
+void SpiderWebApp::setupReconstructBuffers( const vec4 *colors )
+{
+	auto &links = mSkeleton.getLinks();
+	
+	// one link per web point, telling it which skeleton points to follow
+	mSkeletonLinks = gl::Vbo::create( GL_ARRAY_BUFFER, links.size() * sizeof(WebSkeleton::Link), links.data(), GL_STATIC_DRAW );
+	mReconstructVao = gl::Vao::create();
+	{
+		gl::ScopedVao scopeVao( mReconstructVao );
+		gl::ScopedBuffer scopeBuffer( mSkeletonLinks );
+		gl::vertexAttribIPointer( SKELETON_PAIR_INDEX, 2, GL_INT, sizeof(WebSkeleton::Link), (const GLvoid*)offsetof(WebSkeleton::Link, a) );
+		gl::enableVertexAttribArray( SKELETON_PAIR_INDEX );
+		gl::vertexAttribPointer( SKELETON_ALONG_INDEX, 1, GL_FLOAT, GL_FALSE, sizeof(WebSkeleton::Link), (const GLvoid*)offsetof(WebSkeleton::Link, t) );
+		gl::enableVertexAttribArray( SKELETON_ALONG_INDEX );
+	}
+	
+	// full resolution buffers that the render and lod passes read from
+	mRenderPositions = gl::Vbo::create( GL_ARRAY_BUFFER, links.size() * sizeof(vec4), nullptr, GL_STREAM_COPY );
+	mRenderVelocities = gl::Vbo::create( GL_ARRAY_BUFFER, links.size() * sizeof(vec3), nullptr, GL_STREAM_COPY );
+	mRenderColors = gl::Vbo::create( GL_ARRAY_BUFFER, links.size() * sizeof(vec4), colors, GL_STATIC_DRAW );
+	mRenderVao = gl::Vao::create();
+	{
+		gl::ScopedVao scopeVao( mRenderVao );
+		{
+			gl::ScopedBuffer scopeBuffer( mRenderPositions );
+			gl::vertexAttribPointer( POSITION_INDEX, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid*) 0 );
+			gl::enableVertexAttribArray( POSITION_INDEX );
+		}
+		{
+			gl::ScopedBuffer scopeBuffer( mRenderVelocities );
+			gl::vertexAttribPointer( VELOCITY_INDEX, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*) 0 );
+			gl::enableVertexAttribArray( VELOCITY_INDEX );
+		}
+		{
+			gl::ScopedBuffer scopeBuffer( mRenderColors );
+			gl::vertexAttribPointer( COLOR_INDEX, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid*) 0 );
+			gl::enableVertexAttribArray( COLOR_INDEX );
+		}
+	}
+}
+
+void SpiderWebApp::checkReconstruct()
+{
+	if( ! mCoarseMode ) {
+		CI_LOG_W( "the reconstruct pass only runs with Coarse Sim on" );
+		return;
+	}
+	
+	// RUN the pass again from the current skeleton, it writes the same render buffers every frame
+	reconstructWeb();
+	vector<vec4> skeleton = readBack<vec4>( mPositions[mIterationIndex & 1], mSimulatedCount );
+	vector<vec4> gpuPositions = readBack<vec4>( mRenderPositions, mPointCount );
+	if( skeleton.size() != size_t( mSimulatedCount ) || gpuPositions.size() != mSkeleton.getPointCount() ) {
+		CI_LOG_E( "couldn't read the reconstruct pass back" );
+		return;
+	}
+	
+	// REBUILD the same points on the CPU
+	vector<vec4> cpuPositions( mSkeleton.getPointCount() );
+	mSkeleton.reconstruct( skeleton.data(), cpuPositions.data() );
+	float maxError = 0.0f;
+	for( size_t i = 0; i < cpuPositions.size(); ++i )
+		maxError = std::max( maxError, distance( vec3( cpuPositions[i] ), vec3( gpuPositions[i] ) ) );
+	
+	CI_LOG_I( "reconstruct pass vs WebSkeleton::reconstruct over " << cpuPositions.size() << " points from "
+			  << skeleton.size() << " skeleton points, max error " << maxError << "px" );
+}
+
+void SpiderWebApp::reconstructWeb()
+{
+	// the physics feedback object is still bound, don't let it pick up the render buffers
+	mFeedbackObj[mIterationIndex & 1]->unbind();
+	
+	gl::ScopedGlslProg	scopeGlsl( mReconstructGlsl );
+	gl::ScopedState		scopeState( GL_RASTERIZER_DISCARD, true );
+	gl::ScopedVao		scopeVao( mReconstructVao );
+	gl::ScopedTextureBind scopePositions( mPositionBufTexs[mIterationIndex & 1]->getTarget(), mPositionBufTexs[mIterationIndex & 1]->getId(), 0 );
+	gl::ScopedTextureBind scopeVelocities( mVelocityBufTexs[mIterationIndex & 1]->getTarget(), mVelocityBufTexs[mIterationIndex & 1]->getId(), 1 );
+	
+	gl::bindBufferBase( GL_TRANSFORM_FEEDBACK_BUFFER, POSITION_INDEX, mRenderPositions );
+	gl::bindBufferBase( GL_TRANSFORM_FEEDBACK_BUFFER, VELOCITY_INDEX, mRenderVelocities );
+	gl::beginTransformFeedback( GL_POINTS );
+	gl::drawArrays( GL_POINTS, 0, mPointCount );
+	gl::endTransformFeedback();
+}
+
+void SpiderWebApp::sampleSolver()
+{
+	// MEASURE a copy requested a frame or more ago, once the GPU is done with it
+	mSolverReadback.poll( [this]( const SolverReadback::Frame &frame ) {
+		mSolverSample = SolverStats::measure( frame.positionMass, frame.velocities, frame.flags, frame.count );
+		mSolverSample.frame = frame.frame;
+		mSolverSample.time = frame.time;
+		mSolverStats.record( mSolverSample );
+	});
+	
+	// COPY the buffers the last iteration wrote to. The flags hold every iteration of this frame
+	if( getElapsedFrames() % mStatsInterval == 0 ) {
+		int index = mIterationIndex & 1;
+		if( ! mSolverReadback.request( mPositions[index], mVelocities[index], mSolverFlags[index], mSimulatedCount, getElapsedFrames(), getElapsedSeconds() ) )
+			CI_LOG_V( "solver readbacks are still in flight, skipping the sample of frame " << getElapsedFrames() );
+	}
+}
+
+void SpiderWebApp::exportStats()
+{
+	fs::path path = getDocumentsDirectory() / "SpiderWebSolverStats.csv";
+	if( mSolverStats.writeCsv( path ) )
+		CI_LOG_I( "wrote " << mSolverStats.getHistory().size() << " solver samples to " << path );
+	else
+		CI_LOG_E( "couldn't write solver stats to " << path );
+}
+
+gl::VaoRef SpiderWebApp::getRenderVao()
+{
+	// in coarse mode the simulated buffers only hold the skeleton
+	return mCoarseMode ? mRenderVao : mVaos[mIterationIndex & 1];
+}
+
+void SpiderWebApp::updateLod()
+{
+	// PICK UP the survivor count of the last pass once the GPU has it, instead of stalling on it. Until then
+	// draw() keeps using the older buffer and its own count, and no new pass is issued.
+	if( mLodPending ) {
+		GLuint available = 0;
+		glGetQueryObjectuiv( mLodQuery, GL_QUERY_RESULT_AVAILABLE, &available );
+		if( ! available )
+			return;
+		
+		GLuint written = 0;
+		glGetQueryObjectuiv( mLodQuery, GL_QUERY_RESULT, &written );
+		mLodDrawIndex = 1 - mLodDrawIndex;
+		mStrandsDrawn = written;
+		mLodPending = false;
+	}
+	
+	// WRITE the buffer draw() isn't reading
+	runLodPass( mLodIndices[1 - mLodDrawIndex], mLodQuery );
+	mLodPending = true;
+}
+
+void SpiderWebApp::runLodPass( const gl::VboRef &indices, GLuint query )
+{
+	// the physics feedback object is still bound, don't let it pick up the lod buffer
+	mFeedbackObj[mIterationIndex & 1]->unbind();
+	
+	gl::ScopedGlslProg	scopeGlsl( mLodGlsl );
+	gl::ScopedState		scopeState( GL_RASTERIZER_DISCARD, true );
+	gl::ScopedVao		scopeVao( getRenderVao() );
+	gl::ScopedBuffer	scopeIndices( GL_ELEMENT_ARRAY_BUFFER, mLineIndices->getId() );
+	gl::setDefaultShaderVars();
+	mLodGlsl->uniform( "uViewportSize", vec2( toPixels( getWindowSize() ) ) );
+	mLodGlsl->uniform( "uMinLength", mLodMinLength );
+	
+	gl::bindBufferBase( GL_TRANSFORM_FEEDBACK_BUFFER, 0, indices );
+	glBeginQuery( GL_PRIMITIVES_WRITTEN, query );
+	gl::beginTransformFeedback( GL_POINTS );
+	gl::drawElements( GL_LINES, mConnectionCount * 2, GL_UNSIGNED_INT, nullptr );
+	gl::endTransformFeedback();
+	glEndQuery( GL_PRIMITIVES_WRITTEN );
+}
+
+void SpiderWebApp::checkLod()
+{
+	// RUN the lod pass into a buffer of its own and wait for it, the double-buffered ones are left alone
+	vector<uint32_t> lineIndices = readBack<uint32_t>( mLineIndices, mConnectionCount * 2 );
+	auto scratch = gl::Vbo::create( GL_TRANSFORM_FEEDBACK_BUFFER, mConnectionCount * 2 * sizeof(uint32_t), nullptr, GL_STREAM_READ );
+	GLuint query = 0;
+	glGenQueries( 1, &query );
+	runLodPass( scratch, query );
+	GLuint written = 0;
+	glGetQueryObjectuiv( query, GL_QUERY_RESULT, &written );
+	glDeleteQueries( 1, &query );
+	vector<uint32_t> gpuIndices = readBack<uint32_t>( scratch, written * 2 );
+	
+	// CULL the same positions on the CPU, with the matrices the pass used
+	gl::VboRef positionBuffer = mCoarseMode ? mRenderPositions : mPositions[mIterationIndex & 1];
+	vector<vec4> positions = readBack<vec4>( positionBuffer, mPointCount );
+	if( lineIndices.size() != size_t( mConnectionCount * 2 ) || gpuIndices.size() != written * 2 || positions.size() != size_t( mPointCount ) ) {
+		CI_LOG_E( "couldn't read the lod pass back" );
+		return;
+	}
+	vector<uint32_t> cpuIndices;
+	StrandLod::Stats stats = StrandLod::cull( positions, lineIndices, gl::getModelViewProjection(), vec2( toPixels( getWindowSize() ) ), mLodMinLength, &cpuIndices );
+	
+	// COMPARE strand by strand. Strands right at the threshold can land either way on rounding
+	set<pair<uint32_t, uint32_t>> gpuStrands, cpuStrands;
+	for( size_t i = 0; i + 1 < gpuIndices.size(); i += 2 )
+		gpuStrands.insert( make_pair( gpuIndices[i], gpuIndices[i + 1] ) );
+	for( size_t i = 0; i + 1 < cpuIndices.size(); i += 2 )
+		cpuStrands.insert( make_pair( cpuIndices[i], cpuIndices[i + 1] ) );
+	size_t onlyGpu = 0, onlyCpu = 0;
+	for( const auto &strand : gpuStrands )
+		onlyGpu += cpuStrands.count( strand ) ? 0 : 1;
+	for( const auto &strand : cpuStrands )
+		onlyCpu += gpuStrands.count( strand ) ? 0 : 1;
+	
+	CI_LOG_I( "lod pass vs StrandLod::cull: GPU kept " << written << " of " << stats.total << " strands, CPU " << stats.drawn
+			  << ", " << onlyGpu << " only on the GPU, " << onlyCpu << " only on the CPU" );
 }
 
 void SpiderWebApp::draw()
@@ -472,29 +1106,240 @@ void SpiderWebApp::draw()
 //		mWeb->draw();
 	}
 	
+	// TIME the strands on the GPU. The result is read a frame or more later, once it's there, so it never stalls
+	if( mStrandTimePending ) {
+		GLuint available = 0;
+		glGetQueryObjectuiv( mStrandTimeQuery, GL_QUERY_RESULT_AVAILABLE, &available );
+		if( available ) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v( mStrandTimeQuery, GL_QUERY_RESULT, &elapsed );
+			mStrandMs = float( elapsed / 1.0e6 );
+			mStrandTimePending = false;
+		}
+	}
+	
+	bool timed = ! mStrandTimePending;
+	if( timed )
+		glBeginQuery( GL_TIME_ELAPSED, mStrandTimeQuery );
+	drawStrands( mDrawStrands, vec2( toPixels( getWindowSize() ) ) );
+	if( timed ) {
+		glEndQuery( GL_TIME_ELAPSED );
+		mStrandTimePending = true;
+	}
+	
+	mParams->draw();
+}
+
+void SpiderWebApp::drawStrands( bool quads, const vec2 &viewportSize )
+{
 	// Notice that this vao holds the buffers we've just
 	// written to with Transform Feedback. It will show
 	// the most recent positions
-	gl::ScopedVao scopeVao( mVaos[mIterationIndex & 1] );
-	gl::ScopedGlslProg scopeGlsl( mRenderGlsl );
+	gl::ScopedVao scopeVao( getRenderVao() );
+	gl::ScopedGlslProg scopeGlsl( quads ? mStrandGlsl : mRenderGlsl );
 //	gl::setMatrices( mCam );
 	gl::setDefaultShaderVars();
+	if( quads )
+		mStrandGlsl->uniform( "uViewportSize", viewportSize );
 	
 	gl::ScopedColor color( Color::white() );
 	
+	// draw lines
+	gl::ScopedBuffer scopeBuffer( GL_ELEMENT_ARRAY_BUFFER, mLodEnabled ? mLodIndices[mLodDrawIndex]->getId() : mLineIndices->getId() );
+	gl::drawElements( GL_LINES, ( mLodEnabled ? mStrandsDrawn : mConnectionCount ) * 2, GL_UNSIGNED_INT, nullptr );
+}
+
+void SpiderWebApp::benchmarkStrands()
+{
+	// DRAW the current web offscreen a number of times with each path, timing the GPU and
+	// counting the samples that pass, to get fill rate rather than frame time. Lines are drawn
+	// with the 16x MSAA they need to look anti-aliased, the quads without any
+	const int draws = 50;
+	ivec2 size = toPixels( getWindowSize() );
+	gl::FboRef fbos[2] = {
+		gl::Fbo::create( size.x, size.y, gl::Fbo::Format().samples( 16 ) ),
+		gl::Fbo::create( size.x, size.y )
+	};
+	gl::ScopedViewport scopeViewport( ivec2( 0 ), size );
+	gl::ScopedMatrices scopeMatrices;
+	gl::setMatricesWindow( getWindowSize() );
+	gl::ScopedBlendAlpha scopeBlend;
 	
-	// draw points
-//	gl::pointSize( 3.0f);
-//	gl::drawArrays( GL_POINTS, 0, MAX_POINTS );
+	GLuint queries[2];
+	glGenQueries( 2, queries );
+	for( int quads = 0; quads < 2; ++quads ) {
+		gl::ScopedFramebuffer scopeFbo( fbos[quads] );
+		gl::clear( Color::black() );
+		glBeginQuery( GL_TIME_ELAPSED, queries[0] );
+		glBeginQuery( GL_SAMPLES_PASSED, queries[1] );
+		for( int i = 0; i < draws; ++i )
+			drawStrands( quads != 0, vec2( size ) );
+		glEndQuery( GL_SAMPLES_PASSED );
+		glEndQuery( GL_TIME_ELAPSED );
+		
+		// waits for the GPU, fine for a one off
+		GLuint64 elapsed = 0, samples = 0;
+		glGetQueryObjectui64v( queries[0], GL_QUERY_RESULT, &elapsed );
+		glGetQueryObjectui64v( queries[1], GL_QUERY_RESULT, &samples );
+		
+		float ms = float( elapsed / 1.0e6 / draws );
+		( quads ? mQuadsMs : mLinesMs ) = ms;
+		CI_LOG_I( ( quads ? "quads: " : "lines: " ) << ms << "ms per draw of " << ( mLodEnabled ? mStrandsDrawn : mConnectionCount )
+				  << " strands at " << std::max( fbos[quads]->getFormat().getSamples(), 1 ) << "x, " << ( samples / draws ) << " samples, "
+				  << ( elapsed > 0 ? samples * 1000.0 / elapsed : 0.0 ) << " Msamples/s" );
+	}
+	glDeleteQueries( 2, queries );
+}
+
+void SpiderWebApp::checkStrands()
+{
+	// a fixed fan of spokes crossed by rings, drawn once as GL_LINES with 16x MSAA for the reference and
+	// once as quads without MSAA. Strands are at full alpha, which strand.geom draws a pixel wide like the lines
+	struct StrandVertex {
+		vec3 position;
+		vec3 velocity;
+		vec4 color;
+	};
+	const int size = 512, spokes = 48, rings = 3;
+	const vec2 center( size / 2.0f );
+	const vec4 color( 1.0f );
+	const vec3 velocity( 1.0f, 0.5f, 0.25f );
+	vector<StrandVertex> vertices;
+	for( int i = 0; i < spokes; ++i ) {
+		float angle = i * 2.0f * M_PI / spokes;
+		vec2 dir( cos( angle ), sin( angle ) );
+		vec2 nextDir( cos( angle + 2.0f * M_PI / spokes ), sin( angle + 2.0f * M_PI / spokes ) );
+		
+		vec2 a = center + dir * 16.0f, b = center + dir * 240.0f;
+		vertices.push_back( { vec3( a.x, a.y, 0.0f ), velocity, color } );
+		vertices.push_back( { vec3( b.x, b.y, 0.0f ), velocity, color } );
+		for( int r = 1; r <= rings; ++r ) {
+			float radius = r * 60.0f;
+			vec2 c = center + dir * radius, d = center + nextDir * radius;
+			vertices.push_back( { vec3( c.x, c.y, 0.0f ), velocity, color } );
+			vertices.push_back( { vec3( d.x, d.y, 0.0f ), velocity, color } );
+		}
+	}
 	
-	// draw lines
-	gl::ScopedBuffer scopeBuffer( mLineIndices );
-	gl::drawElements( GL_LINES, mConnectionCount * 2, GL_UNSIGNED_INT, nullptr );
+	auto vbo = gl::Vbo::create( GL_ARRAY_BUFFER, vertices, GL_STATIC_DRAW );
+	auto vao = gl::Vao::create();
+	{
+		gl::ScopedVao scopeVao( vao );
+		gl::ScopedBuffer scopeBuffer( vbo );
+		gl::vertexAttribPointer( POSITION_INDEX, 3, GL_FLOAT, GL_FALSE, sizeof( StrandVertex ), (const GLvoid*) offsetof( StrandVertex, position ) );
+		gl::enableVertexAttribArray( POSITION_INDEX );
+		gl::vertexAttribPointer( VELOCITY_INDEX, 3, GL_FLOAT, GL_FALSE, sizeof( StrandVertex ), (const GLvoid*) offsetof( StrandVertex, velocity ) );
+		gl::enableVertexAttribArray( VELOCITY_INDEX );
+		gl::vertexAttribPointer( COLOR_INDEX, 4, GL_FLOAT, GL_FALSE, sizeof( StrandVertex ), (const GLvoid*) offsetof( StrandVertex, color ) );
+		gl::enableVertexAttribArray( COLOR_INDEX );
+	}
 	
-	mParams->draw();
+	// DRAW both paths, readPixels8u() resolves the multisampled one
+	auto drawFixture = [&]( const gl::FboRef &fbo, bool quads ) -> Surface8u {
+		gl::ScopedFramebuffer scopeFbo( fbo );
+		gl::ScopedViewport scopeViewport( ivec2( 0 ), fbo->getSize() );
+		gl::ScopedMatrices scopeMatrices;
+		gl::setMatricesWindow( fbo->getSize() );
+		gl::ScopedBlendAlpha scopeBlend;
+		gl::clear( Color::black() );
+		
+		gl::ScopedVao scopeVao( vao );
+		gl::ScopedGlslProg scopeGlsl( quads ? mStrandGlsl : mRenderGlsl );
+		gl::setDefaultShaderVars();
+		if( quads ) {
+			mStrandGlsl->uniform( "uViewportSize", vec2( fbo->getSize() ) );
+			mStrandGlsl->uniform( "uStrandWidth", 1.0f );
+		}
+		gl::drawArrays( GL_LINES, 0, GLsizei( vertices.size() ) );
+		if( quads )
+			mStrandGlsl->uniform( "uStrandWidth", mStrandWidth );
+		return fbo->readPixels8u( fbo->getBounds() );
+	};
+	Surface8u reference = drawFixture( gl::Fbo::create( size, size, gl::Fbo::Format().samples( 16 ) ), false );
+	Surface8u image = drawFixture( gl::Fbo::create( size, size ), true );
+	writeImage( getDocumentsDirectory() / "SpiderWebStrandsLines.png", reference );
+	writeImage( getDocumentsDirectory() / "SpiderWebStrandsQuads.png", image );
+	
+	// COMPARE the brightness of each pixel. The feathered edge and the MSAA box filter spread a strand's
+	// coverage differently, so single pixels can be well apart while the strands carry the same weight
+	int maxDiff = 0;
+	uint64_t totalDiff = 0, referenceSum = 0, imageSum = 0;
+	for( int y = 0; y < size; ++y ) {
+		for( int x = 0; x < size; ++x ) {
+			int a = image.getPixel( ivec2( x, y ) ).r;
+			int b = reference.getPixel( ivec2( x, y ) ).r;
+			maxDiff = std::max( maxDiff, abs( a - b ) );
+			totalDiff += abs( a - b );
+			imageSum += a;
+			referenceSum += b;
+		}
+	}
+	mStrandMaxDiff = maxDiff;
+	
+	float meanDiff = float( totalDiff ) / float( size * size );
+	float weight = referenceSum > 0 ? float( imageSum ) / float( referenceSum ) : 1.0f;
+	// under a couple of levels per pixel on average, and within 10% of the lines' total brightness
+	bool match = meanDiff < 2.0f && std::abs( weight - 1.0f ) < 0.1f;
+	if( match )
+		CI_LOG_I( "quads match the 16x MSAA lines, mean difference " << meanDiff << ", max " << maxDiff << ", brightness " << weight << "x" );
+	else
+		CI_LOG_W( "quads differ from the 16x MSAA lines, mean difference " << meanDiff << ", max " << maxDiff << ", brightness " << weight << "x. See "
+				  << getDocumentsDirectory() / "SpiderWebStrandsQuads.png" );
 }
 
-CINDER_APP( SpiderWebApp, RendererGl( RendererGl::Options().msaa( 16 ) ),
+//! Sweeps the solver parameters over webs laid out in \a bounds and writes the results to \a path.
+//! The grid and seeds default to ParameterSweep's, \a args can replace them with `--sweep-options file`
+//! or `--<option> values` for any option ParameterSweep::Options::parse() reads.
+static void runSweep( const Rectf &bounds, const fs::path &path, const vector<string> &args )
+{
+	ParameterSweep::Options options = ParameterSweep::Options()
+		.bounds( bounds )
+		.radiusBase( bounds.getWidth() / 2.0 );
+	for( auto arg = args.begin(); arg != args.end(); ++arg ) {
+		if( arg->compare( 0, 2, "--" ) != 0 )
+			continue;
+		if( arg + 1 == args.end() ) {
+			CI_LOG_E( *arg << " needs a value, not sweeping" );
+			return;
+		}
+		
+		const string &name = *arg, &value = *( ++arg );
+		bool read = ( name == "--sweep-options" ) ? options.load( value ) : options.parse( name.substr( 2 ), value );
+		if( ! read ) {
+			CI_LOG_E( "can't read sweep option " << name << " " << value << ", not sweeping" );
+			return;
+		}
+	}
+	ParameterSweep sweep( options );
+	
+	Timer timer( true );
+	auto results = sweep.run();
+	CI_LOG_I( "simulated " << results.size() << " combinations in " << timer.getSeconds() << "s" );
+	
+	if( ParameterSweep::writeCsv( results, path ) )
+		CI_LOG_I( "wrote sweep results to " << path );
+	else
+		CI_LOG_E( "couldn't write sweep results to " << path );
+}
+
+// strands are anti-aliased in strand.frag, so the default framebuffer doesn't need MSAA
+CINDER_APP( SpiderWebApp, RendererGl( RendererGl::Options().msaa( 0 ) ),
 [&]( App::Settings *settings ) {
 	settings->setWindowSize( 1024, 768 );
+	settings->setMultiTouchEnabled( true );
+	
+	// HEADLESS parameter sweep, e.g. `SpiderWeb --sweep ~/sweep.csv --dampings 2,4 --seeds 1,2,3,4`, or with
+	// `--sweep-options grid.txt`. Runs before the app, its window or a GL context exist, over webs the size of
+	// the default window, then quits without creating them.
+	const auto &args = settings->getCommandLineArgs();
+	auto sweepArg = find( args.begin(), args.end(), "--sweep" );
+	if( sweepArg != args.end() ) {
+		auto pathArg = sweepArg + 1;
+		bool hasPath = pathArg != args.end() && pathArg->compare( 0, 2, "--" ) != 0;
+		vector<string> optionArgs( args.begin(), sweepArg );
+		optionArgs.insert( optionArgs.end(), hasPath ? pathArg + 1 : pathArg, args.end() );
+		runSweep( Rectf( vec2( 0 ), vec2( settings->getWindowSize() ) ),
+				  hasPath ? fs::path( *pathArg ) : getDocumentsDirectory() / "SpiderWebSweep.csv", optionArgs );
+		settings->setShouldQuit();
+	}
 })
\ No newline at end of file
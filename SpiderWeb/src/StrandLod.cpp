@@ -0,0 +1,45 @@
+//
+//  StrandLod.cpp
+//  SpiderWeb
+//
+
+#include "StrandLod.h"
+
+using namespace ci;
+using namespace std;
+
+ci::vec2 StrandLod::project( const ci::vec3 &pos, const ci::mat4 &mvp, const ci::vec2 &viewportSize )
+{
+	vec4 clip = mvp * vec4( pos, 1.0f );
+	return viewportSize * 0.5f * vec2( clip ) / clip.w;
+}
+
+float StrandLod::getProjectedLength( const ci::vec3 &a, const ci::vec3 &b, const ci::mat4 &mvp, const ci::vec2 &viewportSize )
+{
+	return distance( project( a, mvp, viewportSize ), project( b, mvp, viewportSize ) );
+}
+
+StrandLod::Stats StrandLod::cull( const std::vector<ci::vec4> &positions, const std::vector<uint32_t> &indices,
+								  const ci::mat4 &mvp, const ci::vec2 &viewportSize, float minPixels,
+								  std::vector<uint32_t> *outIndices )
+{
+	Stats stats;
+	stats.total = indices.size() / 2;
+	
+	outIndices->clear();
+	outIndices->reserve( indices.size() );
+	for( size_t i = 0; i + 1 < indices.size(); i += 2 ) {
+		uint32_t a = indices[i];
+		uint32_t b = indices[i + 1];
+		if( a >= positions.size() || b >= positions.size() )
+			continue;
+		
+		if( getProjectedLength( vec3( positions[a] ), vec3( positions[b] ), mvp, viewportSize ) >= minPixels ) {
+			outIndices->push_back( a );
+			outIndices->push_back( b );
+		}
+	}
+	
+	stats.drawn = outIndices->size() / 2;
+	return stats;
+}
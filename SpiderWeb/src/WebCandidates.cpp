@@ -0,0 +1,192 @@
+//
+//  WebCandidates.cpp
+//  SpiderWeb
+//
+
+#include "WebCandidates.h"
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+// points this close to the bounds are the edge anchors, they don't count towards the web's area
+const float EDGE_MARGIN = 11.0f;
+
+// shared between pick() and its workers, which can outlive pick() when they miss the budget
+struct PickState {
+	mutex					guard;
+	condition_variable		finished;
+	vector<SpiderWebRef>	webs;
+	vector<WebScore>		scores;
+	vector<bool>			done;
+	int						doneCount = 0;
+};
+
+} // anonymous namespace
+
+WebGraph WebGraph::create( const SpiderWebRef &web )
+{
+	WebGraph graph;
+	auto points = web->getPoints();
+	graph.positions.resize( points.size() );
+	for( auto iter = points.begin(); iter != points.end(); ++iter )
+		graph.positions[(*iter)->getId()] = (*iter)->getPosition();
+	
+	auto strands = web->getUniqueStrands();
+	graph.strands.reserve( strands.size() );
+	for( auto iter = strands.begin(); iter != strands.end(); ++iter )
+		graph.strands.push_back( make_pair( int32_t( iter->first->getId() ), int32_t( iter->second->getId() ) ) );
+	
+	return graph;
+}
+
+SpiderWebRef WebCandidates::pick( const vector<SpiderWeb::Options> &webOptions )
+{
+	auto state = make_shared<PickState>();
+	size_t count = webOptions.size();
+	state->webs.resize( count );
+	state->scores.resize( count );
+	state->done.assign( count, false );
+	
+	// LAUNCH one worker per candidate. They are detached so a slow one can't hold up the budget
+	WebCandidates scorer( *this );
+	for( size_t i = 0; i < count; ++i ) {
+		SpiderWeb::Options options = webOptions[i];
+		thread( [state, scorer, options, i]() {
+			auto web = SpiderWeb::create( options );
+			web->make();
+			WebScore score = scorer.score( WebGraph::create( web ), options.getBounds() );
+			
+			lock_guard<mutex> lock( state->guard );
+			state->webs[i] = web;
+			state->scores[i] = score;
+			state->done[i] = true;
+			state->doneCount++;
+			state->finished.notify_all();
+		}).detach();
+	}
+	
+	// WAIT for the budget or every candidate, whichever comes first
+	auto deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>( chrono::duration<double>( mOptions.mTimeBudget ) );
+	unique_lock<mutex> lock( state->guard );
+	state->finished.wait_until( lock, deadline, [&] { return state->doneCount == int( count ); } );
+	
+	// NONE made it, make the first one here rather than wait on workers that may be starved for cores
+	if( state->doneCount == 0 ) {
+		lock.unlock();
+		mLastFinished = 0;
+		mLastScore = WebScore();
+		if( count == 0 )
+			return SpiderWebRef();
+		
+		auto web = SpiderWeb::create( webOptions.front() );
+		web->make();
+		mLastScore = score( WebGraph::create( web ), webOptions.front().getBounds() );
+		return web;
+	}
+	
+	SpiderWebRef best;
+	mLastScore = WebScore();
+	mLastFinished = state->doneCount;
+	for( size_t i = 0; i < count; ++i ) {
+		if( state->done[i] && ( ! best || state->scores[i].total > mLastScore.total ) ) {
+			best = state->webs[i];
+			mLastScore = state->scores[i];
+		}
+	}
+	
+	return best;
+}
+
+WebScore WebCandidates::score( const WebGraph &graph, const Rectf &bounds ) const
+{
+	WebScore result;
+	if( graph.positions.empty() || bounds.calcArea() <= 0.0f )
+		return result;
+	
+	// FIND the area the web actually spans, leaving out the anchors on the edges
+	Rectf inner( bounds.x1 + EDGE_MARGIN, bounds.y1 + EDGE_MARGIN, bounds.x2 - EDGE_MARGIN, bounds.y2 - EDGE_MARGIN );
+	Rectf area( vec2( numeric_limits<float>::max() ), vec2( -numeric_limits<float>::max() ) );
+	for( auto iter = graph.positions.begin(); iter != graph.positions.end(); ++iter ) {
+		if( inner.contains( *iter ) )
+			area.include( *iter );
+	}
+	if( area.x2 <= area.x1 || area.y2 <= area.y1 )
+		return result;
+	
+	// RASTERIZE the strands into a coarse grid over the bounds
+	ivec2 size = glm::max( mOptions.mRasterSize, ivec2( 1 ) );
+	vec2 cellSize = bounds.getSize() / vec2( size );
+	vector<uint8_t> raster( size.x * size.y, 0 );
+	float step = std::min( cellSize.x, cellSize.y ) * 0.5f;
+	double strandLength = 0.0;
+	for( auto iter = graph.strands.begin(); iter != graph.strands.end(); ++iter ) {
+		vec2 a = graph.positions[iter->first];
+		vec2 b = graph.positions[iter->second];
+		float len = distance( a, b );
+		strandLength += len;
+		int samples = std::max( 1, int( ceil( len / step ) ) );
+		for( int s = 0; s <= samples; ++s ) {
+			ivec2 cell = ivec2( ( mix( a, b, float( s ) / samples ) - bounds.getUpperLeft() ) / cellSize );
+			if( cell.x >= 0 && cell.y >= 0 && cell.x < size.x && cell.y < size.y )
+				raster[cell.y * size.x + cell.x] = 1;
+		}
+	}
+	
+	// COVERAGE of the cells inside the web's area, tallied per block for uniformity
+	ivec2 minCell = glm::max( ivec2( ( area.getUpperLeft() - bounds.getUpperLeft() ) / cellSize ), ivec2( 0 ) );
+	ivec2 maxCell = glm::min( ivec2( ( area.getLowerRight() - bounds.getUpperLeft() ) / cellSize ), size - ivec2( 1 ) );
+	ivec2 areaCells = maxCell - minCell + ivec2( 1 );
+	ivec2 blocks = glm::max( glm::min( mOptions.mBlockCount, areaCells ), ivec2( 1 ) );
+	vector<int> blockCovered( blocks.x * blocks.y, 0 ), blockTotal( blocks.x * blocks.y, 0 );
+	int covered = 0;
+	for( int y = minCell.y; y <= maxCell.y; ++y ) {
+		for( int x = minCell.x; x <= maxCell.x; ++x ) {
+			int block = ( ( y - minCell.y ) * blocks.y / areaCells.y ) * blocks.x + ( x - minCell.x ) * blocks.x / areaCells.x;
+			int hit = raster[y * size.x + x];
+			covered += hit;
+			blockCovered[block] += hit;
+			blockTotal[block]++;
+		}
+	}
+	result.coverage = float( covered ) / float( areaCells.x * areaCells.y );
+	
+	// UNIFORMITY is one minus the coefficient of variation of the block coverages
+	float mean = 0.0f, variance = 0.0f;
+	for( size_t i = 0; i < blockTotal.size(); ++i )
+		mean += float( blockCovered[i] ) / std::max( blockTotal[i], 1 );
+	mean /= blockTotal.size();
+	for( size_t i = 0; i < blockTotal.size(); ++i ) {
+		float d = float( blockCovered[i] ) / std::max( blockTotal[i], 1 ) - mean;
+		variance += d * d;
+	}
+	variance /= blockTotal.size();
+	result.uniformity = ( mean > 0.0f ) ? glm::clamp( 1.0f - sqrt( variance ) / mean, 0.0f, 1.0f ) : 0.0f;
+	
+	// DENSITY compared to the target, 1 when it matches and 0.5 at half or twice as dense
+	float density = float( strandLength / area.calcArea() );
+	result.density = ( density > 0.0f ) ? std::min( density / mOptions.mTargetDensity, mOptions.mTargetDensity / density ) : 0.0f;
+	
+	// DEGREE, points that are neither dangling nor over the solver's 4 neighbor cap
+	vector<int> degrees( graph.positions.size(), 0 );
+	for( auto iter = graph.strands.begin(); iter != graph.strands.end(); ++iter ) {
+		degrees[iter->first]++;
+		degrees[iter->second]++;
+	}
+	int goodDegree = 0;
+	for( auto iter = degrees.begin(); iter != degrees.end(); ++iter )
+		goodDegree += ( *iter >= 2 && *iter <= 4 ) ? 1 : 0;
+	result.degree = float( goodDegree ) / degrees.size();
+	
+	result.total = result.coverage * mOptions.mCoverageWeight + result.uniformity * mOptions.mUniformityWeight
+				 + result.density * mOptions.mDensityWeight + result.degree * mOptions.mDegreeWeight;
+	
+	return result;
+}
@@ -0,0 +1,43 @@
+//
+//  WebNoise.cpp
+//  SpiderWeb
+//
+
+#include "WebNoise.h"
+#include "WebParallel.h"
+
+using namespace ci;
+using namespace std;
+
+// below this many points per worker, spinning up threads costs more than it saves
+static const size_t MIN_POINTS_PER_WORKER = 2048;
+
+BatchFbm::BatchFbm( uint8_t octaves, int32_t seed )
+	: mPerlin( octaves, seed )
+{
+}
+
+void BatchFbm::eval( const ci::vec2 *points, size_t count, float *out ) const
+{
+	webparallel::parallelFor( count, MIN_POINTS_PER_WORKER, [&]( size_t begin, size_t end ) {
+		evalChunk( points + begin, end - begin, out + begin );
+	});
+}
+
+vector<float> BatchFbm::eval( const vector<vec2> &points ) const
+{
+	vector<float> result( points.size() );
+	eval( points.data(), points.size(), result.data() );
+	return result;
+}
+
+void BatchFbm::evalChunk( const ci::vec2 *points, size_t count, float *out ) const
+{
+	// Perlin only reads its permutation table here, so chunks can share it safely. This is
+	// still one out-of-line fBm call per point, the only speedup over the old loop is the
+	// threads. A vectorized kernel would need ci::Perlin's permutation table, which is private,
+	// and the output has to stay identical to Perlin::fBm().
+	for( size_t i = 0; i < count; ++i ) {
+		out[i] = mPerlin.fBm( points[i].x, points[i].y );
+	}
+}
@@ -0,0 +1,98 @@
+//
+//  WebProbes.cpp
+//  SpiderWeb
+//
+
+#include "WebProbes.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+using namespace std;
+
+ProbeGrid::ProbeGrid( const ci::vec2 &bounds, float cellSize )
+{
+	setBounds( bounds, cellSize );
+}
+
+void ProbeGrid::setBounds( const ci::vec2 &bounds, float cellSize )
+{
+	mCellSize = std::max( cellSize, 1.0f );
+	mGridSize = ivec2( std::max( 1, int( ceil( bounds.x / mCellSize ) ) ),
+					   std::max( 1, int( ceil( bounds.y / mCellSize ) ) ) );
+	mProbes.clear();
+	mCellIndices.clear();
+	mCellRanges.assign( mGridSize.x * mGridSize.y, ivec2( 0 ) );
+}
+
+ci::ivec2 ProbeGrid::getCell( const ci::vec2 &pos ) const
+{
+	ivec2 cell = ivec2( int( floor( pos.x / mCellSize ) ), int( floor( pos.y / mCellSize ) ) );
+	return glm::clamp( cell, ivec2( 0 ), mGridSize - ivec2( 1 ) );
+}
+
+int ProbeGrid::getCellIndex( const ci::vec2 &pos ) const
+{
+	ivec2 cell = getCell( pos );
+	return cell.y * mGridSize.x + cell.x;
+}
+
+void ProbeGrid::getCellSpan( const ForceProbe &probe, ci::ivec2 *minCell, ci::ivec2 *maxCell ) const
+{
+	*minCell = getCell( probe.position - vec2( probe.radius ) );
+	*maxCell = getCell( probe.position + vec2( probe.radius ) );
+}
+
+void ProbeGrid::bin( const std::vector<ForceProbe> &probes )
+{
+	mProbes = probes;
+	mCellRanges.assign( mGridSize.x * mGridSize.y, ivec2( 0 ) );
+	
+	// COUNT how many probes land in each cell
+	for( const auto &probe : mProbes ) {
+		ivec2 minCell, maxCell;
+		getCellSpan( probe, &minCell, &maxCell );
+		for( int y = minCell.y; y <= maxCell.y; ++y )
+			for( int x = minCell.x; x <= maxCell.x; ++x )
+				mCellRanges[y * mGridSize.x + x].y++;
+	}
+	
+	// PREFIX sum the counts into start offsets
+	int total = 0;
+	for( auto &range : mCellRanges ) {
+		range.x = total;
+		total += range.y;
+		range.y = 0;
+	}
+	
+	// FILL the flat index list, reusing the counts as write cursors
+	mCellIndices.assign( total, -1 );
+	for( int i = 0; i < int( mProbes.size() ); ++i ) {
+		ivec2 minCell, maxCell;
+		getCellSpan( mProbes[i], &minCell, &maxCell );
+		for( int y = minCell.y; y <= maxCell.y; ++y ) {
+			for( int x = minCell.x; x <= maxCell.x; ++x ) {
+				auto &range = mCellRanges[y * mGridSize.x + x];
+				mCellIndices[range.x + range.y] = i;
+				range.y++;
+			}
+		}
+	}
+}
+
+ci::vec3 ProbeGrid::apply( const ci::vec3 &pos ) const
+{
+	if( mProbes.empty() )
+		return pos;
+	
+	vec3 result = pos;
+	const ivec2 &range = mCellRanges[getCellIndex( vec2( pos ) )];
+	for( int i = range.x; i < range.x + range.y; ++i ) {
+		const ForceProbe &probe = mProbes[mCellIndices[i]];
+		if( distance( vec2( result ), probe.position ) < probe.radius ) {
+			float s = glm::clamp( probe.strength, 0.0f, 1.0f );
+			result = vec3( mix( vec2( result ), probe.position, s ), result.z );
+		}
+	}
+	return result;
+}
@@ -0,0 +1,111 @@
+//
+//  WebReadback.cpp
+//  SpiderWeb
+//
+
+#include "WebReadback.h"
+#include "cinder/Log.h"
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const size_t SLOT_COUNT = 2;
+
+// bytes per point of the copy, positions then velocities then flags
+const size_t POINT_BYTES = sizeof(vec4) + sizeof(vec3) + sizeof(int32_t);
+
+} // anonymous namespace
+
+SolverReadback::SolverReadback()
+: mReadIndex( 0 ), mPending( 0 )
+{
+}
+
+SolverReadback::~SolverReadback()
+{
+	clear();
+}
+
+bool SolverReadback::request( const gl::VboRef &positions, const gl::VboRef &velocities, const gl::VboRef &flags, size_t count, int frame, double time )
+{
+	if( mPending == SLOT_COUNT || count == 0 || ! positions || ! velocities || ! flags )
+		return false;
+	
+	// STAGING buffers only ever grow, so sampling the same web doesn't allocate
+	Slot &slot = mSlots[( mReadIndex + mPending ) % SLOT_COUNT];
+	size_t bytes = count * POINT_BYTES;
+	if( ! slot.buffer )
+		slot.buffer = gl::Vbo::create( GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STREAM_READ );
+	else
+		slot.buffer->ensureMinimumSize( bytes );
+	
+	// COPY on the GPU, back to back, the CPU only sees the result once it's mapped
+	{
+		gl::ScopedBuffer write( GL_COPY_WRITE_BUFFER, slot.buffer->getId() );
+		const gl::VboRef sources[3] = { positions, velocities, flags };
+		const size_t sizes[3] = { sizeof(vec4), sizeof(vec3), sizeof(int32_t) };
+		size_t dst = 0;
+		for( int i = 0; i < 3; ++i ) {
+			gl::ScopedBuffer read( GL_COPY_READ_BUFFER, sources[i]->getId() );
+			glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, dst, count * sizes[i] );
+			dst += count * sizes[i];
+		}
+	}
+	
+	slot.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	slot.count = count;
+	slot.frame = frame;
+	slot.time = time;
+	mPending++;
+	return true;
+}
+
+bool SolverReadback::poll( const function<void( const Frame& )> &fn )
+{
+	if( mPending == 0 )
+		return false;
+	
+	// ASK without waiting, flushing so the fence is sure to be reached eventually
+	Slot &slot = mSlots[mReadIndex];
+	GLenum status = glClientWaitSync( slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+	if( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED )
+		return false;
+	
+	glDeleteSync( slot.fence );
+	slot.fence = 0;
+	
+	gl::ScopedBuffer buffer( slot.buffer );
+	const uint8_t *data = static_cast<const uint8_t*>( slot.buffer->mapBufferRange( 0, slot.count * POINT_BYTES, GL_MAP_READ_BIT ) );
+	if( data ) {
+		Frame frame;
+		frame.positionMass = reinterpret_cast<const vec4*>( data );
+		frame.velocities = reinterpret_cast<const vec3*>( data + slot.count * sizeof(vec4) );
+		frame.flags = reinterpret_cast<const int32_t*>( data + slot.count * ( sizeof(vec4) + sizeof(vec3) ) );
+		frame.count = slot.count;
+		frame.frame = slot.frame;
+		frame.time = slot.time;
+		fn( frame );
+		slot.buffer->unmap();
+	}
+	else {
+		CI_LOG_W( "unable to map solver readback of frame " << slot.frame );
+	}
+	
+	mReadIndex = ( mReadIndex + 1 ) % SLOT_COUNT;
+	mPending--;
+	return true;
+}
+
+void SolverReadback::clear()
+{
+	for( size_t i = 0; i < SLOT_COUNT; ++i ) {
+		if( mSlots[i].fence ) {
+			glDeleteSync( mSlots[i].fence );
+			mSlots[i].fence = 0;
+		}
+	}
+	mReadIndex = 0;
+	mPending = 0;
+}
@@ -0,0 +1,145 @@
+//
+//  WebSkeleton.cpp
+//  SpiderWeb
+//
+
+#include "WebSkeleton.h"
+#include "WebParallel.h"
+#include <algorithm>
+
+using namespace ci;
+using namespace std;
+
+static void addNeighbor( WebSkeleton::NeighborList *list, int32_t index, float restLength )
+{
+	for( auto iter = list->begin(); iter != list->end(); ++iter ) {
+		if( iter->first == index )
+			return;
+	}
+	list->push_back( make_pair( index, restLength ) );
+}
+
+void WebSkeleton::build( const SpiderWebRef &web, int stride )
+{
+	stride = std::max( stride, 1 );
+	auto points = web->getPoints();
+	auto rays = web->getRays();
+	size_t count = points.size();
+	
+	// MARK which points sit on a ray and which ones to keep
+	vector<int> rayMembership( count, 0 );
+	vector<bool> keep( count, false );
+	for( auto rayIter = rays.begin(); rayIter != rays.end(); ++rayIter ) {
+		auto chain = (*rayIter)->getRayPoints();	// sorted from the web center out by connectRay()
+		for( size_t j = 0; j < chain.size(); ++j ) {
+			int id = chain[j]->getId();
+			rayMembership[id]++;
+			if( j == 0 || j == chain.size() - 1 || j % stride == 0 )
+				keep[id] = true;
+		}
+	}
+	for( size_t id = 0; id < count; ++id ) {
+		// points off the rays, or shared between rays, always stay
+		if( rayMembership[id] != 1 )
+			keep[id] = true;
+	}
+	// the neighbors of off-ray points stay too, otherwise y-strand joints would end up isolated
+	for( size_t id = 0; id < count; ++id ) {
+		if( rayMembership[id] == 0 ) {
+			auto neighbors = points[id]->getNeighbors();
+			for( auto iter = neighbors.begin(); iter != neighbors.end(); ++iter )
+				keep[(*iter)->getId()] = true;
+		}
+	}
+	
+	// NUMBER the skeleton
+	vector<int32_t> skeletonIndex( count, -1 );
+	mSkeletonIds.clear();
+	for( size_t id = 0; id < count; ++id ) {
+		if( keep[id] ) {
+			skeletonIndex[id] = int32_t( mSkeletonIds.size() );
+			mSkeletonIds.push_back( int32_t( id ) );
+		}
+	}
+	
+	mLinks.assign( count, Link() );
+	for( size_t id = 0; id < count; ++id ) {
+		if( keep[id] )
+			mLinks[id] = Link( skeletonIndex[id], skeletonIndex[id], 0.0f );
+	}
+	
+	// SPRINGS between points that both survived keep their original rest length
+	mNeighbors.assign( mSkeletonIds.size(), NeighborList() );
+	for( size_t s = 0; s < mSkeletonIds.size(); ++s ) {
+		auto p = points[mSkeletonIds[s]];
+		auto neighbors = p->getNeighbors();
+		for( auto iter = neighbors.begin(); iter != neighbors.end(); ++iter ) {
+			int32_t other = skeletonIndex[(*iter)->getId()];
+			if( other >= 0 )
+				addNeighbor( &mNeighbors[s], other, distance( p->getPosition(), (*iter)->getPosition() ) );
+		}
+	}
+	
+	// FOLD each run of dropped ray points into a single spring, and record where along it they sit
+	for( auto rayIter = rays.begin(); rayIter != rays.end(); ++rayIter ) {
+		auto chain = (*rayIter)->getRayPoints();
+		if( chain.empty() )
+			continue;
+		
+		// rest distance of each point along the chain
+		vector<float> along( chain.size(), 0.0f );
+		for( size_t j = 1; j < chain.size(); ++j )
+			along[j] = along[j - 1] + distance( chain[j - 1]->getPosition(), chain[j]->getPosition() );
+		
+		size_t prevKept = 0;
+		for( size_t j = 1; j < chain.size(); ++j ) {
+			if( ! keep[chain[j]->getId()] )
+				continue;
+			
+			int32_t a = skeletonIndex[chain[prevKept]->getId()];
+			int32_t b = skeletonIndex[chain[j]->getId()];
+			float span = along[j] - along[prevKept];
+			if( j - prevKept > 1 ) {
+				addNeighbor( &mNeighbors[a], b, span );
+				addNeighbor( &mNeighbors[b], a, span );
+			}
+			for( size_t k = prevKept + 1; k < j; ++k ) {
+				float t = ( span > 0.0f ) ? ( along[k] - along[prevKept] ) / span : 0.0f;
+				mLinks[chain[k]->getId()] = Link( a, b, t );
+			}
+			prevKept = j;
+		}
+	}
+	
+	// FOLD the remaining springs that touch a dropped point (spiral threads) onto the nearest
+	// skeleton point of each end, so kept points don't come loose from the neighboring rays
+	auto nearest = [this]( size_t id ) {
+		const Link &link = mLinks[id];
+		return ( link.t <= 0.5f ) ? link.a : link.b;
+	};
+	for( size_t id = 0; id < count; ++id ) {
+		auto neighbors = points[id]->getNeighbors();
+		for( auto iter = neighbors.begin(); iter != neighbors.end(); ++iter ) {
+			size_t otherId = (*iter)->getId();
+			if( keep[id] && keep[otherId] )
+				continue;
+			int32_t a = nearest( id );
+			int32_t b = nearest( otherId );
+			if( a == b )
+				continue;
+			float restLength = distance( points[mSkeletonIds[a]]->getPosition(), points[mSkeletonIds[b]]->getPosition() );
+			addNeighbor( &mNeighbors[a], b, restLength );
+			addNeighbor( &mNeighbors[b], a, restLength );
+		}
+	}
+}
+
+void WebSkeleton::reconstruct( const ci::vec4 *skeletonPositions, ci::vec4 *fullPositions ) const
+{
+	webparallel::parallelFor( mLinks.size(), 4096, [&]( size_t begin, size_t end ) {
+		for( size_t i = begin; i < end; ++i ) {
+			const Link &link = mLinks[i];
+			fullPositions[i] = mix( skeletonPositions[link.a], skeletonPositions[link.b], link.t );
+		}
+	});
+}
@@ -0,0 +1,118 @@
+//
+//  WebSolver.cpp
+//  SpiderWeb
+//
+
+#include "WebSolver.h"
+#include "WebParallel.h"
+#include "WebStats.h"
+#include <cmath>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const float MAX_DISPLACEMENT = 25.0f;
+
+bool isFinite( const vec3 &v )
+{
+	return std::isfinite( v.x ) && std::isfinite( v.y ) && std::isfinite( v.z );
+}
+
+} // anonymous namespace
+
+void WebSolver::setup( const SpiderWebRef &web )
+{
+	vector<ParticleRef> points = web->getPoints();
+	size_t count = points.size();
+	
+	mPositions.assign( count, vec4( 0.0f ) );
+	mVelocities.assign( count, vec3( 0.0f ) );
+	mConnections.assign( count, ivec4( -1 ) );
+	mConnectionLen.assign( count, vec4( 0.0f ) );
+	mFlags.assign( count, 0 );
+	
+	for( auto iter = points.begin(); iter != points.end(); ++iter ) {
+		auto point = *iter;
+		int id = point->getId();
+		vec2 pos = point->getPosition();
+		mPositions[id] = vec4( pos.x, pos.y, 0.0f, 1.0f );
+		
+		// use first 4 connections of there are more
+		auto conn = point->getNeighbors();
+		int max = std::min( int( conn.size() ), 4 );
+		for( int i = 0; i < max; ++i ) {
+			mConnections[id][i] = conn[i]->getId();
+			mConnectionLen[id][i] = distance( pos, conn[i]->getPosition() );
+		}
+	}
+	
+	mRestPositions = mPositions;
+	mNextPositions = mPositions;
+	mNextVelocities = mVelocities;
+}
+
+void WebSolver::step( int iterations )
+{
+	for( int i = 0; i < iterations; ++i ) {
+		if( mThreaded ) {
+			webparallel::parallelFor( mPositions.size(), 2048, [this]( size_t begin, size_t end ) {
+				stepRange( begin, end );
+			});
+		}
+		else
+			stepRange( 0, mPositions.size() );
+		mPositions.swap( mNextPositions );
+		mVelocities.swap( mNextVelocities );
+	}
+}
+
+void WebSolver::stepRange( size_t begin, size_t end )
+{
+	// SAME math as update.vert, minus the force probes
+	const float k = mParams.springConstant;
+	const float c = mParams.damping;
+	const float t = mParams.timestep;
+	
+	for( size_t n = begin; n < end; ++n ) {
+		vec3 p = vec3( mPositions[n] );
+		float m = mPositions[n].w;
+		vec3 u = mVelocities[n];
+		vec3 F = mParams.gravity * m - c * u;
+		
+		vec3 avgF( 0.0f );
+		float count = 0.0f;
+		for( int i = 0; i < 4; ++i ) {
+			int other = mConnections[n][i];
+			if( other != -1 ) {
+				vec3 d = vec3( mPositions[other] ) - p;
+				float x = length( d );
+				float cLen = mConnectionLen[n][i] * mParams.tension;
+				avgF += -k * ( cLen - x ) * ( d / x );
+				count += 1.0f;
+			}
+		}
+		
+		// a node without connections is fixed
+		if( count > 0.0f )
+			F += avgF / count;
+		else
+			F = vec3( 0.0f );
+		
+		vec3 a = F / m;
+		vec3 s = u * t + 0.5f * a * t * t;
+		vec3 v = u + a * t;
+		
+		int32_t flags = 0;
+		if( std::abs( s.x ) > MAX_DISPLACEMENT || std::abs( s.y ) > MAX_DISPLACEMENT || std::abs( s.z ) > MAX_DISPLACEMENT )
+			flags |= SolverStats::FLAG_CLAMPED;
+		s = clamp( s, vec3( -MAX_DISPLACEMENT ), vec3( MAX_DISPLACEMENT ) );
+		if( ! isFinite( p + s ) || ! isFinite( v ) )
+			flags |= SolverStats::FLAG_NON_FINITE;
+		
+		mNextPositions[n] = vec4( p + s, m );
+		mNextVelocities[n] = v;
+		mFlags[n] = flags;
+	}
+}
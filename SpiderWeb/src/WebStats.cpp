@@ -0,0 +1,99 @@
+//
+//  WebStats.cpp
+//  SpiderWeb
+//
+
+#include "WebStats.h"
+#include "WebParallel.h"
+#include <cmath>
+#include <fstream>
+#include <mutex>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+bool isFinite( const vec3 &v )
+{
+	return std::isfinite( v.x ) && std::isfinite( v.y ) && std::isfinite( v.z );
+}
+
+} // anonymous namespace
+
+void GenerationStats::addPoint( size_t neighborCount, size_t cap )
+{
+	pointCount++;
+	maxNeighbors = std::max( maxNeighbors, int( neighborCount ) );
+	if( neighborCount == 0 )
+		isolatedCount++;
+	else if( neighborCount > cap ) {
+		truncatedCount++;
+		droppedConnections += int( neighborCount - cap );
+	}
+}
+
+SolverSample SolverStats::measure( const vec4 *positionMass, const vec3 *velocities, const int32_t *flags, size_t count, size_t grain )
+{
+	SolverSample result;
+	mutex resultMutex;
+	
+	webparallel::parallelFor( count, grain, [&]( size_t begin, size_t end ) {
+		// ACCUMULATE per chunk in double, the energy of a big web adds up quickly
+		double energy = 0.0;
+		float maxVelocity = 0.0f;
+		int clamped = 0, nonFinite = 0;
+		for( size_t i = begin; i < end; ++i ) {
+			const vec3 &v = velocities[i];
+			bool finite = isFinite( vec3( positionMass[i] ) ) && std::isfinite( positionMass[i].w ) && isFinite( v );
+			if( flags ) {
+				clamped += ( flags[i] & FLAG_CLAMPED ) ? 1 : 0;
+				finite = finite && ! ( flags[i] & FLAG_NON_FINITE );
+			}
+			if( ! finite ) {
+				nonFinite++;
+				continue;
+			}
+			float speedSq = dot( v, v );
+			energy += 0.5 * positionMass[i].w * speedSq;
+			maxVelocity = std::max( maxVelocity, speedSq );
+		}
+		
+		lock_guard<mutex> lock( resultMutex );
+		result.kineticEnergy += float( energy );
+		result.maxVelocity = std::max( result.maxVelocity, maxVelocity );
+		result.clampedCount += clamped;
+		result.nonFiniteCount += nonFinite;
+	});
+	result.maxVelocity = sqrt( result.maxVelocity );
+	
+	return result;
+}
+
+void SolverStats::record( const SolverSample &sample )
+{
+	mLast = sample;
+	mHistory.push_back( sample );
+	while( mHistory.size() > mMaxHistory )
+		mHistory.pop_front();
+}
+
+bool SolverStats::writeCsv( const fs::path &path ) const
+{
+	ofstream out( path.string().c_str() );
+	if( ! out )
+		return false;
+	
+	out << "# points " << mGeneration.pointCount
+		<< ", truncated " << mGeneration.truncatedCount
+		<< ", dropped connections " << mGeneration.droppedConnections
+		<< ", isolated " << mGeneration.isolatedCount
+		<< ", max neighbors " << mGeneration.maxNeighbors << "\n";
+	out << "frame,time,kinetic_energy,max_velocity,clamped,non_finite\n";
+	for( auto iter = mHistory.begin(); iter != mHistory.end(); ++iter ) {
+		out << iter->frame << "," << iter->time << "," << iter->kineticEnergy << ","
+			<< iter->maxVelocity << "," << iter->clampedCount << "," << iter->nonFiniteCount << "\n";
+	}
+	
+	return bool( out );
+}
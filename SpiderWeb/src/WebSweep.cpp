@@ -0,0 +1,229 @@
+//
+//  WebSweep.cpp
+//  SpiderWeb
+//
+
+#include "WebSweep.h"
+#include "WebParallel.h"
+#include "WebStats.h"
+#include "cinder/Log.h"
+#include "cinder/Rand.h"
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+using namespace ci;
+using namespace std;
+
+//! Reads comma separated \a text into \a values, which is left alone unless every item reads.
+template<typename T>
+static bool parseList( const string &text, vector<T> *values )
+{
+	vector<T> result;
+	stringstream stream( text );
+	string item;
+	while( getline( stream, item, ',' ) ) {
+		stringstream itemStream( item );
+		T value;
+		if( ! ( itemStream >> value ) || ! ( itemStream >> ws ).eof() )
+			return false;
+		result.push_back( value );
+	}
+	if( result.empty() )
+		return false;
+	
+	*values = result;
+	return true;
+}
+
+//! Reads a single value, like parseList() with exactly one item.
+template<typename T>
+static bool parseValue( const string &text, T *value )
+{
+	vector<T> values;
+	if( ! parseList( text, &values ) || values.size() != 1 )
+		return false;
+	
+	*value = values.front();
+	return true;
+}
+
+ParameterSweep::Options::Options()
+: mSpringConstants( { 4.0f, 8.5f, 14.0f } ), mDampings( { 2.0f, 2.8f, 6.0f } ),
+	mTensions( { 0.6f, 0.8f, 1.0f } ), mTimesteps( { 0.07f, 0.2f, 0.35f } ),
+	mSeeds( { 1, 2, 3 } ), mBounds( 0, 0, 1024, 768 ), mRadiusBase( 512.0f ),
+	mFrames( 600 ), mIterationsPerFrame( 5 ), mSettleEnergy( 0.001f )
+{
+}
+
+bool ParameterSweep::Options::parse( const string &name, const string &values )
+{
+	if( name == "springConstants" )
+		return parseList( values, &mSpringConstants );
+	else if( name == "dampings" )
+		return parseList( values, &mDampings );
+	else if( name == "tensions" )
+		return parseList( values, &mTensions );
+	else if( name == "timesteps" )
+		return parseList( values, &mTimesteps );
+	else if( name == "seeds" )
+		return parseList( values, &mSeeds );
+	else if( name == "frames" )
+		return parseValue( values, &mFrames );
+	else if( name == "iterationsPerFrame" )
+		return parseValue( values, &mIterationsPerFrame );
+	else if( name == "settleEnergy" )
+		return parseValue( values, &mSettleEnergy );
+	
+	return false;
+}
+
+bool ParameterSweep::Options::load( const fs::path &path )
+{
+	ifstream in( path.string().c_str() );
+	if( ! in ) {
+		CI_LOG_E( "couldn't open sweep options " << path.string() );
+		return false;
+	}
+	
+	string line;
+	for( int lineNumber = 1; getline( in, line ); ++lineNumber ) {
+		line = line.substr( 0, line.find( '#' ) );
+		stringstream stream( line );
+		string name, value, values;
+		if( ! ( stream >> name ) )
+			continue;
+		// the values can be spaced out after their commas
+		while( stream >> value )
+			values += value;
+		if( ! parse( name, values ) ) {
+			CI_LOG_E( path.string() << ":" << lineNumber << ": can't read \"" << line << "\"" );
+			return false;
+		}
+	}
+	return true;
+}
+
+vector<ParameterSweep::Result> ParameterSweep::run() const
+{
+	// GENERATE the webs up front. Each web is made from its own seed and so is the shape picked for it,
+	// so a seed gives the same web in every sweep
+	vector<WebSolver> webs( mOptions.mSeeds.size() );
+	for( size_t i = 0; i < webs.size(); ++i ) {
+		Rand rand( uint32_t( mOptions.mSeeds[i] ) );
+		auto web = SpiderWeb::create( SpiderWeb::Options()
+			.bounds( mOptions.mBounds )
+			.anchorCount( rand.nextInt( 3, 8 ) )
+			.radiusBase( mOptions.mRadiusBase )
+			.rayPointCount( rand.nextInt( 20, 50 ) )
+			.raySpacing( rand.nextFloat( 20.0, 150.0 ) )
+			.seed( uint32_t( mOptions.mSeeds[i] ) )
+		);
+		web->make();
+		webs[i].setup( web );
+		webs[i].setThreaded( false );
+	}
+	
+	// one job per combination of parameters and web
+	struct Job {
+		size_t				web;
+		WebSolver::Params	params;
+	};
+	vector<Job> jobs;
+	for( float k : mOptions.mSpringConstants )
+		for( float c : mOptions.mDampings )
+			for( float tension : mOptions.mTensions )
+				for( float t : mOptions.mTimesteps )
+					for( size_t w = 0; w < webs.size(); ++w ) {
+						Job job;
+						job.web = w;
+						job.params.springConstant = k;
+						job.params.damping = c;
+						job.params.tension = tension;
+						job.params.timestep = t;
+						jobs.push_back( job );
+					}
+	
+	vector<Result> results( jobs.size() );
+	webparallel::parallelFor( jobs.size(), 1, [&]( size_t begin, size_t end ) {
+		for( size_t i = begin; i < end; ++i ) {
+			const Job &job = jobs[i];
+			results[i] = simulate( webs[job.web], mOptions.mSeeds[job.web], job.params );
+		}
+	});
+	
+	return results;
+}
+
+ParameterSweep::Result ParameterSweep::simulate( const WebSolver &web, int32_t seed, const WebSolver::Params &params ) const
+{
+	WebSolver solver( web );
+	solver.setParams( params );
+	
+	Result result;
+	result.params = params;
+	result.seed = seed;
+	result.pointCount = int( solver.getPointCount() );
+	result.settleFrame = 0;
+	result.peakDisplacement = 0.0f;
+	result.finalSag = 0.0f;
+	result.finalEnergy = 0.0f;
+	result.clampedFrames = 0;
+	result.stable = true;
+	
+	const vector<vec4> &rest = solver.getRestPositions();
+	float settleEnergy = mOptions.mSettleEnergy * std::max( result.pointCount, 1 );
+	for( int frame = 0; frame < mOptions.mFrames; ++frame ) {
+		solver.step( mOptions.mIterationsPerFrame );
+		
+		const vector<vec4> &positions = solver.getPositions();
+		// every combination already has its own worker, so measure inline
+		SolverSample sample = SolverStats::measure( positions.data(), solver.getVelocities().data(), solver.getFlags().data(), positions.size(), positions.size() + 1 );
+		result.finalEnergy = sample.kineticEnergy;
+		if( sample.clampedCount > 0 )
+			result.clampedFrames++;
+		if( sample.nonFiniteCount > 0 ) {
+			// nothing meaningful comes after a NaN
+			result.stable = false;
+			result.settleFrame = -1;
+			return result;
+		}
+		if( sample.kineticEnergy > settleEnergy )
+			result.settleFrame = frame + 1;
+		
+		for( size_t n = 0; n < positions.size(); ++n )
+			result.peakDisplacement = std::max( result.peakDisplacement, distance( vec3( positions[n] ), vec3( rest[n] ) ) );
+	}
+	
+	// y points down the screen, so positive sag is the web hanging lower
+	const vector<vec4> &positions = solver.getPositions();
+	double sag = 0.0;
+	for( size_t n = 0; n < positions.size(); ++n )
+		sag += positions[n].y - rest[n].y;
+	result.finalSag = positions.empty() ? 0.0f : float( sag / positions.size() );
+	
+	// still moving on the last frame means it never settled
+	if( result.settleFrame >= mOptions.mFrames ) {
+		result.settleFrame = -1;
+		result.stable = false;
+	}
+	
+	return result;
+}
+
+bool ParameterSweep::writeCsv( const vector<Result> &results, const fs::path &path )
+{
+	ofstream out( path.string().c_str() );
+	if( ! out )
+		return false;
+	
+	out << "spring_constant,damping,tension,timestep,seed,points,settle_frame,peak_displacement,final_sag,final_energy,clamped_frames,stable\n";
+	for( auto iter = results.begin(); iter != results.end(); ++iter ) {
+		out << iter->params.springConstant << "," << iter->params.damping << "," << iter->params.tension << ","
+			<< iter->params.timestep << "," << iter->seed << "," << iter->pointCount << "," << iter->settleFrame << ","
+			<< iter->peakDisplacement << "," << iter->finalSag << "," << iter->finalEnergy << ","
+			<< iter->clampedFrames << "," << ( iter->stable ? 1 : 0 ) << "\n";
+	}
+	
+	return bool( out );
+}
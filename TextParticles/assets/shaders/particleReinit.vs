@@ -0,0 +1,33 @@
+#version 150 core
+
+// Points running particles away from a new center at a new start velocity, the same
+// way ParticleEmitter launches them. Everything but the previous position passes through.
+
+uniform vec3		uCenter;
+uniform float		uStartVelocity = 5.0;
+
+in vec3   iPosition;
+in vec3   iPPosition;
+in float  iDamping;
+in vec4   iColor;
+in vec2	  iTexCoord;
+in float  iInvMass;
+
+out vec3  position;
+out vec3  pposition;
+out float damping;
+out vec4  color;
+out vec2  texcoord;
+out float invmass;
+
+void main()
+{
+	position =  iPosition;
+	damping =   iDamping;
+	color =     iColor;
+	texcoord =  iTexCoord;
+	invmass =	iInvMass;
+	
+	vec3 direction = normalize( position - uCenter );
+	pposition = position - direction * uStartVelocity;
+}
@@ -0,0 +1,33 @@
+#version 150 core
+
+// particleReinit.vs on the compact layout (see CompactParticle.h). The color is
+// packed back exactly as it was read.
+
+uniform vec3		uCenter;
+uniform float		uStartVelocity = 5.0;
+
+in vec3   iPosition;
+in vec3   iPPosition;
+in float  iDamping;
+in vec4   iColor;		// normalized RGBA8
+
+out vec3  position;
+out vec3  pposition;
+out float damping;
+flat out uint packedColor;
+
+uint packColor( vec4 c )
+{
+	uvec4 bytes = uvec4( clamp( c, 0.0, 1.0 ) * 255.0 + 0.5 );
+	return bytes.r | ( bytes.g << 8 ) | ( bytes.b << 16 ) | ( bytes.a << 24 );
+}
+
+void main()
+{
+	position =  iPosition;
+	damping =   iDamping;
+	packedColor = packColor( iColor );
+	
+	vec3 direction = normalize( position - uCenter );
+	pposition = position - direction * uStartVelocity;
+}
@@ -0,0 +1,73 @@
+#version 150 core
+
+// Same physics as particleUpdate.vs on the compact layout (see CompactParticle.h).
+// Only position, previous position, damping and the packed color are written back,
+// texcoord, invmass and the color at emission come from a static stream. The color
+// is never read back, rounding it to RGBA8 every frame would compound.
+
+uniform sampler2D	uPerlinTex;
+uniform float		uStep = 1.0;
+uniform float		uDampingSpeed = 0.004;
+uniform vec3		uNoiseOffset = vec3( 1.0, 1.0, 0.0 );
+uniform vec3		uEndColor = vec3( 1.0, 1.0, 1.0 );
+
+in vec3   iPosition;
+in vec3   iPPosition;
+in float  iDamping;
+in vec2	  iTexCoord;	// static
+in float  iInvMass;		// static
+in vec4   iBaseColor;	// static, normalized RGBA8
+
+out vec3  position;
+out vec3  pposition;
+out float damping;
+flat out uint packedColor;
+
+uint packColor( vec4 c )
+{
+	uvec4 bytes = uvec4( clamp( c, 0.0, 1.0 ) * 255.0 + 0.5 );
+	return bytes.r | ( bytes.g << 8 ) | ( bytes.b << 16 ) | ( bytes.a << 24 );
+}
+
+// What particleUpdate.vs has multiplied the color by so far. Each frame scales it by
+// uEndColor + ( 1 - uEndColor ) * clamp( damping * 4, 0, 1 ), which only drops below 1
+// once damping is under 0.25, and damping falls by uDampingSpeed a frame since then.
+// So the log of the product is a sum over evenly spaced dampings, integrated here in closed form.
+vec3 fadeScale( float damping )
+{
+	vec3 slope = max( ( vec3( 1.0 ) - uEndColor ) * 4.0, vec3( 0.001 ) );
+	vec3 scale = max( uEndColor + slope * min( damping, 0.25 ), vec3( 0.000001 ) );
+	// integral of log( scale ) from damping up to 0.25, where scale reaches 1
+	vec3 logSum = ( scale - scale * log( scale ) - vec3( 1.0 ) ) / slope;
+	vec3 fade = exp( logSum / max( uDampingSpeed, 0.000001 ) );
+	// an end color of white never fades
+	return mix( vec3( 1.0 ), fade, step( vec3( 0.001 ), ( vec3( 1.0 ) - uEndColor ) * 4.0 ) );
+}
+
+void main()
+{
+	position =  iPosition;
+	pposition =  iPPosition;
+	damping =   iDamping;
+	
+	vec3 vel	   = (position - pposition);
+	vec3 direction = normalize( vel );
+	vec3 perlin	   = ( texture( uPerlinTex, iTexCoord * uNoiseOffset.xy ).rgb * vec3( 2.0 ) ) - vec3(1.0);	// [-1.0,1.0]
+	vec3 acc	   = direction + ((perlin * iInvMass) * uStep);
+	
+	// UPDATE damping
+	damping -= uDampingSpeed;
+	damping = max( damping, 0 );	// min is 0
+	
+	// UPDATE velocity
+	vel += acc;
+	vel *= damping;
+	
+	// UPDATE position and previous position
+	pposition = position;
+	position += vel;
+	
+	// UPDATE color, from the emitted one and the damping alone
+	float a = clamp( damping * 2.0, 0.0, 1.0 );			// alpha
+	packedColor = packColor( vec4( iBaseColor.rgb * fadeScale( damping ), a ) );
+}
@@ -0,0 +1,39 @@
+//
+//  CompactParticle.h
+//  TextParticles
+//
+//  Smaller particle layout. Only the fields the update pass changes go through
+//  transform feedback. The rest live in a static stream that is written once.
+//
+
+#pragma once
+
+#include "Particle.h"
+#include <vector>
+
+//! Written by particleUpdateCompact.vs every frame. 32 bytes instead of 60.
+struct CompactParticle
+{
+	ci::vec3	pos;		// current position
+	ci::vec3	ppos;		// previous position
+	float		damping;	// velocity damping factor
+	uint32_t	color;		// RGBA8 faded from the static color, only read by the render pass
+};
+
+//! Never written after the upload. 12 bytes.
+struct ParticleStatic
+{
+	uint32_t	texcoord;	// two halfs
+	uint16_t	invmass;	// half
+	uint16_t	pad;
+	uint32_t	color;		// RGBA8 at emission, the update fades it by damping instead of feeding the last frame back
+};
+
+//! Splits \a particles into the dynamic and static streams of the compact layout.
+void packParticles( const std::vector<Particle> &particles, std::vector<CompactParticle> *dynamic, std::vector<ParticleStatic> *statics );
+
+//! Packs only the dynamic stream of \a count particles into \a dynamic, for when the static one is already uploaded.
+void packDynamicParticles( const Particle *particles, size_t count, CompactParticle *dynamic );
+
+//! Bytes the update and render passes fetch and write per frame for \a count particles.
+size_t getBytesPerFrame( size_t count, bool compact );
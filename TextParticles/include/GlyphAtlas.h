@@ -0,0 +1,99 @@
+//
+//  GlyphAtlas.h
+//  TextParticles
+//
+//  Glyph coverage packed into fixed size pages. Missing glyphs are rasterized
+//  on worker threads and packed in on the main thread, the least recently used
+//  page is recycled once the page limit is reached. The pages and metrics can
+//  be saved to a cache file keyed by the font file and size, so later launches
+//  start with every glyph they have seen before.
+//
+
+#pragma once
+
+#include "cinder/Area.h"
+#include "cinder/DataSource.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Text.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//! Where a character's coverage lives in the atlas. One line tall, with the top of the line at row 0.
+struct Glyph {
+	Glyph() : page( -1 ), advance( 0.0f ) {}
+
+	int			page;
+	ci::Area	bounds;		// in the page
+	float		advance;	// how far the pen moves after this glyph
+};
+
+class GlyphAtlas {
+  public:
+	//! Loads \a cacheFile if it exists and was made for the same page size. An empty path never touches the disk.
+	GlyphAtlas( const ci::Font &font, const ci::fs::path &cacheFile = ci::fs::path() );
+	~GlyphAtlas();
+
+	//! Returns the glyph for the \a code point, or nullptr while a worker is still rasterizing it.
+	//! Asking for a glyph marks its page as used.
+	const Glyph*	get( uint32_t code );
+	//! Packs the glyphs the workers finished. Call once a frame on the main thread, returns true if any arrived.
+	bool			update();
+
+	//! Coverage of \a page, getPageSize() squared bytes in rows.
+	const uint8_t*	getPageData( int page ) const	{ return mPages[page].coverage.data(); }
+	int				getPageSize() const				{ return mPageSize; }
+	size_t			getPageCount() const			{ return mPages.size(); }
+	size_t			getGlyphCount() const			{ return mGlyphs.size(); }
+	size_t			getPendingCount() const			{ return mRequested.size(); }
+	const ci::Font&	getFont() const					{ return mFont; }
+
+	//! Writes every page and glyph to the cache file. Returns false if there is none or it can't be written.
+	bool			save() const;
+
+	//! Cache file in \a directory for \a font made from \a fontData, named after a hash of the font file and the size.
+	static ci::fs::path	getCacheFile( const ci::fs::path &directory, const ci::DataSourceRef &fontData, const ci::Font &font );
+
+  private:
+	//! Coverage straight from the text renderer, before it's packed
+	struct RasterGlyph {
+		uint32_t				code;
+		std::vector<uint8_t>	coverage;
+		ci::ivec2				size;
+		float					advance;
+	};
+
+	struct Page {
+		std::vector<uint8_t>	coverage;
+		int						shelfX, shelfY, shelfHeight;	// where the next glyph goes
+		uint64_t				lastUse;
+		std::vector<uint32_t>	codes;		// glyphs on this page, dropped when it's recycled
+	};
+
+	static RasterGlyph	rasterize( const ci::Font &font, uint32_t code );
+
+	void	workerLoop();
+	void	pack( const RasterGlyph &raster );
+	int		findPage( const ci::ivec2 &size );
+	void	resetPage( Page *page );
+	bool	load();
+
+	ci::Font									mFont;
+	ci::fs::path								mCacheFile;
+	int											mPageSize;
+	std::vector<Page>							mPages;
+	std::unordered_map<uint32_t, Glyph>			mGlyphs;
+	std::unordered_set<uint32_t>				mRequested;		// handed to the workers, not back yet
+	uint64_t									mUseCounter;
+
+	std::vector<std::thread>					mWorkers;
+	std::mutex									mMutex;
+	std::condition_variable						mCondition;
+	std::deque<uint32_t>						mQueue;			// codes to rasterize
+	std::deque<RasterGlyph>						mFinished;
+	bool										mStopping;
+};
@@ -0,0 +1,97 @@
+//
+//  ImageEmitter.h
+//  TextParticles
+//
+//  Emits explosions from images instead of the typed text: a single image once,
+//  or an image sequence (a video exported as numbered frames) played at a fixed
+//  frame rate and looped. Decoding, emitting and packing run on worker threads
+//  a few frames ahead of the clock, the main thread only picks up the frame
+//  that's due. Frames the workers can't finish in time are skipped rather than
+//  waited on, so playback never holds up drawing.
+//
+
+#pragma once
+
+#include "CompactParticle.h"
+#include "ParticleEmitter.h"
+#include "ParticleLifecycle.h"
+#include "cinder/Filesystem.h"
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ImageEmitter {
+  public:
+	//! What the workers emit with, picked up by each frame as it starts
+	struct Settings {
+		Settings() : compact( false ) {}
+
+		ParticleEmitter::Options	options;
+		bool						compact;		// also split into the compact layout streams
+	};
+
+	//! An emitted frame, ready to upload into a pool range
+	struct Frame {
+		Frame() : index( 0 ), pointSize( 1.0f ) {}
+
+		uint64_t						index;		// counts up across loops
+		ci::ivec2						size;
+		float							pointSize;
+		std::vector<Particle>			particles;	// already in ParticleLifecycle order
+		ParticleLifecycle				lifecycle;
+		std::vector<CompactParticle>	dynamic;	// compact settings only
+		std::vector<ParticleStatic>		statics;
+	};
+
+	ImageEmitter();
+	~ImageEmitter();
+
+	//! Emits once from the image at \a path.
+	void	loadImage( const ci::fs::path &path );
+	//! Plays the images in \a directory in natural name order (f2 before f10) at \a fps, looping. Returns false if it holds none.
+	bool	loadSequence( const ci::fs::path &directory, float fps );
+	//! Stops the workers and drops the frames they made.
+	void	stop();
+	//! True until a single image has been handed over, or until a sequence is stopped.
+	bool	isActive() const		{ return ! mPaths.empty() && mNextWanted < mEndIndex; }
+
+	void	setSettings( const Settings &settings );
+
+	//! Hands over the newest ready frame that is due at \a time, in seconds. Never waits. The clock starts at the
+	//! first call, frames that weren't ready before the next one was due are skipped.
+	bool	poll( double time, Frame *frame );
+
+	size_t	getFrameCount() const	{ return mPaths.size(); }
+	//! Rate the sequence plays at, 0 for a single image.
+	float	getFps() const			{ return mFps; }
+	size_t	getSkippedCount() const	{ return mSkipped; }
+	//! Decode and emit time of a frame on one worker, smoothed.
+	float	getEmitMs() const		{ return mEmitMs; }
+
+  private:
+	void	start( const std::vector<ci::fs::path> &paths, uint64_t endIndex, float fps );
+	void	workerLoop();
+	void	emitFrame( const ci::fs::path &path, const Settings &settings, Frame *frame );
+
+	std::vector<ci::fs::path>	mPaths;
+	uint64_t					mEndIndex;		// one past the last frame, effectively endless when looping
+	float						mFps;
+	double						mStartTime;		// negative until the first poll
+
+	std::vector<std::thread>	mWorkers;
+	std::mutex					mMutex;
+	std::condition_variable		mCondition;
+	Settings					mSettings;
+	uint64_t					mNextIndex;		// next frame a worker takes
+	uint64_t					mClockIndex;	// frame the clock is on, workers never start one older
+	size_t						mInFlight;
+	std::map<uint64_t, Frame>	mReady;
+	bool						mStopping;
+
+	std::atomic<uint64_t>		mNextWanted;	// oldest frame that may still be handed over
+	std::atomic<size_t>			mSkipped;
+	std::atomic<float>			mEmitMs;
+};
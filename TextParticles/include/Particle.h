@@ -0,0 +1,24 @@
+//
+//  Particle.h
+//  TextParticles
+//
+//  Per-particle data as it is laid out in the transform feedback buffers.
+//
+
+#pragma once
+
+#include "cinder/Color.h"
+#include "cinder/Vector.h"
+
+// -------------------------------------------------------------------------------------------------
+// Definition for each particle
+// -------------------------------------------------------------------------------------------------
+struct Particle
+{
+	ci::vec3	pos;		// current position
+	ci::vec3	ppos;		// previous position - velocity is determined as diff between pos and ppos
+	ci::ColorA	color;
+	float		damping;	// velocity damping factor
+	ci::vec2	texcoord;
+	float		invmass;	// arbitrary mass value for randomizing the physics a bit
+};
@@ -0,0 +1,80 @@
+//
+//  ParticleEmitter.h
+//  TextParticles
+//
+//  Turns the visible pixels of a surface into particles. Rows are scanned in
+//  parallel, counted, and written to their offset in a single compact array.
+//  Above a particle budget the surface is split into cells that emit at most
+//  one particle each, so long strings stay affordable.
+//
+
+#pragma once
+
+#include "Particle.h"
+#include "cinder/Surface.h"
+#include <vector>
+
+class ParticleEmitter {
+  public:
+	
+	enum Sampling {
+		SAMPLING_STRIDE,		// top left pixel of every cell, cheap but shows a regular grid
+		SAMPLING_BLUE_NOISE		// one jittered pixel per cell, with coverage weighted odds
+	};
+	
+	typedef class Options {
+	  public:
+		Options()
+		: mAlphaThreshold( 0 ), mCenter( 0, 0, -10.0f ), mStartVelocity( 5.0f ), mDampingBase( 0.45f ), mSeed( 0 ),
+		  mMaxParticles( 0 ), mSampling( SAMPLING_BLUE_NOISE )
+		{ }
+		
+		// ALPHA a pixel needs to be above to emit a particle
+		Options& alphaThreshold( uint8_t alpha ) { mAlphaThreshold = alpha; return *this; }
+		uint8_t getAlphaThreshold() const { return mAlphaThreshold; }
+		
+		// OFFSET from the center of the emitting area that particles fly away from
+		Options& center( const ci::vec3 &center ) { mCenter = center; return *this; }
+		const ci::vec3& getCenter() const { return mCenter; }
+		
+		// SPEED particles start with
+		Options& startVelocity( float velocity ) { mStartVelocity = velocity; return *this; }
+		float getStartVelocity() const { return mStartVelocity; }
+		
+		// BASE of the random start damping, which lands in [base, base + 0.2]
+		Options& dampingBase( float base ) { mDampingBase = base; return *this; }
+		float getDampingBase() const { return mDampingBase; }
+		
+		// SEED of the per-row random generators, so emission is the same on any number of threads
+		Options& seed( uint32_t seed ) { mSeed = seed; return *this; }
+		uint32_t getSeed() const { return mSeed; }
+		
+		// BUDGET of particles, 0 emits from every visible pixel
+		Options& maxParticles( size_t count ) { mMaxParticles = count; return *this; }
+		size_t getMaxParticles() const { return mMaxParticles; }
+		
+		// SAMPLING used once the visible pixels are over budget
+		Options& sampling( Sampling sampling ) { mSampling = sampling; return *this; }
+		Sampling getSampling() const { return mSampling; }
+		
+	  private:
+		uint8_t		mAlphaThreshold;
+		ci::vec3	mCenter;
+		float		mStartVelocity;
+		float		mDampingBase;
+		uint32_t	mSeed;
+		size_t		mMaxParticles;
+		Sampling	mSampling;
+	} Options;
+	
+	//! Emits a particle for every pixel of the \a size area at the top left of \a surface
+	//! whose alpha is above the threshold, or for a subset of them when that is over budget.
+	//! Never emits more than a non-zero budget.
+	//! Replaces the contents of \a particles. Returns the spacing between particles in pixels,
+	//! 1 when every pixel emits, so the caller can grow the particles to cover the same area.
+	static float emit( const ci::Surface8u &surface, const ci::ivec2 &size, const Options &options, std::vector<Particle> *particles );
+	
+	//! Points \a count particles away from \a center at \a startVelocity, from wherever they are now.
+	//! Only ppos is written, so running particles can be relaunched in place.
+	static void launch( Particle *particles, size_t count, const ci::vec3 &center, float startVelocity );
+};
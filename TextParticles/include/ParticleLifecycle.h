@@ -0,0 +1,39 @@
+//
+//  ParticleLifecycle.h
+//  TextParticles
+//
+//  Tracks which particles are still alive without reading anything back.
+//  Damping only ever goes down by the same amount for every particle, so
+//  particles die in the order of their starting damping. Sorting them by it
+//  once keeps the survivors packed at the front of the buffer, and the live
+//  count follows from how much damping has been used up so far.
+//
+
+#pragma once
+
+#include "Particle.h"
+#include <vector>
+
+class ParticleLifecycle {
+  public:
+	ParticleLifecycle() : mUsedDamping( 0.0f ), mLiveCount( 0 ) {}
+	
+	//! Reorders \a particles from the highest starting damping to the lowest and resets the live count.
+	void	setup( std::vector<Particle> *particles );
+	//! Call once per update pass with the damping speed it ran with.
+	void	advance( float dampingSpeed );
+	
+	//! Particles [0, getLiveCount()) may still be visible, the rest never will be again.
+	size_t	getLiveCount() const	{ return mLiveCount; }
+	bool	isFinished() const		{ return mLiveCount == 0; }
+	
+  private:
+	struct Bucket {
+		float	maxDamping;		// highest starting damping in the bucket
+		size_t	end;			// one past the last particle of the bucket
+	};
+	
+	std::vector<Bucket>	mBuckets;	// in buffer order, highest damping first
+	float				mUsedDamping;
+	size_t				mLiveCount;
+};
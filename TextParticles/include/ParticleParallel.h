@@ -0,0 +1,58 @@
+//
+//  ParticleParallel.h
+//  TextParticles
+//
+//  Small helpers for splitting particle arrays across worker threads.
+//  The same helper as SpiderWeb's WebParallel.h, copied rather than shared
+//  because every sample builds on its own. Fixes belong in both.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace particleparallel {
+
+//! Returns the number of workers to use, never less than 1.
+inline size_t getWorkerCount()
+{
+	size_t count = std::thread::hardware_concurrency();
+	return ( count > 0 ) ? count : 1;
+}
+
+//! Calls \a fn( begin, end ) over contiguous chunks of [0, count). Chunks are never smaller than \a grain,
+//! so small batches run inline on the calling thread instead of paying for thread startup.
+inline void parallelFor( size_t count, size_t grain, const std::function<void( size_t, size_t )> &fn )
+{
+	if( count == 0 )
+		return;
+
+	grain = std::max<size_t>( grain, 1 );
+	size_t workers = std::min( getWorkerCount(), ( count + grain - 1 ) / grain );
+	if( workers <= 1 ) {
+		fn( 0, count );
+		return;
+	}
+
+	size_t chunk = ( count + workers - 1 ) / workers;
+	std::vector<std::thread> threads;
+	threads.reserve( workers - 1 );
+	for( size_t w = 1; w < workers; ++w ) {
+		size_t begin = w * chunk;
+		size_t end = std::min( begin + chunk, count );
+		if( begin >= end )
+			break;
+		threads.emplace_back( fn, begin, end );
+	}
+
+	// the calling thread takes the first chunk
+	fn( 0, std::min( chunk, count ) );
+
+	for( auto &t : threads )
+		t.join();
+}
+
+} // namespace particleparallel
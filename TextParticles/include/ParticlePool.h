@@ -0,0 +1,53 @@
+//
+//  ParticlePool.h
+//  TextParticles
+//
+//  Hands out ranges of a fixed size particle buffer to explosions, in ring
+//  order. New explosions go after the newest one, wrap to the start when they
+//  don't fit, and push out whatever older explosion they land on. The GPU
+//  buffers are sized once for the capacity and never reallocated.
+//
+
+#pragma once
+
+#include "ParticleLifecycle.h"
+#include <deque>
+
+class ParticlePool {
+  public:
+	//! One explosion's slice of the buffers
+	struct Range {
+		uint64_t			id;			// unique for the life of the pool, offsets get reused
+		size_t				offset;		// first particle in the buffers
+		size_t				count;		// particles emitted
+		ParticleLifecycle	lifecycle;	// the live particles are [offset, offset + lifecycle.getLiveCount())
+		double				startTime;	// when it exploded, drives its step animation
+		ci::vec2			textSize;	// size of the text it came from, to center it
+		float				pointSize;	// spacing it was sampled with
+	};
+	
+	ParticlePool() : mCapacity( 0 ), mHead( 0 ), mNextId( 1 ) {}
+	
+	//! Drops every range and sets how many particles the buffers hold.
+	void	reset( size_t capacity );
+	//! Drops every range, keeps the capacity.
+	void	clear();
+	
+	//! Reserves \a count particles at the ring head, evicting the ranges it overlaps. Returns nullptr if \a count is
+	//! 0 or more than the capacity. The returned range stays valid until the next allocate(), advance() or clear().
+	Range*	allocate( size_t count );
+	//! Advances every range's lifecycle and frees the ranges that finished.
+	void	advance( float dampingSpeed );
+	
+	const std::deque<Range>&	getRanges() const	{ return mRanges; }
+	size_t						getCapacity() const	{ return mCapacity; }
+	//! Live particles over all ranges, what the update and render passes touch
+	size_t						getLiveCount() const;
+	bool						empty() const		{ return mRanges.empty(); }
+	
+  private:
+	std::deque<Range>	mRanges;	// oldest first
+	size_t				mCapacity;
+	size_t				mHead;		// where the next range starts
+	uint64_t			mNextId;
+};
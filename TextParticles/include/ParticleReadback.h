@@ -0,0 +1,61 @@
+//
+//  ParticleReadback.h
+//  TextParticles
+//
+//  Gets particle data from the GPU without stalling. Each request copies the
+//  asked-for ranges into one of two staging buffers on the GPU and fences it.
+//  The copy is mapped a frame or more later, once the fence says it's done.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include <functional>
+#include <vector>
+
+class ParticleReadback {
+  public:
+	//! A run of particles in the source buffer
+	struct Segment {
+		size_t		offset;		// first particle
+		size_t		count;
+		uint64_t	tag;		// the caller's, handed back untouched
+	};
+	
+	//! A finished copy, only valid inside the poll() callback
+	struct Frame {
+		const uint8_t				*data;		// the segments back to back
+		size_t						stride;		// bytes per particle
+		const std::vector<Segment>	*segments;
+		uint64_t					id;			// what was passed to request()
+	};
+	
+	ParticleReadback();
+	~ParticleReadback();
+	
+	//! Queues a copy of \a segments of \a source, \a stride bytes per particle. Returns false when both staging
+	//! buffers are still waiting to be read, the caller can just try again next frame.
+	bool	request( const ci::gl::VboRef &source, size_t stride, const std::vector<Segment> &segments, uint64_t id );
+	//! Maps the oldest copy if the GPU is done with it and hands it to \a fn. Never waits, returns false if nothing
+	//! was ready. Copies are consumed in request order, even one that fails to map and never reaches \a fn.
+	bool	poll( const std::function<void( const Frame& )> &fn );
+	//! Drops the copies in flight, for when the source buffers are replaced.
+	void	clear();
+	
+	size_t	getPendingCount() const		{ return mPending; }
+	
+  private:
+	struct Slot {
+		Slot() : fence( 0 ), stride( 0 ), id( 0 ) {}
+		
+		ci::gl::VboRef			buffer;
+		GLsync					fence;
+		std::vector<Segment>	segments;
+		size_t					stride;
+		uint64_t				id;
+	};
+	
+	Slot	mSlots[2];
+	size_t	mReadIndex;		// oldest copy in flight
+	size_t	mPending;
+};
@@ -0,0 +1,84 @@
+//
+//  ParticleRecorder.h
+//  TextParticles
+//
+//  Streams particle positions and colors to disk for offline rendering. The
+//  main thread only copies the raw particles into a recycled buffer. Turning
+//  them into records and writing them happens on a writer thread.
+//
+//  FORMAT_PLY writes frame_000000.ply, frame_000001.ply, ... as binary little
+//  endian PLY, with float x, y, z and uchar red, green, blue, alpha per vertex.
+//  FORMAT_BINARY appends every frame to particles.bin: the magic "TPF1" once,
+//  then per frame a uint32 frame number, a uint32 count, and count records of
+//  float x, y, z and uint8 r, g, b, a. Both are 16 bytes per particle.
+//
+
+#pragma once
+
+#include "cinder/Filesystem.h"
+#include "cinder/Vector.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ParticleRecorder {
+  public:
+	enum Format {
+		FORMAT_PLY,
+		FORMAT_BINARY
+	};
+	
+	//! A run of raw particles and where to move them to, like the model matrix they are drawn with
+	struct Run {
+		const uint8_t	*data;
+		size_t			count;
+		ci::vec3		translate;
+	};
+	
+	ParticleRecorder();
+	~ParticleRecorder();
+	
+	//! Starts a new sequence in \a directory, which is created if needed. Stops the current one first.
+	void	start( const ci::fs::path &directory, Format format );
+	//! Writes out the frames that are still queued and stops the writer thread.
+	void	stop();
+	bool	isRecording() const		{ return mRecording; }
+	
+	//! Copies \a runs of particles, \a stride bytes each in the compact or full layout, and queues them for writing.
+	//! Returns false and drops the frame when the writer is too far behind, it never waits on it.
+	bool	addFrame( uint32_t frame, const std::vector<Run> &runs, size_t stride, bool compact );
+	
+	size_t	getWrittenCount() const	{ return mWritten; }
+	size_t	getDroppedCount() const	{ return mDropped; }
+	
+  private:
+	struct Job {
+		uint32_t				frame;
+		std::vector<uint8_t>	raw;		// the runs back to back
+		std::vector<size_t>		counts;
+		std::vector<ci::vec3>	translates;
+		size_t					stride;
+		bool					compact;
+	};
+	
+	void	writerLoop();
+	void	writeJob( const Job &job );
+	
+	ci::fs::path			mDirectory;
+	Format					mFormat;
+	std::ofstream			mBinaryFile;	// FORMAT_BINARY only, written by the writer thread
+	bool					mRecording;
+	
+	std::thread				mWriter;
+	std::mutex				mMutex;
+	std::condition_variable	mCondition;
+	std::deque<Job>			mJobs;
+	std::vector<std::vector<uint8_t>>	mFreeBuffers;	// raw buffers to reuse, so steady recording doesn't allocate
+	bool					mStopping;
+	
+	std::atomic<size_t>		mWritten, mDropped;
+};
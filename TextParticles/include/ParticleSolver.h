@@ -0,0 +1,62 @@
+//
+//  ParticleSolver.h
+//  TextParticles
+//
+//  CPU port of shaders/particleUpdate.vs, for running the explosion without
+//  a GPU and for checking the shader against.
+//
+
+#pragma once
+
+#include "Particle.h"
+#include "cinder/Surface.h"
+#include <vector>
+
+//! Bilinear, repeating lookups into the Perlin texture, like texture() with GL_LINEAR and GL_REPEAT.
+class PerlinSampler {
+  public:
+	//! Most lookups the batched sample() takes at once
+	static const size_t BATCH_SIZE = 64;
+	
+	PerlinSampler() : mSize( 0 ), mMask( 0 ) {}
+	//! \a surface needs power of two dimensions, so repeating is a mask. Otherwise the sampler stays invalid.
+	PerlinSampler( const ci::Surface8u &surface );
+	
+	//! Returns the rgb at \a uv in [0, 1], scaled from [0, 255].
+	ci::vec3	sample( const ci::vec2 &uv ) const;
+	//! Samples \a count <= BATCH_SIZE coordinates into one array per channel. Texels are gathered
+	//! first and then filtered a channel at a time over whole arrays, so the lerps vectorize.
+	void		sample( const ci::vec2 *uvs, size_t count, float *r, float *g, float *b ) const;
+	bool		isValid() const		{ return ! mChannels[0].empty(); }
+	
+  private:
+	std::vector<float>	mChannels[3];	// r, g and b planes, rows from the top of the surface like the uploaded texture
+	ci::ivec2			mSize, mMask;
+};
+
+class ParticleSolver {
+  public:
+	//! Mirrors the uniforms of particleUpdate.vs
+	struct Params {
+		Params() : step( 1.0f ), dampingSpeed( 0.004f ), noiseOffset( 1.0f, 1.0f, 0.0f ), endColor( 1.0f, 1.0f, 1.0f ) {}
+		
+		float		step;
+		float		dampingSpeed;
+		ci::vec3	noiseOffset;
+		ci::Color	endColor;
+	};
+	
+	ParticleSolver() {}
+	ParticleSolver( const PerlinSampler &perlin ) : mPerlin( perlin ) {}
+	
+	void					setPerlin( const PerlinSampler &perlin )	{ mPerlin = perlin; }
+	const PerlinSampler&	getPerlin() const							{ return mPerlin; }
+	
+	//! Runs one update of \a count particles in place, split into chunks across worker threads.
+	void update( Particle *particles, size_t count, const Params &params ) const;
+	
+  private:
+	void updateRange( Particle *particles, size_t begin, size_t end, const Params &params ) const;
+	
+	PerlinSampler	mPerlin;
+};
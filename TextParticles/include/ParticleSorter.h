@@ -0,0 +1,28 @@
+//
+//  ParticleSorter.h
+//  TextParticles
+//
+//  Orders particles back to front for alpha blending. View depths are turned
+//  into integer keys and sorted with a parallel LSD radix sort, which is
+//  linear in the particle count and keeps equal depths in buffer order.
+//
+
+#pragma once
+
+#include "cinder/Matrix.h"
+#include <vector>
+
+class ParticleSorter {
+  public:
+	ParticleSorter() {}
+	
+	//! Orders \a count particles back to front as seen through \a modelView. \a data points at the first particle's
+	//! position, a vec3, and particles are \a stride bytes apart, so both layouts and mapped buffers can be sorted
+	//! without a copy. \a order gets indices relative to the first particle, farthest first.
+	void sort( const void *data, size_t stride, size_t count, const ci::mat4 &modelView, std::vector<uint32_t> *order );
+	
+  private:
+	// scratch kept between sorts so refreshing doesn't allocate
+	std::vector<uint32_t>	mKeys, mKeysTmp, mOrderTmp;
+	std::vector<uint32_t>	mHistograms;	// 256 per chunk
+};
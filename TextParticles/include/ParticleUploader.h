@@ -0,0 +1,55 @@
+//
+//  ParticleUploader.h
+//  TextParticles
+//
+//  Gets particle data onto the GPU without stalling. Each batch is written
+//  into one of two staging buffers and copied into place on the GPU, so the
+//  driver never has to wait for a draw that still reads the destination.
+//  A staging buffer the GPU is still copying from is orphaned instead of
+//  waited on.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include <vector>
+
+class ParticleUploader {
+  public:
+	ParticleUploader();
+	~ParticleUploader();
+
+	//! Starts a batch of \a bytes and returns where to write them, valid until end(). Returns nullptr if the
+	//! staging buffer can't be mapped, end() then does nothing.
+	uint8_t*	begin( size_t bytes );
+	//! Queues \a bytes written at \a stagingOffset of the batch to go to \a destOffset of \a dest.
+	void		copy( size_t stagingOffset, const ci::gl::VboRef &dest, size_t destOffset, size_t bytes );
+	//! Unmaps the batch and copies it into place on the GPU.
+	void		end();
+	//! Forgets the copies in flight, for when the destination buffers are replaced.
+	void		clear();
+
+	//! Batches that found their staging buffer still busy and orphaned it.
+	size_t		getOrphanCount() const	{ return mOrphanCount; }
+
+  private:
+	struct Copy {
+		size_t			stagingOffset;
+		ci::gl::VboRef	dest;
+		size_t			destOffset;
+		size_t			bytes;
+	};
+
+	struct Slot {
+		Slot() : fence( 0 ) {}
+
+		ci::gl::VboRef	buffer;
+		GLsync			fence;		// signaled once the GPU is done copying out of it
+	};
+
+	Slot				mSlots[2];
+	size_t				mWriteIndex;
+	bool				mMapped;
+	std::vector<Copy>	mCopies;
+	size_t				mOrphanCount;
+};
@@ -0,0 +1,56 @@
+//
+//  TextRasterizer.h
+//  TextParticles
+//
+//  Builds the text surface on the CPU from glyphs in a GlyphAtlas, so typing
+//  only rasterizes new characters and never reads anything back from the GPU.
+//  Characters whose glyphs are still being rasterized are laid out once they
+//  arrive, in the order they were typed.
+//
+
+#pragma once
+
+#include "GlyphAtlas.h"
+#include "cinder/Surface.h"
+#include <vector>
+
+class TextRasterizer {
+  public:
+	//! The surface is white everywhere, the text only shows up in the alpha channel.
+	//! Glyphs are kept in \a cacheFile between runs, see GlyphAtlas.
+	TextRasterizer( const ci::Font &font, const ci::ivec2 &surfaceSize, const ci::fs::path &cacheFile = ci::fs::path() );
+	
+	//! Adds a character at the end of the line. Only its own glyph is written.
+	void	append( uint32_t code );
+	//! Lays out characters whose glyphs just arrived. Returns true if the surface changed.
+	bool	update();
+	//! Removes the last character. Only the glyphs that overlapped it are written again.
+	void	popBack();
+	void	clear();
+	
+	//! Lays the characters placed so far out again from scratch and compares that with the surface append() and
+	//! popBack() built up. Returns how many pixels differ, or -1 if a glyph has left the atlas since. Leaves the
+	//! surface as it was.
+	int		verify();
+	
+	const ci::Surface8u&	getSurface() const		{ return mSurface; }
+	//! Size of the laid out text, from the top left of the surface.
+	ci::vec2				getTextSize() const		{ return ci::vec2( mPen, mLineHeight ); }
+	size_t					getLength() const		{ return mCodes.size(); }
+	//! Characters typed but not laid out yet.
+	size_t					getPendingCount() const	{ return mCodes.size() - mPens.size(); }
+	GlyphAtlas&				getGlyphAtlas()			{ return mAtlas; }
+	
+  private:
+	void	layout();
+	void	blit( const Glyph &glyph, float x );
+	void	clearColumns( int x1, int x2 );
+	
+	GlyphAtlas				mAtlas;
+	ci::Surface8u			mSurface;
+	std::vector<uint32_t>	mCodes;
+	std::vector<float>		mPens;		// x of each character laid out so far
+	std::vector<int>		mWidths;	// width of each of their glyphs
+	float					mPen;
+	float					mLineHeight;
+};
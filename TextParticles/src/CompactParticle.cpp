@@ -0,0 +1,65 @@
+//
+//  CompactParticle.cpp
+//  TextParticles
+//
+
+#include "CompactParticle.h"
+#include "ParticleParallel.h"
+#include "glm/gtc/packing.hpp"
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+uint32_t packColor( const ColorA &color )
+{
+	// same byte order as the shader's packColor(), red in the lowest byte
+	return uint32_t( glm::clamp( color.r, 0.0f, 1.0f ) * 255.0f + 0.5f )
+		| uint32_t( glm::clamp( color.g, 0.0f, 1.0f ) * 255.0f + 0.5f ) << 8
+		| uint32_t( glm::clamp( color.b, 0.0f, 1.0f ) * 255.0f + 0.5f ) << 16
+		| uint32_t( glm::clamp( color.a, 0.0f, 1.0f ) * 255.0f + 0.5f ) << 24;
+}
+
+} // anonymous namespace
+
+void packParticles( const vector<Particle> &particles, vector<CompactParticle> *dynamic, vector<ParticleStatic> *statics )
+{
+	dynamic->resize( particles.size() );
+	packDynamicParticles( particles.data(), particles.size(), dynamic->data() );
+	statics->resize( particles.size() );
+	particleparallel::parallelFor( particles.size(), 16384, [&]( size_t begin, size_t end ) {
+		for( size_t i = begin; i < end; ++i ) {
+			const Particle &p = particles[i];
+			ParticleStatic &s = (*statics)[i];
+			s.texcoord	= glm::packHalf2x16( p.texcoord );
+			s.invmass	= glm::packHalf1x16( p.invmass );
+			s.pad		= 0;
+			s.color		= packColor( p.color );
+		}
+	});
+}
+
+void packDynamicParticles( const Particle *particles, size_t count, CompactParticle *dynamic )
+{
+	particleparallel::parallelFor( count, 16384, [&]( size_t begin, size_t end ) {
+		for( size_t i = begin; i < end; ++i ) {
+			const Particle &p = particles[i];
+			CompactParticle &d = dynamic[i];
+			d.pos		= p.pos;
+			d.ppos		= p.ppos;
+			d.damping	= p.damping;
+			d.color		= packColor( p.color );
+		}
+	});
+}
+
+size_t getBytesPerFrame( size_t count, bool compact )
+{
+	// the update reads and writes the whole particle. The render reads position and color. The compact
+	// update skips the dynamic color, it starts from the static one
+	if( compact )
+		return count * ( sizeof(CompactParticle) - sizeof(uint32_t) + sizeof(ParticleStatic) + sizeof(CompactParticle) + sizeof(vec3) + sizeof(uint32_t) );
+	else
+		return count * ( sizeof(Particle) + sizeof(Particle) + sizeof(vec3) + sizeof(ColorA) );
+}
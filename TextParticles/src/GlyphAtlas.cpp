@@ -0,0 +1,343 @@
+//
+//  GlyphAtlas.cpp
+//  TextParticles
+//
+
+#include "GlyphAtlas.h"
+#include "cinder/Log.h"
+#include "cinder/Unicode.h"
+#include "cinder/Utilities.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+// a 120pt glyph is around 100 x 150, so a page holds about sixty of them
+const int PAGE_SIZE = 1024;
+const size_t MAX_PAGES = 16;
+// glyphs never touch each other, so bilinear lookups or padding later stay clean
+const int GLYPH_PADDING = 1;
+const size_t WORKER_COUNT = 2;
+
+const char CACHE_MAGIC[4] = { 'T', 'P', 'G', 'A' };
+const uint32_t CACHE_VERSION = 1;
+
+// FNV-1a, enough to tell font files apart
+uint64_t hashBytes( const uint8_t *data, size_t size )
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for( size_t i = 0; i < size; ++i ) {
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+template<typename T>
+void writeValue( ofstream &out, const T &value )
+{
+	out.write( reinterpret_cast<const char*>( &value ), sizeof(T) );
+}
+
+template<typename T>
+bool readValue( ifstream &in, T *value )
+{
+	in.read( reinterpret_cast<char*>( value ), sizeof(T) );
+	return bool( in );
+}
+
+#if defined( CINDER_MSW )
+// the MSW text renderer draws through one shared device context
+std::mutex sRenderMutex;
+#endif
+
+} // anonymous namespace
+
+GlyphAtlas::GlyphAtlas( const Font &font, const fs::path &cacheFile )
+: mFont( font ), mCacheFile( cacheFile ), mPageSize( PAGE_SIZE ), mUseCounter( 0 ), mStopping( false )
+{
+	if( ! mCacheFile.empty() && fs::exists( mCacheFile ) ) {
+		if( load() )
+			CI_LOG_I( "loaded " << mGlyphs.size() << " glyphs on " << mPages.size() << " pages from " << mCacheFile.string() );
+		else
+			CI_LOG_W( "ignoring glyph cache " << mCacheFile.string() );
+	}
+
+	for( size_t i = 0; i < WORKER_COUNT; ++i )
+		mWorkers.emplace_back( &GlyphAtlas::workerLoop, this );
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mStopping = true;
+	}
+	mCondition.notify_all();
+	for( auto &worker : mWorkers )
+		worker.join();
+}
+
+const Glyph* GlyphAtlas::get( uint32_t code )
+{
+	auto iter = mGlyphs.find( code );
+	if( iter != mGlyphs.end() ) {
+		mPages[iter->second.page].lastUse = ++mUseCounter;
+		return &iter->second;
+	}
+
+	// QUEUE it once, the caller asks again after update() packs it
+	if( mRequested.insert( code ).second ) {
+		{
+			lock_guard<mutex> lock( mMutex );
+			mQueue.push_back( code );
+		}
+		mCondition.notify_one();
+	}
+	return nullptr;
+}
+
+bool GlyphAtlas::update()
+{
+	deque<RasterGlyph> finished;
+	{
+		lock_guard<mutex> lock( mMutex );
+		finished.swap( mFinished );
+	}
+
+	for( auto iter = finished.begin(); iter != finished.end(); ++iter ) {
+		mRequested.erase( iter->code );
+		pack( *iter );
+	}
+	return ! finished.empty();
+}
+
+void GlyphAtlas::workerLoop()
+{
+	while( true ) {
+		uint32_t code;
+		{
+			unique_lock<mutex> lock( mMutex );
+			mCondition.wait( lock, [this] { return ! mQueue.empty() || mStopping; } );
+			if( mStopping )
+				return;
+			code = mQueue.front();
+			mQueue.pop_front();
+		}
+
+		RasterGlyph raster = rasterize( mFont, code );
+
+		lock_guard<mutex> lock( mMutex );
+		mFinished.push_back( std::move( raster ) );
+	}
+}
+
+GlyphAtlas::RasterGlyph GlyphAtlas::rasterize( const Font &font, uint32_t code )
+{
+	string utf8 = toUtf8( u32string( 1, char32_t( code ) ) );
+	TextBox box = TextBox().font( font ).text( utf8 ).size( TextBox::GROW, TextBox::GROW )
+		.color( ColorA( 1, 1, 1, 1 ) ).backgroundColor( ColorA( 0, 0, 0, 0 ) ).premultiplied( false );
+
+	RasterGlyph glyph;
+	glyph.code = code;
+
+#if defined( CINDER_MSW )
+	lock_guard<mutex> lock( sRenderMutex );
+#endif
+	glyph.advance = box.measure().x;
+	Surface8u surface = box.render();
+	glyph.size = surface.getSize();
+	glyph.coverage.assign( glyph.size.x * glyph.size.y, 0 );
+	if( ! surface.hasAlpha() )
+		return glyph;
+
+	// KEEP only the alpha, the text is always white
+	uint8_t inc = surface.getPixelInc();
+	uint8_t a = surface.getAlphaOffset();
+	for( int y = 0; y < glyph.size.y; ++y ) {
+		const uint8_t *pixel = surface.getData( ivec2( 0, y ) );
+		uint8_t *out = &glyph.coverage[y * glyph.size.x];
+		for( int x = 0; x < glyph.size.x; ++x, pixel += inc )
+			out[x] = pixel[a];
+	}
+
+	return glyph;
+}
+
+void GlyphAtlas::pack( const RasterGlyph &raster )
+{
+	// anything bigger than a page is cut to fit, it'd be far taller than the text surface anyway
+	ivec2 size = glm::min( raster.size, ivec2( mPageSize - GLYPH_PADDING ) );
+	int pageIndex = findPage( size );
+	Page &page = mPages[pageIndex];
+
+	// SHELF packing, glyphs of one font are about the same height so little space is lost
+	if( page.shelfX + size.x > mPageSize ) {
+		page.shelfX = 0;
+		page.shelfY += page.shelfHeight + GLYPH_PADDING;
+		page.shelfHeight = 0;
+	}
+
+	Glyph glyph;
+	glyph.page = pageIndex;
+	glyph.bounds = Area( page.shelfX, page.shelfY, page.shelfX + size.x, page.shelfY + size.y );
+	glyph.advance = raster.advance;
+	for( int y = 0; y < size.y; ++y )
+		std::copy_n( &raster.coverage[y * raster.size.x], size.x, &page.coverage[( page.shelfY + y ) * mPageSize + page.shelfX] );
+
+	page.shelfX += size.x + GLYPH_PADDING;
+	page.shelfHeight = std::max( page.shelfHeight, size.y );
+	page.lastUse = ++mUseCounter;
+	page.codes.push_back( raster.code );
+	mGlyphs[raster.code] = glyph;
+}
+
+int GlyphAtlas::findPage( const ivec2 &size )
+{
+	// the newest page takes it if there's room on its shelf or below it
+	if( ! mPages.empty() ) {
+		const Page &last = mPages.back();
+		bool fitsShelf = last.shelfX + size.x <= mPageSize && last.shelfY + size.y <= mPageSize;
+		bool fitsBelow = last.shelfY + last.shelfHeight + GLYPH_PADDING + size.y <= mPageSize;
+		if( fitsShelf || fitsBelow )
+			return int( mPages.size() - 1 );
+	}
+
+	if( mPages.size() < MAX_PAGES ) {
+		mPages.push_back( Page() );
+		resetPage( &mPages.back() );
+		return int( mPages.size() - 1 );
+	}
+
+	// RECYCLE the least recently used page. It moves to the back so it's the one that fills up next
+	auto lru = std::min_element( mPages.begin(), mPages.end(), []( const Page &a, const Page &b ) { return a.lastUse < b.lastUse; } );
+	for( auto code = lru->codes.begin(); code != lru->codes.end(); ++code )
+		mGlyphs.erase( *code );
+	resetPage( &*lru );
+
+	int from = int( lru - mPages.begin() );
+	int to = int( mPages.size() - 1 );
+	if( from != to ) {
+		std::swap( mPages[from], mPages[to] );
+		for( auto code = mPages[from].codes.begin(); code != mPages[from].codes.end(); ++code )
+			mGlyphs[*code].page = from;
+	}
+	return to;
+}
+
+void GlyphAtlas::resetPage( Page *page )
+{
+	page->coverage.assign( mPageSize * mPageSize, 0 );
+	page->shelfX = page->shelfY = page->shelfHeight = 0;
+	page->lastUse = ++mUseCounter;
+	page->codes.clear();
+}
+
+bool GlyphAtlas::save() const
+{
+	if( mCacheFile.empty() )
+		return false;
+
+	try {
+		fs::create_directories( mCacheFile.parent_path() );
+	}
+	catch( const std::exception &exc ) {
+		CI_LOG_E( "unable to create " << mCacheFile.parent_path().string() << ": " << exc.what() );
+		return false;
+	}
+
+	ofstream out( mCacheFile.string().c_str(), ios::binary | ios::trunc );
+	if( ! out ) {
+		CI_LOG_E( "unable to write " << mCacheFile.string() );
+		return false;
+	}
+
+	out.write( CACHE_MAGIC, sizeof(CACHE_MAGIC) );
+	writeValue( out, CACHE_VERSION );
+	writeValue( out, uint32_t( mPageSize ) );
+	writeValue( out, uint32_t( mPages.size() ) );
+	writeValue( out, uint32_t( mGlyphs.size() ) );
+	for( auto iter = mGlyphs.begin(); iter != mGlyphs.end(); ++iter ) {
+		writeValue( out, iter->first );
+		writeValue( out, int32_t( iter->second.page ) );
+		writeValue( out, int32_t( iter->second.bounds.x1 ) );
+		writeValue( out, int32_t( iter->second.bounds.y1 ) );
+		writeValue( out, int32_t( iter->second.bounds.x2 ) );
+		writeValue( out, int32_t( iter->second.bounds.y2 ) );
+		writeValue( out, iter->second.advance );
+	}
+	for( auto iter = mPages.begin(); iter != mPages.end(); ++iter ) {
+		writeValue( out, int32_t( iter->shelfX ) );
+		writeValue( out, int32_t( iter->shelfY ) );
+		writeValue( out, int32_t( iter->shelfHeight ) );
+		out.write( reinterpret_cast<const char*>( iter->coverage.data() ), iter->coverage.size() );
+	}
+	return bool( out );
+}
+
+bool GlyphAtlas::load()
+{
+	ifstream in( mCacheFile.string().c_str(), ios::binary );
+	char magic[4];
+	uint32_t version, pageSize, pageCount, glyphCount;
+	in.read( magic, sizeof(magic) );
+	if( ! in || ! std::equal( magic, magic + 4, CACHE_MAGIC ) )
+		return false;
+	if( ! readValue( in, &version ) || version != CACHE_VERSION )
+		return false;
+	if( ! readValue( in, &pageSize ) || int( pageSize ) != mPageSize )
+		return false;
+	if( ! readValue( in, &pageCount ) || pageCount > MAX_PAGES || ! readValue( in, &glyphCount ) )
+		return false;
+
+	unordered_map<uint32_t, Glyph> glyphs;
+	vector<Page> pages( pageCount );
+	for( uint32_t i = 0; i < glyphCount; ++i ) {
+		uint32_t code;
+		int32_t page, x1, y1, x2, y2;
+		float advance;
+		if( ! readValue( in, &code ) || ! readValue( in, &page ) || ! readValue( in, &x1 ) || ! readValue( in, &y1 )
+			|| ! readValue( in, &x2 ) || ! readValue( in, &y2 ) || ! readValue( in, &advance ) )
+			return false;
+		if( page < 0 || page >= int32_t( pageCount ) || x1 < 0 || y1 < 0 || x2 > mPageSize || y2 > mPageSize || x1 > x2 || y1 > y2 )
+			return false;
+
+		Glyph &glyph = glyphs[code];
+		glyph.page = page;
+		glyph.bounds = Area( x1, y1, x2, y2 );
+		glyph.advance = advance;
+		pages[page].codes.push_back( code );
+	}
+
+	for( auto iter = pages.begin(); iter != pages.end(); ++iter ) {
+		int32_t shelfX, shelfY, shelfHeight;
+		if( ! readValue( in, &shelfX ) || ! readValue( in, &shelfY ) || ! readValue( in, &shelfHeight ) )
+			return false;
+		iter->shelfX = shelfX;
+		iter->shelfY = shelfY;
+		iter->shelfHeight = shelfHeight;
+		iter->lastUse = 0;
+		iter->coverage.resize( mPageSize * mPageSize );
+		in.read( reinterpret_cast<char*>( iter->coverage.data() ), iter->coverage.size() );
+		if( ! in )
+			return false;
+	}
+
+	mPages.swap( pages );
+	mGlyphs.swap( glyphs );
+	return true;
+}
+
+fs::path GlyphAtlas::getCacheFile( const fs::path &directory, const DataSourceRef &fontData, const Font &font )
+{
+	BufferRef buffer = fontData->getBuffer();
+	uint64_t hash = hashBytes( static_cast<const uint8_t*>( buffer->getData() ), buffer->getSize() );
+
+	char name[64];
+	std::snprintf( name, sizeof(name), "%016llx_%d.atlas", (unsigned long long)hash, int( font.getSize() ) );
+	return directory / name;
+}
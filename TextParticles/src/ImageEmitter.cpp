@@ -0,0 +1,243 @@
+//
+//  ImageEmitter.cpp
+//  TextParticles
+//
+
+#include "ImageEmitter.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Log.h"
+#include "cinder/Timer.h"
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <limits>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+// two frames emit at once, each one also splits its rows across every core
+const size_t WORKER_COUNT = 2;
+// frames emitted but not due yet, a 1080p frame at the full pool is ~100MB
+const size_t MAX_FRAMES_AHEAD = 2;
+
+bool isImageFile( const fs::path &path )
+{
+	string ext = path.extension().string();
+	std::transform( ext.begin(), ext.end(), ext.begin(), ::tolower );
+	return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tif" || ext == ".tiff" || ext == ".bmp";
+}
+
+//! Orders names with their runs of digits compared as numbers, so f2 comes before f10 even without zero padding.
+bool naturalLess( const string &a, const string &b )
+{
+	size_t i = 0, j = 0;
+	while( i < a.size() && j < b.size() ) {
+		if( ! ::isdigit( (unsigned char)a[i] ) || ! ::isdigit( (unsigned char)b[j] ) ) {
+			if( a[i] != b[j] )
+				return a[i] < b[j];
+			++i, ++j;
+			continue;
+		}
+		
+		// COMPARE the numbers by their digits without leading zeros, a longer one is larger
+		size_t i0 = i, j0 = j;
+		while( i < a.size() && ::isdigit( (unsigned char)a[i] ) )
+			++i;
+		while( j < b.size() && ::isdigit( (unsigned char)b[j] ) )
+			++j;
+		size_t iz = a.find_first_not_of( '0', i0 ), jz = b.find_first_not_of( '0', j0 );
+		iz = std::min( iz, i ), jz = std::min( jz, j );
+		if( i - iz != j - jz )
+			return i - iz < j - jz;
+		int digits = a.compare( iz, i - iz, b, jz, j - jz );
+		if( digits != 0 )
+			return digits < 0;
+	}
+	return a.size() - i < b.size() - j;
+}
+
+} // anonymous namespace
+
+ImageEmitter::ImageEmitter()
+: mEndIndex( 0 ), mFps( 30.0f ), mStartTime( -1.0 ), mNextIndex( 0 ), mClockIndex( 0 ), mInFlight( 0 ),
+  mStopping( false ), mNextWanted( 0 ), mSkipped( 0 ), mEmitMs( 0.0f )
+{
+}
+
+ImageEmitter::~ImageEmitter()
+{
+	stop();
+}
+
+void ImageEmitter::loadImage( const fs::path &path )
+{
+	start( vector<fs::path>( 1, path ), 1, 0.0f );
+}
+
+bool ImageEmitter::loadSequence( const fs::path &directory, float fps )
+{
+	vector<fs::path> paths;
+	try {
+		for( fs::directory_iterator iter( directory ), end; iter != end; ++iter ) {
+			if( fs::is_regular_file( iter->path() ) && isImageFile( iter->path() ) )
+				paths.push_back( iter->path() );
+		}
+	}
+	catch( const std::exception &exc ) {
+		CI_LOG_E( "unable to list " << directory.string() << ": " << exc.what() );
+		return false;
+	}
+
+	if( paths.empty() ) {
+		CI_LOG_W( "no images in " << directory.string() );
+		return false;
+	}
+
+	// numbered frames sort into play order, with or without zero padding
+	std::sort( paths.begin(), paths.end(), [] ( const fs::path &a, const fs::path &b ) {
+		return naturalLess( a.filename().string(), b.filename().string() );
+	});
+	start( paths, numeric_limits<uint64_t>::max(), std::max( fps, 1.0f ) );
+	CI_LOG_I( "playing " << paths.size() << " frames from " << directory.string() << " at " << fps << " fps" );
+	return true;
+}
+
+void ImageEmitter::start( const vector<fs::path> &paths, uint64_t endIndex, float fps )
+{
+	stop();
+
+	mPaths = paths;
+	mEndIndex = endIndex;
+	mFps = fps;
+	mStartTime = -1.0;
+	mNextIndex = mClockIndex = 0;
+	mNextWanted = 0;
+	mSkipped = 0;
+	mStopping = false;
+	for( size_t i = 0; i < WORKER_COUNT; ++i )
+		mWorkers.emplace_back( &ImageEmitter::workerLoop, this );
+}
+
+void ImageEmitter::stop()
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mStopping = true;
+	}
+	mCondition.notify_all();
+	for( auto &worker : mWorkers )
+		worker.join();
+
+	mWorkers.clear();
+	mReady.clear();
+	mInFlight = 0;
+	mPaths.clear();
+}
+
+void ImageEmitter::setSettings( const Settings &settings )
+{
+	lock_guard<mutex> lock( mMutex );
+	mSettings = settings;
+}
+
+bool ImageEmitter::poll( double time, Frame *frame )
+{
+	if( ! isActive() )
+		return false;
+
+	if( mStartTime < 0.0 )
+		mStartTime = time;
+
+	bool handed = false;
+	{
+		lock_guard<mutex> lock( mMutex );
+		// a single image is due as soon as it's ready
+		if( mFps > 0.0f )
+			mClockIndex = std::max( mClockIndex, uint64_t( ( time - mStartTime ) * mFps ) );
+
+		// TAKE the newest ready frame that's due, anything older was overtaken by the clock
+		auto due = mReady.upper_bound( mClockIndex );
+		if( due != mReady.begin() ) {
+			auto newest = std::prev( due );
+			mSkipped += std::distance( mReady.begin(), newest );
+			*frame = std::move( newest->second );
+			mNextWanted = newest->first + 1;
+			mReady.erase( mReady.begin(), due );
+			handed = true;
+		}
+	}
+
+	// a slot ahead just opened up, or the clock moved on
+	mCondition.notify_all();
+	return handed;
+}
+
+void ImageEmitter::workerLoop()
+{
+	while( true ) {
+		uint64_t index;
+		Settings settings;
+		{
+			unique_lock<mutex> lock( mMutex );
+			mCondition.wait( lock, [this] {
+				return mStopping || ( mNextIndex < mEndIndex && mInFlight + mReady.size() < MAX_FRAMES_AHEAD );
+			});
+			if( mStopping )
+				return;
+
+			// SKIP AHEAD when the clock has overtaken the workers, there's no point emitting a late frame
+			index = std::max( mNextIndex, mClockIndex );
+			mSkipped += index - mNextIndex;
+			mNextIndex = index + 1;
+			mInFlight++;
+			settings = mSettings;
+		}
+
+		// each frame explodes a little differently, and the same way on any worker
+		settings.options.seed( settings.options.getSeed() + uint32_t( index ) * 0x9E3779B9 );
+
+		Timer timer( true );
+		Frame frame;
+		frame.index = index;
+		emitFrame( mPaths[index % mPaths.size()], settings, &frame );
+		float ms = float( timer.getSeconds() * 1000.0 );
+		mEmitMs = ( mEmitMs == 0.0f ) ? ms : mEmitMs * 0.9f + ms * 0.1f;
+
+		{
+			lock_guard<mutex> lock( mMutex );
+			mInFlight--;
+			if( index >= mNextWanted && ! frame.particles.empty() )
+				mReady[index] = std::move( frame );
+			else {
+				mSkipped++;
+				// a single image that failed has nothing else coming
+				if( index + 1 == mEndIndex )
+					mNextWanted = mEndIndex;
+			}
+		}
+		mCondition.notify_all();
+	}
+}
+
+void ImageEmitter::emitFrame( const fs::path &path, const Settings &settings, Frame *frame )
+{
+	Surface8u surface;
+	try {
+		surface = Surface8u( ci::loadImage( path ) );
+	}
+	catch( const std::exception &exc ) {
+		CI_LOG_E( "unable to load " << path.string() << ": " << exc.what() );
+		return;
+	}
+
+	// EMIT, the same as the text, but images without alpha emit from every pixel
+	frame->size = surface.getSize();
+	frame->pointSize = ParticleEmitter::emit( surface, frame->size, settings.options, &frame->particles );
+
+	// ORDER and pack here too, so all the main thread does is copy
+	frame->lifecycle.setup( &frame->particles );
+	if( settings.compact )
+		packParticles( frame->particles, &frame->dynamic, &frame->statics );
+}
@@ -0,0 +1,227 @@
+//
+//  ParticleEmitter.cpp
+//  TextParticles
+//
+
+#include "ParticleEmitter.h"
+#include "ParticleParallel.h"
+#include "cinder/Rand.h"
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+// rows per worker, short strings aren't worth the threads
+const size_t MIN_ROWS_PER_WORKER = 32;
+// particles per worker when relaunching, it's only a normalize each
+const size_t MIN_PARTICLES_PER_WORKER = 16384;
+// times the cell size is grown when a sampling pass still lands over budget
+const int MAX_BUDGET_PASSES = 8;
+
+// Reads the visible pixels of the emitting area, shared by the counting and filling passes
+class PixelReader {
+  public:
+	PixelReader( const Surface8u &surface, uint8_t threshold )
+	: mData( surface.getData() ), mRowBytes( surface.getRowBytes() ), mInc( surface.getPixelInc() ),
+	  mHasAlpha( surface.hasAlpha() ), mAlpha( surface.hasAlpha() ? surface.getAlphaOffset() : 0 ), mThreshold( threshold )
+	{ }
+
+	const uint8_t*	getPixel( int x, int y ) const	{ return mData + y * mRowBytes + x * mInc; }
+	// surfaces without alpha emit everywhere
+	bool			isVisible( int x, int y ) const	{ return ! mHasAlpha || getPixel( x, y )[mAlpha] > mThreshold; }
+	bool			hasAlpha() const				{ return mHasAlpha; }
+	uint8_t			getAlphaOffset() const			{ return mAlpha; }
+
+  private:
+	const uint8_t	*mData;
+	ptrdiff_t		mRowBytes;
+	uint8_t			mInc;
+	bool			mHasAlpha;
+	uint8_t			mAlpha;
+	uint8_t			mThreshold;
+};
+
+// Square cells of \a spacing pixels covering a w x h area, each emits at most one particle
+class CellGrid {
+  public:
+	CellGrid( int w, int h, float spacing )
+	: mWidth( w ), mHeight( h ), mSpacing( spacing ),
+	  mCols( int( std::ceil( w / spacing ) ) ), mRows( int( std::ceil( h / spacing ) ) )
+	{ }
+
+	int		getCols() const		{ return mCols; }
+	int		getRows() const		{ return mRows; }
+	float	getSpacing() const	{ return mSpacing; }
+
+	//! Pixel bounds of cell ( \a col, \a row ), never empty
+	Area getCell( int col, int row ) const
+	{
+		int x1 = std::min( int( ( col + 1 ) * mSpacing ), mWidth );
+		int y1 = std::min( int( ( row + 1 ) * mSpacing ), mHeight );
+		int x0 = std::min( int( col * mSpacing ), x1 - 1 );
+		int y0 = std::min( int( row * mSpacing ), y1 - 1 );
+		return Area( x0, y0, x1, y1 );
+	}
+
+  private:
+	int		mWidth, mHeight;
+	float	mSpacing;
+	int		mCols, mRows;
+};
+
+// Integer hash of a cell, the same on every thread and every run for a given seed
+uint32_t hashCell( uint32_t seed, uint32_t col, uint32_t row )
+{
+	uint32_t h = seed ^ ( col * 0x8DA6B343 ) ^ ( row * 0xD8163841 );
+	h ^= h >> 16;
+	h *= 0x7FEB352D;
+	h ^= h >> 15;
+	h *= 0x846CA68B;
+	h ^= h >> 16;
+	return h;
+}
+
+bool selectPixel( const PixelReader &reader, const CellGrid &grid, ParticleEmitter::Sampling sampling, uint32_t seed, int col, int row, ivec2 *pixel )
+{
+	Area cell = grid.getCell( col, row );
+	if( sampling == ParticleEmitter::SAMPLING_STRIDE ) {
+		*pixel = cell.getUL();
+		return reader.isVisible( pixel->x, pixel->y );
+	}
+
+	// BLUE NOISE: a single draw decides whether the cell emits, with odds of visible pixels over area, and
+	// which of its visible pixels it emits from. Cells half covered by a glyph edge emit half as often.
+	int visible = 0;
+	for( int y = cell.y1; y < cell.y2; ++y )
+		for( int x = cell.x1; x < cell.x2; ++x )
+			visible += reader.isVisible( x, y ) ? 1 : 0;
+
+	uint32_t area = uint32_t( cell.calcArea() );
+	int pick = int( ( uint64_t( hashCell( seed, col, row ) ) * area ) >> 32 );
+	if( pick >= visible )
+		return false;
+
+	for( int y = cell.y1; y < cell.y2; ++y ) {
+		for( int x = cell.x1; x < cell.x2; ++x ) {
+			if( reader.isVisible( x, y ) && pick-- == 0 ) {
+				*pixel = ivec2( x, y );
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// COUNTS the particles each cell row emits into \a rowOffsets[row + 1], returns the total
+size_t countCells( const PixelReader &reader, const CellGrid &grid, ParticleEmitter::Sampling sampling, uint32_t seed, vector<uint32_t> *rowOffsets )
+{
+	rowOffsets->assign( grid.getRows() + 1, 0 );
+	particleparallel::parallelFor( grid.getRows(), MIN_ROWS_PER_WORKER, [&]( size_t begin, size_t end ) {
+		ivec2 pixel;
+		for( size_t row = begin; row < end; ++row ) {
+			uint32_t count = 0;
+			for( int col = 0; col < grid.getCols(); ++col )
+				count += selectPixel( reader, grid, sampling, seed, col, int( row ), &pixel ) ? 1 : 0;
+			(*rowOffsets)[row + 1] = count;
+		}
+	});
+
+	size_t total = 0;
+	for( size_t row = 1; row < rowOffsets->size(); ++row )
+		total += (*rowOffsets)[row];
+	return total;
+}
+
+} // anonymous namespace
+
+float ParticleEmitter::emit( const Surface8u &surface, const ivec2 &size, const Options &options, vector<Particle> *particles )
+{
+	particles->clear();
+
+	int w = std::min( size.x, surface.getWidth() );
+	int h = std::min( size.y, surface.getHeight() );
+	if( w <= 0 || h <= 0 )
+		return 1.0f;
+
+	PixelReader reader( surface, options.getAlphaThreshold() );
+	uint8_t r = surface.getRedOffset(), g = surface.getGreenOffset(), b = surface.getBlueOffset();
+	Sampling sampling = options.getSampling();
+	uint32_t seed = options.getSeed();
+	size_t budget = options.getMaxParticles();
+
+	// COUNT the visible pixels of each row, one pixel cells emit from every visible pixel
+	vector<uint32_t> rowOffsets;
+	CellGrid grid( w, h, 1.0f );
+	size_t total = countCells( reader, grid, SAMPLING_STRIDE, seed, &rowOffsets );
+
+	// GROW the cells until the particles fit the budget. Each pass scales the cell area by the overshoot,
+	// so it usually settles on the first try
+	for( int pass = 0; budget > 0 && total > budget && pass < MAX_BUDGET_PASSES; ++pass ) {
+		float spacing = grid.getSpacing() * std::sqrt( float( total ) / float( budget ) ) * ( pass > 0 ? 1.02f : 1.0f );
+		// strides are whole pixels, and always move forward
+		if( sampling == SAMPLING_STRIDE )
+			spacing = std::max( std::ceil( spacing ), grid.getSpacing() + 1.0f );
+		grid = CellGrid( w, h, spacing );
+		total = countCells( reader, grid, sampling, seed, &rowOffsets );
+	}
+	if( grid.getSpacing() == 1.0f )
+		sampling = SAMPLING_STRIDE;
+
+	// PREFIX SUM turns the counts into where each row starts writing
+	for( int row = 0; row < grid.getRows(); ++row )
+		rowOffsets[row + 1] += rowOffsets[row];
+	particles->resize( rowOffsets[grid.getRows()] );
+
+	// FILL each row's range. Every row has its own generator so the result doesn't depend on the thread count
+	vec3 center = vec3( w / 2.0f, h / 2.0f, 0 ) + options.getCenter();
+	float dampingBase = options.getDampingBase();
+	float startVelocity = options.getStartVelocity();
+	bool hasAlpha = reader.hasAlpha();
+	uint8_t a = reader.getAlphaOffset();
+	Particle *out = particles->data();
+	particleparallel::parallelFor( grid.getRows(), MIN_ROWS_PER_WORKER, [&]( size_t begin, size_t end ) {
+		ivec2 pixel;
+		for( size_t row = begin; row < end; ++row ) {
+			Rand rand( seed + uint32_t( row ) * 0x9E3779B9 );
+			Particle *p = out + rowOffsets[row];
+			for( int col = 0; col < grid.getCols(); ++col ) {
+				if( ! selectPixel( reader, grid, sampling, seed, col, int( row ), &pixel ) )
+					continue;
+
+				const uint8_t *src = reader.getPixel( pixel.x, pixel.y );
+				vec3 pos		= vec3( pixel.x, pixel.y, 1.0f );
+				vec3 dir		= normalize( pos - center );
+				p->pos			= pos;
+				p->texcoord		= vec2( float(pixel.x) / float(w), float(pixel.y) / float(h) );
+				p->ppos			= pos - dir * startVelocity;
+				p->damping		= rand.nextFloat( dampingBase, dampingBase + 0.2f );
+				p->color		= ColorA( src[r] / 255.0f, src[g] / 255.0f, src[b] / 255.0f, hasAlpha ? src[a] / 255.0f : 1.0f );
+				p->invmass		= rand.nextFloat( 0.1f, 1.0f );
+				++p;
+			}
+		}
+	});
+
+	// THIN whatever the passes left over budget with an even stride over the whole range. The particles
+	// are in row order, so cutting the tail would take the overshoot from the bottom rows only
+	size_t count = particles->size();
+	if( budget > 0 && count > budget ) {
+		for( size_t i = 0; i < budget; ++i )
+			(*particles)[i] = (*particles)[size_t( uint64_t( i ) * count / budget )];
+		particles->resize( budget );
+	}
+
+	return grid.getSpacing();
+}
+
+void ParticleEmitter::launch( Particle *particles, size_t count, const vec3 &center, float startVelocity )
+{
+	particleparallel::parallelFor( count, MIN_PARTICLES_PER_WORKER, [&]( size_t begin, size_t end ) {
+		for( size_t i = begin; i < end; ++i ) {
+			Particle &p = particles[i];
+			vec3 dir = normalize( p.pos - center );
+			p.ppos = p.pos - dir * startVelocity;
+		}
+	});
+}
@@ -0,0 +1,76 @@
+//
+//  ParticleLifecycle.cpp
+//  TextParticles
+//
+
+#include "ParticleLifecycle.h"
+#include <algorithm>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const size_t BUCKET_COUNT = 1024;
+
+} // anonymous namespace
+
+void ParticleLifecycle::setup( vector<Particle> *particles )
+{
+	mBuckets.clear();
+	mUsedDamping = 0.0f;
+	mLiveCount = particles->size();
+	if( particles->empty() )
+		return;
+	
+	float minDamping = particles->front().damping, maxDamping = minDamping;
+	for( auto iter = particles->begin(); iter != particles->end(); ++iter ) {
+		minDamping = std::min( minDamping, iter->damping );
+		maxDamping = std::max( maxDamping, iter->damping );
+	}
+	
+	// BUCKET SORT on the starting damping, highest first. The order inside a bucket
+	// doesn't matter, a bucket stays alive until its highest damping runs out.
+	float range = std::max( maxDamping - minDamping, 1e-6f );
+	auto bucketOf = [&]( float damping ) {
+		size_t b = size_t( ( maxDamping - damping ) / range * ( BUCKET_COUNT - 1 ) );
+		return std::min( b, BUCKET_COUNT - 1 );
+	};
+	
+	vector<size_t> offsets( BUCKET_COUNT + 1, 0 );
+	vector<float> bucketMax( BUCKET_COUNT, 0.0f );
+	for( auto iter = particles->begin(); iter != particles->end(); ++iter ) {
+		size_t b = bucketOf( iter->damping );
+		offsets[b + 1]++;
+		bucketMax[b] = std::max( bucketMax[b], iter->damping );
+	}
+	for( size_t b = 0; b < BUCKET_COUNT; ++b )
+		offsets[b + 1] += offsets[b];
+	
+	vector<Particle> sorted( particles->size() );
+	vector<size_t> cursor( offsets.begin(), offsets.end() - 1 );
+	for( auto iter = particles->begin(); iter != particles->end(); ++iter )
+		sorted[cursor[bucketOf( iter->damping )]++] = *iter;
+	particles->swap( sorted );
+	
+	for( size_t b = 0; b < BUCKET_COUNT; ++b ) {
+		if( offsets[b + 1] > offsets[b] ) {
+			Bucket bucket;
+			bucket.maxDamping = bucketMax[b];
+			bucket.end = offsets[b + 1];
+			mBuckets.push_back( bucket );
+		}
+	}
+}
+
+void ParticleLifecycle::advance( float dampingSpeed )
+{
+	mUsedDamping += dampingSpeed;
+	
+	// DROP the buckets whose best particle has run out of damping. The GPU subtracts
+	// one step at a time in float, so give it one extra step before calling it dead.
+	while( ! mBuckets.empty() && mBuckets.back().maxDamping <= mUsedDamping - dampingSpeed )
+		mBuckets.pop_back();
+	
+	mLiveCount = mBuckets.empty() ? 0 : mBuckets.back().end;
+}
@@ -0,0 +1,73 @@
+//
+//  ParticlePool.cpp
+//  TextParticles
+//
+
+#include "ParticlePool.h"
+
+using namespace ci;
+using namespace std;
+
+void ParticlePool::reset( size_t capacity )
+{
+	mCapacity = capacity;
+	clear();
+}
+
+void ParticlePool::clear()
+{
+	mRanges.clear();
+	mHead = 0;
+}
+
+ParticlePool::Range* ParticlePool::allocate( size_t count )
+{
+	if( count == 0 || count > mCapacity )
+		return nullptr;
+	
+	// WRAP to the start instead of splitting a range, so every range is one draw
+	size_t offset = ( mHead + count > mCapacity ) ? 0 : mHead;
+	size_t end = offset + count;
+	
+	// EVICT whatever the new range lands on. In ring order that is always the oldest, still running or not
+	for( auto iter = mRanges.begin(); iter != mRanges.end(); ) {
+		if( iter->offset < end && offset < iter->offset + iter->count )
+			iter = mRanges.erase( iter );
+		else
+			++iter;
+	}
+	
+	Range range;
+	range.id = mNextId++;
+	range.offset = offset;
+	range.count = count;
+	range.startTime = 0.0;
+	range.textSize = vec2( 0 );
+	range.pointSize = 1.0f;
+	mRanges.push_back( range );
+	mHead = end;
+	return &mRanges.back();
+}
+
+void ParticlePool::advance( float dampingSpeed )
+{
+	for( auto iter = mRanges.begin(); iter != mRanges.end(); ) {
+		iter->lifecycle.advance( dampingSpeed );
+		if( iter->lifecycle.isFinished() )
+			iter = mRanges.erase( iter );
+		else
+			++iter;
+	}
+	
+	// an empty pool starts over at the front
+	if( mRanges.empty() )
+		mHead = 0;
+}
+
+size_t ParticlePool::getLiveCount() const
+{
+	size_t count = 0;
+	for( auto iter = mRanges.begin(); iter != mRanges.end(); ++iter )
+		count += iter->lifecycle.getLiveCount();
+	return count;
+}
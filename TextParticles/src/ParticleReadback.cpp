@@ -0,0 +1,113 @@
+//
+//  ParticleReadback.cpp
+//  TextParticles
+//
+
+#include "ParticleReadback.h"
+#include "cinder/Log.h"
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const size_t SLOT_COUNT = 2;
+
+} // anonymous namespace
+
+ParticleReadback::ParticleReadback()
+: mReadIndex( 0 ), mPending( 0 )
+{
+}
+
+ParticleReadback::~ParticleReadback()
+{
+	clear();
+}
+
+bool ParticleReadback::request( const gl::VboRef &source, size_t stride, const vector<Segment> &segments, uint64_t id )
+{
+	if( mPending == SLOT_COUNT || ! source )
+		return false;
+	
+	size_t bytes = 0;
+	for( auto iter = segments.begin(); iter != segments.end(); ++iter )
+		bytes += iter->count * stride;
+	if( bytes == 0 )
+		return false;
+	
+	// STAGING buffers only ever grow, so a steady stream of requests doesn't allocate
+	Slot &slot = mSlots[( mReadIndex + mPending ) % SLOT_COUNT];
+	if( ! slot.buffer )
+		slot.buffer = gl::Vbo::create( GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STREAM_READ );
+	else
+		slot.buffer->ensureMinimumSize( bytes );
+	
+	// COPY on the GPU, back to back, the CPU only sees the result once it's mapped
+	{
+		gl::ScopedBuffer read( GL_COPY_READ_BUFFER, source->getId() );
+		gl::ScopedBuffer write( GL_COPY_WRITE_BUFFER, slot.buffer->getId() );
+		size_t dst = 0;
+		for( auto iter = segments.begin(); iter != segments.end(); ++iter ) {
+			glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, iter->offset * stride, dst, iter->count * stride );
+			dst += iter->count * stride;
+		}
+	}
+	
+	slot.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	slot.segments = segments;
+	slot.stride = stride;
+	slot.id = id;
+	mPending++;
+	return true;
+}
+
+bool ParticleReadback::poll( const function<void( const Frame& )> &fn )
+{
+	if( mPending == 0 )
+		return false;
+	
+	// ASK without waiting, flushing so the fence is sure to be reached eventually
+	Slot &slot = mSlots[mReadIndex];
+	GLenum status = glClientWaitSync( slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+	if( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED )
+		return false;
+	
+	glDeleteSync( slot.fence );
+	slot.fence = 0;
+	
+	size_t bytes = 0;
+	for( auto iter = slot.segments.begin(); iter != slot.segments.end(); ++iter )
+		bytes += iter->count * slot.stride;
+	
+	gl::ScopedBuffer buffer( slot.buffer );
+	const uint8_t *data = static_cast<const uint8_t*>( slot.buffer->mapBufferRange( 0, bytes, GL_MAP_READ_BIT ) );
+	if( data ) {
+		Frame frame;
+		frame.data = data;
+		frame.stride = slot.stride;
+		frame.segments = &slot.segments;
+		frame.id = slot.id;
+		fn( frame );
+		slot.buffer->unmap();
+	}
+	else {
+		CI_LOG_W( "unable to map readback " << slot.id );
+	}
+	
+	mReadIndex = ( mReadIndex + 1 ) % SLOT_COUNT;
+	mPending--;
+	return true;
+}
+
+void ParticleReadback::clear()
+{
+	for( size_t i = 0; i < SLOT_COUNT; ++i ) {
+		if( mSlots[i].fence ) {
+			glDeleteSync( mSlots[i].fence );
+			mSlots[i].fence = 0;
+		}
+	}
+	mReadIndex = 0;
+	mPending = 0;
+}
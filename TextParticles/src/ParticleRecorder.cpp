@@ -0,0 +1,212 @@
+//
+//  ParticleRecorder.cpp
+//  TextParticles
+//
+
+#include "ParticleRecorder.h"
+#include "CompactParticle.h"
+#include "cinder/Log.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+// frames waiting for the writer before new ones are dropped, each can be tens of megabytes
+const size_t MAX_QUEUED_FRAMES = 4;
+
+//! What goes to disk per particle, the same for both formats
+struct Record {
+	float		x, y, z;
+	uint8_t		r, g, b, a;
+};
+
+uint8_t toByte( float v )
+{
+	return uint8_t( glm::clamp( v, 0.0f, 1.0f ) * 255.0f + 0.5f );
+}
+
+} // anonymous namespace
+
+ParticleRecorder::ParticleRecorder()
+: mFormat( FORMAT_PLY ), mRecording( false ), mStopping( false ), mWritten( 0 ), mDropped( 0 )
+{
+}
+
+ParticleRecorder::~ParticleRecorder()
+{
+	stop();
+}
+
+void ParticleRecorder::start( const fs::path &directory, Format format )
+{
+	stop();
+	
+	mDirectory = directory;
+	mFormat = format;
+	mWritten = 0;
+	mDropped = 0;
+	
+	try {
+		fs::create_directories( mDirectory );
+	}
+	catch( const std::exception &exc ) {
+		CI_LOG_E( "unable to create " << mDirectory.string() << ": " << exc.what() );
+		return;
+	}
+	
+	if( mFormat == FORMAT_BINARY ) {
+		mBinaryFile.open( ( mDirectory / "particles.bin" ).string().c_str(), ios::binary | ios::trunc );
+		if( ! mBinaryFile ) {
+			CI_LOG_E( "unable to open " << ( mDirectory / "particles.bin" ).string() );
+			return;
+		}
+		mBinaryFile.write( "TPF1", 4 );
+	}
+	
+	mStopping = false;
+	mRecording = true;
+	mWriter = thread( &ParticleRecorder::writerLoop, this );
+	CI_LOG_I( "recording particles to " << mDirectory.string() );
+}
+
+void ParticleRecorder::stop()
+{
+	if( ! mRecording )
+		return;
+	
+	{
+		lock_guard<mutex> lock( mMutex );
+		mStopping = true;
+	}
+	mCondition.notify_one();
+	mWriter.join();
+	
+	if( mBinaryFile.is_open() )
+		mBinaryFile.close();
+	mRecording = false;
+	CI_LOG_I( "recorded " << mWritten << " frames to " << mDirectory.string() << ", dropped " << mDropped );
+}
+
+bool ParticleRecorder::addFrame( uint32_t frame, const vector<Run> &runs, size_t stride, bool compact )
+{
+	if( ! mRecording )
+		return false;
+	
+	Job job;
+	{
+		lock_guard<mutex> lock( mMutex );
+		if( mJobs.size() >= MAX_QUEUED_FRAMES ) {
+			mDropped++;
+			return false;
+		}
+		if( ! mFreeBuffers.empty() ) {
+			job.raw.swap( mFreeBuffers.back() );
+			mFreeBuffers.pop_back();
+		}
+	}
+	
+	// COPY is all the main thread does, the data may be a mapped buffer that goes away after this
+	size_t bytes = 0;
+	for( auto iter = runs.begin(); iter != runs.end(); ++iter )
+		bytes += iter->count * stride;
+	job.raw.resize( bytes );
+	uint8_t *dst = job.raw.data();
+	for( auto iter = runs.begin(); iter != runs.end(); ++iter ) {
+		std::memcpy( dst, iter->data, iter->count * stride );
+		dst += iter->count * stride;
+		job.counts.push_back( iter->count );
+		job.translates.push_back( iter->translate );
+	}
+	job.frame = frame;
+	job.stride = stride;
+	job.compact = compact;
+	
+	{
+		lock_guard<mutex> lock( mMutex );
+		mJobs.push_back( std::move( job ) );
+	}
+	mCondition.notify_one();
+	return true;
+}
+
+void ParticleRecorder::writerLoop()
+{
+	while( true ) {
+		Job job;
+		{
+			unique_lock<mutex> lock( mMutex );
+			mCondition.wait( lock, [this] { return ! mJobs.empty() || mStopping; } );
+			// stopping still writes out whatever was queued
+			if( mJobs.empty() )
+				return;
+			job = std::move( mJobs.front() );
+			mJobs.pop_front();
+		}
+		
+		writeJob( job );
+		mWritten++;
+		
+		lock_guard<mutex> lock( mMutex );
+		mFreeBuffers.push_back( std::move( job.raw ) );
+	}
+}
+
+void ParticleRecorder::writeJob( const Job &job )
+{
+	// CONVERT either layout to records, both start with the position
+	size_t total = 0;
+	for( auto iter = job.counts.begin(); iter != job.counts.end(); ++iter )
+		total += *iter;
+	
+	vector<Record> records( total );
+	const uint8_t *src = job.raw.data();
+	Record *dst = records.data();
+	for( size_t run = 0; run < job.counts.size(); ++run ) {
+		const vec3 &translate = job.translates[run];
+		for( size_t i = 0; i < job.counts[run]; ++i, src += job.stride, ++dst ) {
+			vec3 pos = *reinterpret_cast<const vec3*>( src ) + translate;
+			dst->x = pos.x;
+			dst->y = pos.y;
+			dst->z = pos.z;
+			if( job.compact ) {
+				uint32_t color = reinterpret_cast<const CompactParticle*>( src )->color;
+				dst->r = uint8_t( color );
+				dst->g = uint8_t( color >> 8 );
+				dst->b = uint8_t( color >> 16 );
+				dst->a = uint8_t( color >> 24 );
+			}
+			else {
+				const ColorA &color = reinterpret_cast<const Particle*>( src )->color;
+				dst->r = toByte( color.r );
+				dst->g = toByte( color.g );
+				dst->b = toByte( color.b );
+				dst->a = toByte( color.a );
+			}
+		}
+	}
+	
+	if( mFormat == FORMAT_BINARY ) {
+		uint32_t header[2] = { job.frame, uint32_t( total ) };
+		mBinaryFile.write( reinterpret_cast<const char*>( header ), sizeof(header) );
+		mBinaryFile.write( reinterpret_cast<const char*>( records.data() ), records.size() * sizeof(Record) );
+		return;
+	}
+	
+	char name[32];
+	std::snprintf( name, sizeof(name), "frame_%06u.ply", job.frame );
+	ofstream out( ( mDirectory / name ).string().c_str(), ios::binary | ios::trunc );
+	if( ! out ) {
+		CI_LOG_E( "unable to write " << ( mDirectory / name ).string() );
+		return;
+	}
+	out << "ply\n"
+		<< "format binary_little_endian 1.0\n"
+		<< "element vertex " << total << "\n"
+		<< "property float x\nproperty float y\nproperty float z\n"
+		<< "property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n"
+		<< "end_header\n";
+	out.write( reinterpret_cast<const char*>( records.data() ), records.size() * sizeof(Record) );
+}
@@ -0,0 +1,164 @@
+//
+//  ParticleSolver.cpp
+//  TextParticles
+//
+
+#include "ParticleSolver.h"
+#include "ParticleParallel.h"
+#include "cinder/Log.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+// particles per worker, the update is only a few dozen flops each
+const size_t MIN_PARTICLES_PER_WORKER = 8192;
+
+} // anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
+// PerlinSampler
+// -------------------------------------------------------------------------------------------------
+PerlinSampler::PerlinSampler( const Surface8u &surface )
+: mSize( surface.getSize() ), mMask( surface.getSize() - ivec2( 1 ) )
+{
+	if( mSize.x <= 0 || mSize.y <= 0 || ( mSize.x & mMask.x ) != 0 || ( mSize.y & mMask.y ) != 0 ) {
+		CI_LOG_E( "perlin texture is " << mSize.x << "x" << mSize.y << ", the sampler needs power of two dimensions" );
+		return;
+	}
+	
+	for( int c = 0; c < 3; ++c )
+		mChannels[c].resize( mSize.x * mSize.y );
+	uint8_t inc = surface.getPixelInc();
+	uint8_t r = surface.getRedOffset(), g = surface.getGreenOffset(), b = surface.getBlueOffset();
+	for( int y = 0; y < mSize.y; ++y ) {
+		const uint8_t *pixel = surface.getData( ivec2( 0, y ) );
+		for( int x = 0; x < mSize.x; ++x, pixel += inc ) {
+			mChannels[0][y * mSize.x + x] = pixel[r] / 255.0f;
+			mChannels[1][y * mSize.x + x] = pixel[g] / 255.0f;
+			mChannels[2][y * mSize.x + x] = pixel[b] / 255.0f;
+		}
+	}
+}
+
+vec3 PerlinSampler::sample( const vec2 &uv ) const
+{
+	vec3 result;
+	sample( &uv, 1, &result.x, &result.y, &result.z );
+	return result;
+}
+
+void PerlinSampler::sample( const vec2 *uvs, size_t count, float *r, float *g, float *b ) const
+{
+	// FIND the four texels and the weights of every lookup. Texel centers sit at half texels, same as GL_LINEAR
+	int32_t i00[BATCH_SIZE], i10[BATCH_SIZE], i01[BATCH_SIZE], i11[BATCH_SIZE];
+	float fx[BATCH_SIZE], fy[BATCH_SIZE];
+	for( size_t i = 0; i < count; ++i ) {
+		float px = uvs[i].x * mSize.x - 0.5f, py = uvs[i].y * mSize.y - 0.5f;
+		float cx = std::floor( px ), cy = std::floor( py );
+		fx[i] = px - cx;
+		fy[i] = py - cy;
+		
+		// GL_REPEAT on both axes, the mask also wraps negative coordinates
+		int32_t x0 = int32_t( cx ) & mMask.x, y0 = int32_t( cy ) & mMask.y;
+		int32_t x1 = ( x0 + 1 ) & mMask.x, y1 = ( y0 + 1 ) & mMask.y;
+		i00[i] = y0 * mSize.x + x0;
+		i10[i] = y0 * mSize.x + x1;
+		i01[i] = y1 * mSize.x + x0;
+		i11[i] = y1 * mSize.x + x1;
+	}
+	
+	// GATHER and filter one channel at a time
+	float *out[3] = { r, g, b };
+	for( int c = 0; c < 3; ++c ) {
+		const float *texels = mChannels[c].data();
+		float t00[BATCH_SIZE], t10[BATCH_SIZE], t01[BATCH_SIZE], t11[BATCH_SIZE];
+		for( size_t i = 0; i < count; ++i ) {
+			t00[i] = texels[i00[i]];
+			t10[i] = texels[i10[i]];
+			t01[i] = texels[i01[i]];
+			t11[i] = texels[i11[i]];
+		}
+		
+		float *channel = out[c];
+		for( size_t i = 0; i < count; ++i ) {
+			float top = t00[i] + ( t10[i] - t00[i] ) * fx[i];
+			float bottom = t01[i] + ( t11[i] - t01[i] ) * fx[i];
+			channel[i] = top + ( bottom - top ) * fy[i];
+		}
+	}
+}
+
+// -------------------------------------------------------------------------------------------------
+// ParticleSolver
+// -------------------------------------------------------------------------------------------------
+void ParticleSolver::update( Particle *particles, size_t count, const Params &params ) const
+{
+	particleparallel::parallelFor( count, MIN_PARTICLES_PER_WORKER, [&]( size_t begin, size_t end ) {
+		updateRange( particles, begin, end, params );
+	});
+}
+
+void ParticleSolver::updateRange( Particle *particles, size_t begin, size_t end, const Params &params ) const
+{
+	// HOIST everything that is the same for every particle out of the loop
+	vec2 noiseScale = vec2( params.noiseOffset );
+	vec3 endColor = vec3( params.endColor.r, params.endColor.g, params.endColor.b );
+	vec3 colorRange = vec3( 1.0f ) - endColor;
+	bool hasPerlin = mPerlin.isValid();
+	
+	// BATCH the noise lookups, so the sampler filters whole arrays instead of one particle at a time
+	const size_t batchSize = PerlinSampler::BATCH_SIZE;
+	vec2 uvs[batchSize];
+	float noiseR[batchSize], noiseG[batchSize], noiseB[batchSize];
+	if( ! hasPerlin ) {
+		// 0.5 maps to no noise at all below
+		std::fill( noiseR, noiseR + batchSize, 0.5f );
+		std::fill( noiseG, noiseG + batchSize, 0.5f );
+		std::fill( noiseB, noiseB + batchSize, 0.5f );
+	}
+	
+	for( size_t batchBegin = begin; batchBegin < end; batchBegin += batchSize ) {
+		Particle *batch = particles + batchBegin;
+		size_t count = std::min( batchSize, end - batchBegin );
+		if( hasPerlin ) {
+			for( size_t i = 0; i < count; ++i )
+				uvs[i] = batch[i].texcoord * noiseScale;
+			mPerlin.sample( uvs, count, noiseR, noiseG, noiseB );
+		}
+		
+		for( size_t i = 0; i < count; ++i ) {
+			Particle &p = batch[i];
+			
+			vec3 vel = p.pos - p.ppos;
+			float len = length( vel );
+			// normalize() of a zero vector is undefined in GLSL, keep it still here instead of producing NaN
+			vec3 direction = ( len > 0.0f ) ? vel / len : vec3( 0.0f );
+			vec3 perlin = vec3( noiseR[i], noiseG[i], noiseB[i] ) * 2.0f - vec3( 1.0f );	// [-1.0,1.0]
+			vec3 acc = direction + ( perlin * p.invmass ) * params.step;
+			
+			// UPDATE damping
+			p.damping = std::max( p.damping - params.dampingSpeed, 0.0f );
+			
+			// UPDATE velocity
+			vel += acc;
+			vel *= p.damping;
+			
+			// UPDATE position and previous position
+			p.ppos = p.pos;
+			p.pos += vel;
+			
+			// UPDATE color
+			float a = glm::clamp( p.damping * 2.0f, 0.0f, 1.0f );
+			float colorVal = glm::clamp( a * 2.0f, 0.0f, 1.0f );
+			vec3 scale = endColor + colorRange * colorVal;
+			p.color.r *= scale.x;
+			p.color.g *= scale.y;
+			p.color.b *= scale.z;
+			p.color.a = a;
+		}
+	}
+}
@@ -0,0 +1,112 @@
+//
+//  ParticleSorter.cpp
+//  TextParticles
+//
+
+#include "ParticleSorter.h"
+#include "ParticleParallel.h"
+#include <cstring>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+// particles per chunk, below this a chunk's histogram costs more than it saves
+const size_t MIN_PARTICLES_PER_CHUNK = 32768;
+const size_t RADIX = 256;
+
+// Maps a float to an unsigned int with the same order, negatives included
+uint32_t floatToKey( float f )
+{
+	uint32_t u;
+	std::memcpy( &u, &f, sizeof(u) );
+	return ( u & 0x80000000 ) ? ~u : ( u | 0x80000000 );
+}
+
+} // anonymous namespace
+
+void ParticleSorter::sort( const void *data, size_t stride, size_t count, const mat4 &modelView, vector<uint32_t> *order )
+{
+	order->resize( count );
+	if( count == 0 )
+		return;
+	
+	mKeys.resize( count );
+	mKeysTmp.resize( count );
+	mOrderTmp.resize( count );
+	
+	// CHUNKS are fixed up front so the histogram and scatter passes of a digit see the same split
+	size_t chunkCount = std::max<size_t>( 1, std::min( particleparallel::getWorkerCount(), count / MIN_PARTICLES_PER_CHUNK ) );
+	size_t chunkSize = ( count + chunkCount - 1 ) / chunkCount;
+	mHistograms.assign( chunkCount * RADIX, 0 );
+	
+	// KEYS from view space z. The camera looks down -z, so ascending z is farthest first
+	vec4 depthRow = vec4( modelView[0][2], modelView[1][2], modelView[2][2], modelView[3][2] );
+	const uint8_t *bytes = static_cast<const uint8_t*>( data );
+	particleparallel::parallelFor( chunkCount, 1, [&]( size_t chunkBegin, size_t chunkEnd ) {
+		for( size_t c = chunkBegin; c < chunkEnd; ++c ) {
+			size_t end = std::min( ( c + 1 ) * chunkSize, count );
+			for( size_t i = c * chunkSize; i < end; ++i ) {
+				const vec3 &pos = *reinterpret_cast<const vec3*>( bytes + i * stride );
+				float z = depthRow.x * pos.x + depthRow.y * pos.y + depthRow.z * pos.z + depthRow.w;
+				mKeys[i] = floatToKey( z );
+				(*order)[i] = uint32_t( i );
+			}
+		}
+	});
+	
+	uint32_t *keys = mKeys.data(), *keysTmp = mKeysTmp.data();
+	uint32_t *values = order->data(), *valuesTmp = mOrderTmp.data();
+	for( uint32_t shift = 0; shift < 32; shift += 8 ) {
+		// COUNT the digits of every chunk
+		std::fill( mHistograms.begin(), mHistograms.end(), 0 );
+		particleparallel::parallelFor( chunkCount, 1, [&]( size_t chunkBegin, size_t chunkEnd ) {
+			for( size_t c = chunkBegin; c < chunkEnd; ++c ) {
+				uint32_t *histogram = &mHistograms[c * RADIX];
+				size_t end = std::min( ( c + 1 ) * chunkSize, count );
+				for( size_t i = c * chunkSize; i < end; ++i )
+					histogram[( keys[i] >> shift ) & 0xFF]++;
+			}
+		});
+		
+		// OFFSETS digit by digit, chunk by chunk, which keeps the sort stable. Nearby particles often share the
+		// high bytes of their depth, a digit that every key shares doesn't need a pass at all
+		uint32_t sum = 0;
+		bool skip = false;
+		for( size_t d = 0; d < RADIX; ++d ) {
+			uint32_t digitTotal = 0;
+			for( size_t c = 0; c < chunkCount; ++c ) {
+				uint32_t n = mHistograms[c * RADIX + d];
+				mHistograms[c * RADIX + d] = sum;
+				sum += n;
+				digitTotal += n;
+			}
+			if( digitTotal == count ) {
+				skip = true;
+				break;
+			}
+		}
+		if( skip )
+			continue;
+		
+		// SCATTER every chunk into its own slots
+		particleparallel::parallelFor( chunkCount, 1, [&]( size_t chunkBegin, size_t chunkEnd ) {
+			for( size_t c = chunkBegin; c < chunkEnd; ++c ) {
+				uint32_t *offsets = &mHistograms[c * RADIX];
+				size_t end = std::min( ( c + 1 ) * chunkSize, count );
+				for( size_t i = c * chunkSize; i < end; ++i ) {
+					uint32_t dst = offsets[( keys[i] >> shift ) & 0xFF]++;
+					keysTmp[dst] = keys[i];
+					valuesTmp[dst] = values[i];
+				}
+			}
+		});
+		std::swap( keys, keysTmp );
+		std::swap( values, valuesTmp );
+	}
+	
+	// an odd number of passes leaves the result in the scratch buffer
+	if( values != order->data() )
+		std::memcpy( order->data(), values, count * sizeof(uint32_t) );
+}
@@ -0,0 +1,111 @@
+//
+//  ParticleUploader.cpp
+//  TextParticles
+//
+
+#include "ParticleUploader.h"
+#include "cinder/Log.h"
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const size_t SLOT_COUNT = 2;
+
+} // anonymous namespace
+
+ParticleUploader::ParticleUploader()
+: mWriteIndex( 0 ), mMapped( false ), mOrphanCount( 0 )
+{
+}
+
+ParticleUploader::~ParticleUploader()
+{
+	clear();
+}
+
+uint8_t* ParticleUploader::begin( size_t bytes )
+{
+	mCopies.clear();
+	if( bytes == 0 )
+		return nullptr;
+
+	// STAGING buffers only ever grow, so a steady stream of batches doesn't allocate
+	Slot &slot = mSlots[mWriteIndex];
+	if( ! slot.buffer )
+		slot.buffer = gl::Vbo::create( GL_COPY_READ_BUFFER, bytes, nullptr, GL_STREAM_DRAW );
+	else
+		slot.buffer->ensureMinimumSize( bytes );
+
+	// REUSE the storage without any sync if the last copy out of it is done, otherwise let the driver hand
+	// out fresh storage rather than wait for it
+	GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+	if( slot.fence ) {
+		GLenum status = glClientWaitSync( slot.fence, 0, 0 );
+		if( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED ) {
+			access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+			mOrphanCount++;
+		}
+		glDeleteSync( slot.fence );
+		slot.fence = 0;
+	}
+
+	gl::ScopedBuffer buffer( slot.buffer );
+	uint8_t *data = static_cast<uint8_t*>( slot.buffer->mapBufferRange( 0, bytes, access ) );
+	if( ! data ) {
+		CI_LOG_W( "unable to map " << bytes << " bytes of staging" );
+		return nullptr;
+	}
+
+	mMapped = true;
+	return data;
+}
+
+void ParticleUploader::copy( size_t stagingOffset, const gl::VboRef &dest, size_t destOffset, size_t bytes )
+{
+	if( ! mMapped || bytes == 0 )
+		return;
+
+	Copy copy;
+	copy.stagingOffset = stagingOffset;
+	copy.dest = dest;
+	copy.destOffset = destOffset;
+	copy.bytes = bytes;
+	mCopies.push_back( copy );
+}
+
+void ParticleUploader::end()
+{
+	if( ! mMapped )
+		return;
+
+	Slot &slot = mSlots[mWriteIndex];
+	{
+		gl::ScopedBuffer buffer( slot.buffer );
+		slot.buffer->unmap();
+	}
+	mMapped = false;
+
+	// COPY on the GPU, in order after whatever still reads the destinations
+	gl::ScopedBuffer read( GL_COPY_READ_BUFFER, slot.buffer->getId() );
+	for( auto iter = mCopies.begin(); iter != mCopies.end(); ++iter ) {
+		gl::ScopedBuffer write( GL_COPY_WRITE_BUFFER, iter->dest->getId() );
+		glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, iter->stagingOffset, iter->destOffset, iter->bytes );
+	}
+	mCopies.clear();
+
+	slot.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	mWriteIndex = ( mWriteIndex + 1 ) % SLOT_COUNT;
+}
+
+void ParticleUploader::clear()
+{
+	for( size_t i = 0; i < SLOT_COUNT; ++i ) {
+		if( mSlots[i].fence ) {
+			glDeleteSync( mSlots[i].fence );
+			mSlots[i].fence = 0;
+		}
+	}
+	mCopies.clear();
+}
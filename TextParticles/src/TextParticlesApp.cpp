@@ -3,28 +3,38 @@
 #include "cinder/gl/gl.h"
 #include "cinder/Camera.h"
 #include "cinder/CameraUi.h"
+#include "cinder/ImageIo.h"
 #include "cinder/Log.h"
 #include "cinder/Rand.h"
-#include "cinder/Timeline.h"
+#include "cinder/Timer.h"
+#include "cinder/Utilities.h"
 #include "cinder/params/Params.h"
+#include "ImageEmitter.h"
+#include "ParticleEmitter.h"
+#include "CompactParticle.h"
+#include "ParticlePool.h"
+#include "ParticleReadback.h"
+#include "ParticleRecorder.h"
+#include "ParticleSorter.h"
+#include "ParticleSolver.h"
+#include "ParticleUploader.h"
+#include "TextRasterizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
 
 using namespace ci;
 using namespace ci::app;
 using namespace std;
 
-// -------------------------------------------------------------------------------------------------
-// Definition for each particle
-// -------------------------------------------------------------------------------------------------
-struct Particle
-{
-	vec3	pos;		// current position
-	vec3	ppos;		// previous position - velocity is determined as diff between pos and ppos
-	ColorA  color;
-	float	damping;	// velocity damping factor
-	vec2	texcoord;
-	float	invmass;	// arbitrary mass value for randomizing the physics a bit
-};
+namespace {
 
+// particles shared by every running explosion, the buffers are allocated once for this many
+const size_t POOL_CAPACITY = 1 << 20;
+
+} // anonymous namespace
 
 // -------------------------------------------------------------------------------------------------
 // Main app
@@ -37,34 +47,119 @@ class TextParticlesApp : public App {
 	void mouseDrag	( MouseEvent event ) override;
 	void mouseWheel	( MouseEvent event ) override;
 	void keyDown	( KeyEvent event ) override;
+	void fileDrop	( FileDropEvent event ) override;
 	void update() override;
 	void draw() override;
+	void cleanup() override;
 	
-	void drawTextToFbo();
+	void updateTextSurface();
 	void lookAtTexture( const CameraPersp &cam, const ci::vec2 &size );
+	ci::mat4 getTextureViewMatrix( const CameraPersp &cam, const ci::vec2 &size ) const;
+	void setupBuffers();
+	//! Describes the particle layout for OpenGL, the compact one when there are \a statics
+	gl::VaoRef createAttributes( const gl::VboRef &particles, const gl::VboRef &statics ) const;
 	void setupVBO();
+	void explode();
+	ParticleEmitter::Options getEmitOptions();
+	ParticlePool::Range* startExplosion( size_t count, const vec2 &size, float pointSize );
+	void uploadRange( const ParticlePool::Range &range, const vector<Particle> &particles,
+					  const vector<CompactParticle> *dynamic = nullptr, const vector<ParticleStatic> *statics = nullptr );
+	ImageEmitter::Settings getImageSettings( float sequenceFps );
+	void loadImage();
+	void loadSequence();
+	void playImageSource( const fs::path &path );
+	void updateImageSource();
+	float getStep( const ParticlePool::Range &range ) const;
+	ci::vec3 getLaunchCenter( const ParticlePool::Range &range ) const;
+	void reinitVelocity();
+	void readUpdateTime();
+	void updateGpu();
+	void updateCpu();
+	void checkSolver();
+	void benchmarkSolver();
+	void benchmarkLayouts();
+	void recordThroughput();
+	size_t getParticleBudget();
+	void updateDepthSort();
+	void sortRange( const ParticlePool::Range &range, const uint8_t *data, size_t stride, size_t count );
+	void benchmarkSort();
+	void toggleRecording();
+	void updateRecording();
 	void editMode();
+	void checkTextSurface();
 	
 	CameraPersp			mCam;
 	CameraUi			mCamUi;
 	
 	Font				mFont;
-	gl::TextureFontRef	mTextureFont;
-	string				mString;
-	gl::FboRef			mTextFbo;				// draws the text to this FBO
+	std::shared_ptr<TextRasterizer>	mTextRaster;	// composes the text surface on the CPU, glyph by glyph
+	u32string			mString;
+	gl::TextureRef		mTextTex;				// shows the text surface in edit mode
 	vec2				mTextSize;				// actual pixel size of text texture
-	int					mTextParticleCount;		// number of pixels in text texture
+	int					mTextParticleCount;		// number of visible pixels in text texture
+	ParticlePool		mPool;					// where each running explosion lives in the buffers
+	int					mLiveCount;				// particles that are still updated and drawn
+	int					mExplosionCount;		// explosions still running
+	float				mPointSize;				// spacing between sampled particles, so fewer of them still cover the text
 	
-	gl::GlslProgRef		mUpdateProg, mRenderProg;
+	gl::GlslProgRef		mUpdateProg, mUpdateCompactProg, mRenderProg;
+	gl::GlslProgRef		mReinitProg, mReinitCompactProg;	// relaunch running particles when Center or Start Velocity change
 	gl::TextureRef		mPerlin3dTex;
 	
-	bool				mActive;
-	ci::Surface8u		mTextSurf;
-	
 	// Descriptions of particle data layout.
 	gl::VaoRef			mAttributes[2];
 	// Buffers holding raw particle data on GPU.
 	gl::VboRef			mParticleBuffer[2];
+	// Texcoords, masses and emitted colors of the compact layout, only written when an explosion starts
+	gl::VboRef			mStaticBuffer;
+	bool				mCompactLayout;
+	
+	// GPU time of the update pass, read back a few frames late so it never stalls
+	GLuint				mUpdateQuery;
+	bool				mUpdateQueryPending;
+	float				mUpdateMs;
+	float				mParticlesPerSec;	// millions
+	float				mMbPerFrame;
+	
+	// CPU simulation, same physics as particleUpdate.vs
+	bool				mCpuUpdate;
+	ParticleSolver		mSolver;
+	vector<Particle>	mCpuParticles;		// the simulated state itself, laid out like the pool. Only its live ranges are uploaded
+	float				mSolverError;		// largest position difference from particleUpdate.vs, from checkSolver()
+	
+	// Every particle upload goes through staging, so it never waits on a draw still reading the buffers
+	ParticleUploader	mUploader;
+	
+	// Images and image sequences explode like the text, emitted on worker threads
+	ImageEmitter		mImageEmitter;
+	float				mSequenceFps;
+	int					mSourceFramesSkipped;
+	float				mEmitMs;
+	
+	// Back to front order of each explosion, refreshed every few frames. In between the last order is
+	// drawn again, particles move little from one frame to the next
+	struct SortedRange {
+		uint64_t	rangeId;	// ParticlePool::Range it was sorted for
+		size_t		count;		// live particles at the time, the ones that died since are invisible
+	};
+	bool				mDepthSort;
+	int					mSortInterval;		// frames between sorts
+	int					mFramesSinceSort;
+	float				mSortMs;
+	ParticleSorter		mSorter;
+	ParticleReadback	mSortReadback;		// positions for the sort when they live on the GPU
+	gl::VboRef			mSortIndices;		// sorted indices, laid out like the pool
+	vector<SortedRange>	mSortedRanges;
+	vector<uint32_t>	mSortOrder;
+	
+	// Particle frames streamed to disk for offline rendering
+	bool				mRecording;
+	int					mRecordFormat;		// ParticleRecorder::Format
+	int					mFramesRecorded, mFramesDropped;
+	int					mReadbacksSkipped;	// frames both staging buffers were still busy
+	ParticleRecorder	mRecorder;
+	ParticleReadback	mRecordReadback;
+	deque<vector<vec3>>	mRecordTranslates;	// per request in flight, where each explosion's particles go
 
 	// Current source and destination buffers for transform feedback.
 	// Source and destination are swapped each frame after update.
@@ -80,8 +175,13 @@ class TextParticlesApp : public App {
 	float					mDampingBase;		// base at which to determine start damping value
 	vec3					mNoiseOffset;		// scales the texture coordinates to determine perlin input in the shader
 	Color					mEndColor;			// color that the particles fade to as they die
-	
-	ci::Anim<float>			mStep;				// current step value, as animated on each explosion
+	int						mAlphaThreshold;	// pixels at or below this alpha don't emit particles
+	int						mSampling;			// ParticleEmitter::Sampling once the text is over budget
+	int						mParticleBudget;	// most particles an explosion emits, 0 for every visible pixel
+	bool					mAutoBudget;		// derive the budget from the measured update rate instead
+	float					mTargetUpdateMs;	// update time the automatic budget aims for
+	float					mBestParticlesPerSec;	// millions, fastest update seen on the current path
+	int						mThroughputPath;	// which update path mBestParticlesPerSec was measured on
 };
 
 
@@ -92,11 +192,12 @@ void TextParticlesApp::setup()
 	mCamUi = CameraUi( &mCam );
 	
 	// LOAD fonts
-	mFont = Font( loadAsset( "SourceSansPro-Bold.ttf" ), 120 );
-	mTextureFont = gl::TextureFont::create( mFont );
+	DataSourceRef fontData = loadAsset( "SourceSansPro-Bold.ttf" );
+	mFont = Font( fontData, 120 );
 	
-	// DEFINE FBO
-	mTextFbo = gl::Fbo::create( getWindowWidth(), getWindowHeight(), true );
+	// DEFINE the text surface, the same size as the window. Glyphs from earlier runs come from the cache
+	fs::path glyphCache = GlyphAtlas::getCacheFile( getDocumentsDirectory() / "TextParticlesGlyphCache", fontData, mFont );
+	mTextRaster = make_shared<TextRasterizer>( mFont, getWindowSize(), glyphCache );
 	
 	// LOAD shaders
 	mRenderProg = gl::getStockShader( gl::ShaderDef().color() );
@@ -120,8 +221,63 @@ void TextParticlesApp::setup()
 		std::cout << exc.what();
 	}
 	
+	// the compact layout only captures what the update changes
+	try {
+		mUpdateCompactProg = gl::GlslProg::create( gl::GlslProg::Format().vertex( loadAsset( "shaders/particleUpdateCompact.vs" ) )
+			.feedbackFormat( GL_INTERLEAVED_ATTRIBS )
+			.feedbackVaryings( { "position", "pposition", "damping", "packedColor" } )
+			.attribLocation( "iPosition", 0 )
+			.attribLocation( "iPPosition", 2 )
+			.attribLocation( "iDamping", 3 )
+			.attribLocation( "iTexCoord", 4 )
+			.attribLocation( "iInvMass", 5 )
+			.attribLocation( "iBaseColor", 6 )
+		);
+	}catch( ci::gl::GlslProgCompileExc &exc ) {
+		std::cout << "Shader compile error: " << endl;
+		std::cout << exc.what();
+	}
+	catch( Exception &exc ) {
+		std::cout << "Unable to load shader" << endl;
+		std::cout << exc.what();
+	}
+	
+	// relaunching only rewrites the previous positions, with the same outputs as the updates
+	try {
+		mReinitProg = gl::GlslProg::create( gl::GlslProg::Format().vertex( loadAsset( "shaders/particleReinit.vs" ) )
+			.feedbackFormat( GL_INTERLEAVED_ATTRIBS )
+			.feedbackVaryings( { "position", "pposition", "color", "damping", "texcoord", "invmass" } )
+			.attribLocation( "iPosition", 0 )
+			.attribLocation( "iColor", 1 )
+			.attribLocation( "iPPosition", 2 )
+			.attribLocation( "iDamping", 3 )
+			.attribLocation( "iTexCoord", 4 )
+			.attribLocation( "iInvMass", 5 )
+		);
+		mReinitCompactProg = gl::GlslProg::create( gl::GlslProg::Format().vertex( loadAsset( "shaders/particleReinitCompact.vs" ) )
+			.feedbackFormat( GL_INTERLEAVED_ATTRIBS )
+			.feedbackVaryings( { "position", "pposition", "damping", "packedColor" } )
+			.attribLocation( "iPosition", 0 )
+			.attribLocation( "iColor", 1 )
+			.attribLocation( "iPPosition", 2 )
+			.attribLocation( "iDamping", 3 )
+		);
+	}catch( ci::gl::GlslProgCompileExc &exc ) {
+		std::cout << "Shader compile error: " << endl;
+		std::cout << exc.what();
+	}
+	catch( Exception &exc ) {
+		std::cout << "Unable to load shader" << endl;
+		std::cout << exc.what();
+	}
+	glGenQueries( 1, &mUpdateQuery );
+	mUpdateQueryPending = false;
+	mUpdateMs = mParticlesPerSec = mMbPerFrame = 0.0f;
+	
 	// LOAD perlin texture to use in the shaders
-	mPerlin3dTex = gl::Texture::create( loadImage( loadAsset( "shaders/perlin3d.png" ) ) );
+	Surface8u perlinSurf( loadImage( loadAsset( "shaders/perlin3d.png" ) ) );
+	mPerlin3dTex = gl::Texture::create( perlinSurf );
+	mSolver.setPerlin( PerlinSampler( perlinSurf ) );
 	mPerlin3dTex->setWrap( GL_REPEAT, GL_REPEAT );
 	
 	// SET UP param defaults
@@ -132,21 +288,163 @@ void TextParticlesApp::setup()
 	mDampingBase	= 0.45f;
 	mNoiseOffset	= vec3( 1.0f, 1.0f, 0.0 );
 	mEndColor		= Color( 1.0, 1.0, 1.0 );
+	mAlphaThreshold	= 0;
+	mCompactLayout	= true;
+	mCpuUpdate		= false;
+	mSolverError	= 0.0f;
+	mSampling		= ParticleEmitter::SAMPLING_BLUE_NOISE;
+	mParticleBudget	= 0;
+	mAutoBudget		= false;
+	mTargetUpdateMs	= 2.0f;
+	mBestParticlesPerSec = 0.0f;
+	mThroughputPath	= -1;
+	mDepthSort		= false;
+	mSortInterval	= 4;
+	mFramesSinceSort = 0;
+	mSortMs			= 0.0f;
+	mRecording		= false;
+	mRecordFormat	= ParticleRecorder::FORMAT_PLY;
+	mFramesRecorded = mFramesDropped = mReadbacksSkipped = 0;
+	mSequenceFps	= 30.0f;
+	mSourceFramesSkipped = 0;
+	mEmitMs			= 0.0f;
 	
 	// SET UP params
 	mParams = params::InterfaceGl::create( app::getWindow(), "Params", vec2( 400, 350 ) );
-	mParams->addParam( "Center", &mCenter ).updateFn( bind( &TextParticlesApp::setupVBO, this ) );
-	mParams->addParam( "Start Velocity", &mStartVelocity ).updateFn( bind( &TextParticlesApp::setupVBO, this ) );
+	mParams->addParam( "Center", &mCenter ).updateFn( bind( &TextParticlesApp::reinitVelocity, this ) );
+	mParams->addParam( "Start Velocity", &mStartVelocity ).updateFn( bind( &TextParticlesApp::reinitVelocity, this ) );
 	mParams->addParam( "Step Max", &mStepMax );
 	mParams->addParam( "Damping Speed", &mDampingSpeed ).precision( 4 ).step( 0.0005 ).min( 0.0 ).max( 0.04 );
 	mParams->addParam( "Damping Base", &mDampingBase ).precision( 2 ).step( 0.05 ).min( 0.0 ).max( 1.0 );
 	mParams->addParam( "Noise Offset", &mNoiseOffset );
 	mParams->addParam( "EndColor", &mEndColor );
+	mParams->addParam( "Alpha Threshold", &mAlphaThreshold ).min( 0 ).max( 254 );
+	mParams->addParam( "Compact Layout", &mCompactLayout ).updateFn( bind( &TextParticlesApp::setupBuffers, this ) );
+	mParams->addParam( "CPU Update", &mCpuUpdate ).updateFn( bind( &TextParticlesApp::setupBuffers, this ) );
+	mParams->addButton( "Check CPU Solver", bind( &TextParticlesApp::checkSolver, this ) );
+	mParams->addParam( "Solver Max Error", &mSolverError, true );
+	mParams->addButton( "Benchmark CPU Solver", bind( &TextParticlesApp::benchmarkSolver, this ) );
+	mParams->addButton( "Benchmark Layouts", bind( &TextParticlesApp::benchmarkLayouts, this ) );
+	mParams->addParam( "Sampling", { "Stride", "Blue Noise" }, &mSampling );
+	mParams->addParam( "Particle Budget", &mParticleBudget ).min( 0 ).step( 10000 );
+	mParams->addParam( "Auto Budget", &mAutoBudget );
+	mParams->addParam( "Target Update ms", &mTargetUpdateMs ).precision( 2 ).step( 0.25f ).min( 0.25f );
+	mParams->addParam( "Point Size", &mPointSize, true );
+	mParams->addParam( "Depth Sort", &mDepthSort );
+	mParams->addParam( "Sort Every N Frames", &mSortInterval ).min( 1 ).max( 60 );
+	mParams->addParam( "Sort ms", &mSortMs, true );
+	mParams->addButton( "Benchmark Sort", bind( &TextParticlesApp::benchmarkSort, this ) );
+	mParams->addParam( "Record Format", { "PLY", "Binary" }, &mRecordFormat );
+	mParams->addParam( "Record", &mRecording ).updateFn( bind( &TextParticlesApp::toggleRecording, this ) );
+	mParams->addParam( "Frames Recorded", &mFramesRecorded, true );
+	mParams->addParam( "Frames Dropped", &mFramesDropped, true );
+	mParams->addParam( "Sequence fps", &mSequenceFps ).precision( 0 ).step( 5.0f ).min( 1.0f ).max( 60.0f );
+	mParams->addButton( "Load Image", bind( &TextParticlesApp::loadImage, this ) );
+	mParams->addButton( "Load Sequence", bind( &TextParticlesApp::loadSequence, this ) );
+	mParams->addButton( "Stop Image Source", bind( &ImageEmitter::stop, &mImageEmitter ) );
+	mParams->addParam( "Source Frames Skipped", &mSourceFramesSkipped, true );
+	mParams->addParam( "Emit ms", &mEmitMs, true );
+	mParams->addParam( "Particles", &mTextParticleCount, true );
+	mParams->addParam( "Live Particles", &mLiveCount, true );
+	mParams->addParam( "Explosions", &mExplosionCount, true );
+	mParams->addParam( "MB / Frame", &mMbPerFrame, true );
+	mParams->addParam( "Update ms", &mUpdateMs, true );
+	mParams->addParam( "M Particles / sec", &mParticlesPerSec, true );
 	mParams->addButton( "Enter Edit Mode", bind( &TextParticlesApp::editMode, this ) );
-	mParams->addButton( "EXPLODE!", bind( &TextParticlesApp::setupVBO, this ) );
+	mParams->addButton( "EXPLODE!", bind( &TextParticlesApp::explode, this ) );
+	
+	mTextParticleCount = 0;
+	mPointSize = 1.0f;
+	setupBuffers();
+}
+
+
+void TextParticlesApp::setupBuffers()
+{
+	// every running explosion lives in the buffers that are about to be replaced
+	mPool.reset( POOL_CAPACITY );
+	mLiveCount = 0;
+	mExplosionCount = 0;
+	mMbPerFrame = 0.0f;
+	mSortedRanges.clear();
+	mSortReadback.clear();
+	mRecordReadback.clear();
+	mRecordTranslates.clear();
+	mUploader.clear();
+	mSortIndices = gl::Vbo::create( GL_ELEMENT_ARRAY_BUFFER, POOL_CAPACITY * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW );
+	
+	// the CPU path simulates the full particles here, the GPU buffers only get what's drawn. The compact
+	// layout drops texcoord and invmass from the dynamic stream, so they can't be the state
+	if( mCpuUpdate )
+		mCpuParticles.assign( POOL_CAPACITY, Particle() );
+	else
+		vector<Particle>().swap( mCpuParticles );
+	
+	if( mCompactLayout ) {
+		mParticleBuffer[mSourceIndex] = gl::Vbo::create( GL_ARRAY_BUFFER, POOL_CAPACITY * sizeof(CompactParticle), nullptr, GL_DYNAMIC_DRAW );
+		mParticleBuffer[mDestinationIndex] = gl::Vbo::create( GL_ARRAY_BUFFER, POOL_CAPACITY * sizeof(CompactParticle), nullptr, GL_DYNAMIC_DRAW );
+		mStaticBuffer = gl::Vbo::create( GL_ARRAY_BUFFER, POOL_CAPACITY * sizeof(ParticleStatic), nullptr, GL_DYNAMIC_DRAW );
+		
+		for( int i = 0; i < 2; ++i )
+			mAttributes[i] = createAttributes( mParticleBuffer[i], mStaticBuffer );
+		return;
+	}
+	
+	// Create particle buffers on GPU big enough for the whole pool.
+	// Explosions are written into their own range as they start.
+	mParticleBuffer[mSourceIndex] = gl::Vbo::create( GL_ARRAY_BUFFER, POOL_CAPACITY * sizeof(Particle), nullptr, GL_DYNAMIC_DRAW );
+	mParticleBuffer[mDestinationIndex] = gl::Vbo::create( GL_ARRAY_BUFFER, POOL_CAPACITY * sizeof(Particle), nullptr, GL_DYNAMIC_DRAW );
+	mStaticBuffer.reset();
+	
+	for( int i = 0; i < 2; ++i )
+		mAttributes[i] = createAttributes( mParticleBuffer[i], nullptr );
+}
+
+
+gl::VaoRef TextParticlesApp::createAttributes( const gl::VboRef &particles, const gl::VboRef &statics ) const
+{
+	gl::VaoRef attributes = gl::Vao::create();
+	gl::ScopedVao vao( attributes );
+	if( statics ) {
+		// Same attribute locations as the full layout, from two streams
+		{
+			gl::ScopedBuffer buffer( particles );
+			gl::enableVertexAttribArray( 0 );
+			gl::enableVertexAttribArray( 1 );
+			gl::enableVertexAttribArray( 2 );
+			gl::enableVertexAttribArray( 3 );
+			gl::vertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof(CompactParticle), (const GLvoid*)offsetof(CompactParticle, pos ) );
+			gl::vertexAttribPointer( 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactParticle), (const GLvoid*)offsetof(CompactParticle, color ) );
+			gl::vertexAttribPointer( 2, 3, GL_FLOAT, GL_FALSE, sizeof(CompactParticle), (const GLvoid*)offsetof(CompactParticle, ppos ) );
+			gl::vertexAttribPointer( 3, 1, GL_FLOAT, GL_FALSE, sizeof(CompactParticle), (const GLvoid*)offsetof(CompactParticle, damping ) );
+		}
+		{
+			gl::ScopedBuffer buffer( statics );
+			gl::enableVertexAttribArray( 4 );
+			gl::enableVertexAttribArray( 5 );
+			gl::enableVertexAttribArray( 6 );
+			gl::vertexAttribPointer( 4, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(ParticleStatic), (const GLvoid*)offsetof(ParticleStatic, texcoord ) );
+			gl::vertexAttribPointer( 5, 1, GL_HALF_FLOAT, GL_FALSE, sizeof(ParticleStatic), (const GLvoid*)offsetof(ParticleStatic, invmass ) );
+			gl::vertexAttribPointer( 6, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ParticleStatic), (const GLvoid*)offsetof(ParticleStatic, color ) );
+		}
+		return attributes;
+	}
 	
-	mStep = 1.0;
-	mActive = false;
+	// Define attributes as offsets into the bound particle buffer
+	gl::ScopedBuffer buffer( particles );
+	gl::enableVertexAttribArray( 0 );
+	gl::enableVertexAttribArray( 1 );
+	gl::enableVertexAttribArray( 2 );
+	gl::enableVertexAttribArray( 3 );
+	gl::enableVertexAttribArray( 4 );
+	gl::enableVertexAttribArray( 5 );
+	gl::vertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, pos ) );
+	gl::vertexAttribPointer( 1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, color ) );
+	gl::vertexAttribPointer( 2, 3, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, ppos ) );
+	gl::vertexAttribPointer( 3, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, damping ) );
+	gl::vertexAttribPointer( 4, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, texcoord ) );
+	gl::vertexAttribPointer( 5, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, invmass ) );
+	return attributes;
 }
 
 
@@ -155,68 +453,264 @@ void TextParticlesApp::setupVBO()
 	if( mString.length() == 0 )
 		return;
 	
-	// amount of pixels in the biffer is dependent on the text area
-	int w = mTextSize.x, h = mTextSize.y;
-	int totalParticles = w * h;
-	mTextParticleCount = totalParticles;
-	
-	// INITIALIZE the particles
+	// EMIT a particle for each visible pixel of the text area only, the rest of the box stays empty
 	vector<Particle> particles;
-	particles.assign( totalParticles, Particle() );
-	
-	// CENTER of the text texture
-	vec3 center = vec3(mTextSize.x/2.0f, mTextSize.y/2.0f, 0 ) + mCenter;
-	for( int i = 0; i < particles.size(); ++i )
-	{	// assign starting values to particles.
-		int x = i % w;
-		int y = floor( float(i) / float(w) );
-		int z = 1.0;
-		
-		vec3 pos	   = vec3( x, y, z );
-		vec3 dir	   = normalize( pos - center );
-		vec3 offsetVel = ( dir * vec3( mStartVelocity ) );
-		ColorA color   = mTextSurf.getPixel( ivec2( x, y ) );
+	mPointSize = ParticleEmitter::emit( mTextRaster->getSurface(), ivec2( mTextSize ), getEmitOptions(), &particles );
+	mTextParticleCount = particles.size();
+	if( mTextParticleCount == 0 )
+		return;
+	
+	// ORDER the particles so the ones that die first are at the back of the range
+	ParticlePool::Range *range = startExplosion( particles.size(), mTextSize, mPointSize );
+	range->lifecycle.setup( &particles );
+	uploadRange( *range, particles );
+}
+
+
+ParticleEmitter::Options TextParticlesApp::getEmitOptions()
+{
+	// never emit more than the pool holds
+	size_t budget = getParticleBudget();
+	budget = ( budget > 0 ) ? std::min( budget, mPool.getCapacity() ) : mPool.getCapacity();
+	
+	return ParticleEmitter::Options()
+		.alphaThreshold( mAlphaThreshold )
+		.center( mCenter )
+		.startVelocity( mStartVelocity )
+		.dampingBase( mDampingBase )
+		.seed( Rand::randUint() )
+		.maxParticles( budget )
+		.sampling( ParticleEmitter::Sampling( mSampling ) );
+}
+
+
+ParticlePool::Range* TextParticlesApp::startExplosion( size_t count, const vec2 &size, float pointSize )
+{
+	// CLAIM a range of the pool, pushing out the oldest explosions if it's full
+	ParticlePool::Range *range = mPool.allocate( count );
+	range->startTime = getElapsedSeconds();
+	range->textSize = size;
+	range->pointSize = pointSize;
+	return range;
+}
+
+
+void TextParticlesApp::explode()
+{
+	setupVBO();
+	
+	// START the next word, the explosion keeps running while it's typed
+	mString.clear();
+	mTextRaster->clear();
+	updateTextSurface();
+}
+
+
+void TextParticlesApp::uploadRange( const ParticlePool::Range &range, const vector<Particle> &particles,
+									 const vector<CompactParticle> *dynamic, const vector<ParticleStatic> *statics )
+{
+	// WRITE only this explosion's range, the running ones in the rest of the buffer are left alone
+	if( mCpuUpdate )
+		std::copy( particles.begin(), particles.end(), mCpuParticles.begin() + range.offset );
+	
+	size_t count = particles.size();
+	if( mCompactLayout ) {
+		// image frames come packed already, the text is packed here
+		vector<CompactParticle> packedDynamic;
+		vector<ParticleStatic> packedStatics;
+		if( ! dynamic || ! statics || dynamic->size() != count || statics->size() != count ) {
+			packParticles( particles, &packedDynamic, &packedStatics );
+			dynamic = &packedDynamic;
+			statics = &packedStatics;
+		}
 		
-		auto &p = particles.at( i );
-		p.pos      = pos;
-		p.texcoord = vec2( float(x) / float(w), float(y) / float(h) );
-		p.ppos	   = p.pos - offsetVel;
-		p.damping  = Rand::randFloat( mDampingBase, mDampingBase + 0.2f );
-		p.color    = ColorA( Color(color), color.a );
-		p.invmass  = Rand::randFloat( 0.1f, 1.0f );
+		size_t dynamicBytes = count * sizeof(CompactParticle), staticBytes = count * sizeof(ParticleStatic);
+		uint8_t *staging = mUploader.begin( dynamicBytes + staticBytes );
+		if( staging ) {
+			std::memcpy( staging, dynamic->data(), dynamicBytes );
+			std::memcpy( staging + dynamicBytes, statics->data(), staticBytes );
+			mUploader.copy( 0, mParticleBuffer[mSourceIndex], range.offset * sizeof(CompactParticle), dynamicBytes );
+			mUploader.copy( dynamicBytes, mStaticBuffer, range.offset * sizeof(ParticleStatic), staticBytes );
+			mUploader.end();
+		}
+	}
+	else {
+		size_t bytes = count * sizeof(Particle);
+		uint8_t *staging = mUploader.begin( bytes );
+		if( staging ) {
+			std::memcpy( staging, particles.data(), bytes );
+			mUploader.copy( 0, mParticleBuffer[mSourceIndex], range.offset * sizeof(Particle), bytes );
+			mUploader.end();
+		}
 	}
 	
-	// Create particle buffers on GPU and copy data into the first buffer.
-	// Mark as static since we only write from the CPU once.
-	mParticleBuffer[mSourceIndex] = gl::Vbo::create( GL_ARRAY_BUFFER, particles.size() * sizeof(Particle), particles.data(), GL_STATIC_DRAW );
-	mParticleBuffer[mDestinationIndex] = gl::Vbo::create( GL_ARRAY_BUFFER, particles.size() * sizeof(Particle), nullptr, GL_STATIC_DRAW );
+	mLiveCount = mPool.getLiveCount();
+	mExplosionCount = mPool.getRanges().size();
+}
+
+
+ImageEmitter::Settings TextParticlesApp::getImageSettings( float sequenceFps )
+{
+	ImageEmitter::Settings settings;
+	settings.options = getEmitOptions();
+	settings.compact = mCompactLayout;
 	
-	for( int i = 0; i < 2; ++i )
-	{	// Describe the particle layout for OpenGL.
-		mAttributes[i] = gl::Vao::create();
-		gl::ScopedVao vao( mAttributes[i] );
-		
-		// Define attributes as offsets into the bound particle buffer
-		gl::ScopedBuffer buffer( mParticleBuffer[i] );
-		gl::enableVertexAttribArray( 0 );
-		gl::enableVertexAttribArray( 1 );
-		gl::enableVertexAttribArray( 2 );
-		gl::enableVertexAttribArray( 3 );
-		gl::enableVertexAttribArray( 4 );
-		gl::enableVertexAttribArray( 5 );
-		gl::vertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, pos ) );
-		gl::vertexAttribPointer( 1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, color ) );
-		gl::vertexAttribPointer( 2, 3, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, ppos ) );
-		gl::vertexAttribPointer( 3, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, damping ) );
-		gl::vertexAttribPointer( 4, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, texcoord ) );
-		gl::vertexAttribPointer( 5, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (const GLvoid*)offsetof(Particle, invmass ) );
+	// SHARE the pool between the frames of a sequence that are exploding at once, otherwise each one claims all of
+	// it and pushes the previous frame out a frame of the sequence later. Nothing dies without damping speed, the
+	// oldest frames get pushed out whatever the budget
+	if( sequenceFps > 0.0f && mDampingSpeed > 0.0f ) {
+		float lifetime = ( mDampingBase + 0.2f ) / mDampingSpeed / std::max( getFrameRate(), 1.0f );
+		size_t framesAlive = size_t( glm::clamp( ceil( lifetime * sequenceFps ), 1.0f, float( mPool.getCapacity() ) ) );
+		settings.options.maxParticles( std::min( settings.options.getMaxParticles(), mPool.getCapacity() / framesAlive ) );
 	}
+	return settings;
+}
+
+
+void TextParticlesApp::loadImage()
+{
+	fs::path path = getOpenFilePath( fs::path(), ImageIo::getLoadExtensions() );
+	if( ! path.empty() )
+		playImageSource( path );
+}
+
+
+void TextParticlesApp::loadSequence()
+{
+	fs::path path = getFolderPath();
+	if( ! path.empty() )
+		playImageSource( path );
+}
+
+
+void TextParticlesApp::playImageSource( const fs::path &path )
+{
+	// a folder plays as a sequence, a single image explodes once
+	bool sequence = fs::is_directory( path );
+	mImageEmitter.setSettings( getImageSettings( sequence ? mSequenceFps : 0.0f ) );
+	if( sequence )
+		mImageEmitter.loadSequence( path, mSequenceFps );
+	else
+		mImageEmitter.loadImage( path );
+}
+
+
+void TextParticlesApp::updateImageSource()
+{
+	if( ! mImageEmitter.isActive() )
+		return;
+	
+	// frames the workers haven't started yet pick up the current params
+	mImageEmitter.setSettings( getImageSettings( mImageEmitter.getFps() ) );
+	
+	ImageEmitter::Frame frame;
+	bool ready = mImageEmitter.poll( getElapsedSeconds(), &frame );
+	mSourceFramesSkipped = int( mImageEmitter.getSkippedCount() );
+	mEmitMs = mImageEmitter.getEmitMs();
+	if( ! ready )
+		return;
+	
+	// EXPLODE it like the text, the worker already emitted, ordered and packed it
+	ParticlePool::Range *range = startExplosion( frame.particles.size(), vec2( frame.size ), frame.pointSize );
+	range->lifecycle = frame.lifecycle;
+	mTextParticleCount = frame.particles.size();
+	mPointSize = frame.pointSize;
+	uploadRange( *range, frame.particles, &frame.dynamic, &frame.statics );
+}
+
+
+float TextParticlesApp::getStep( const ParticlePool::Range &range ) const
+{
+	// ANIMATE the step from 1 up to the max over the first second of each explosion
+	float t = glm::clamp( float( getElapsedSeconds() - range.startTime ), 0.0f, 1.0f );
+	return 1.0f + ( mStepMax - 1.0f ) * t;
+}
+
+
+size_t TextParticlesApp::getParticleBudget()
+{
+	// throughput measured on another path says nothing about this one
+	int path = ( mCpuUpdate ? 2 : 0 ) + ( mCompactLayout ? 1 : 0 );
+	if( path != mThroughputPath ) {
+		mBestParticlesPerSec = 0.0f;
+		mThroughputPath = path;
+	}
+	
+	// until an update has been timed there is nothing to base the budget on
+	if( ! mAutoBudget || mBestParticlesPerSec <= 0.0f )
+		return size_t( mParticleBudget );
+	
+	mParticleBudget = int( mBestParticlesPerSec * 1.0e3f * mTargetUpdateMs );
+	return size_t( mParticleBudget );
+}
+
+
+void TextParticlesApp::recordThroughput()
+{
+	// the fastest rate seen is the least skewed by fixed per-frame overhead
+	mBestParticlesPerSec = std::max( mBestParticlesPerSec, mParticlesPerSec );
+}
+
+
+vec3 TextParticlesApp::getLaunchCenter( const ParticlePool::Range &range ) const
+{
+	// same center ParticleEmitter launched the range from
+	return vec3( range.textSize / 2.0f, 0 ) + mCenter;
+}
+
+
+void TextParticlesApp::reinitVelocity()
+{
+	// RELAUNCH the running explosions in place, nothing is emitted or reallocated
+	if( mPool.empty() )
+		return;
 	
-	// ANIMATE mStep
-	timeline().apply( &mStep, 1.0f, mStepMax, 1.0f );
+	const auto &ranges = mPool.getRanges();
+	if( mCpuUpdate ) {
+		// the next update uploads the live ranges anyway
+		for( auto iter = ranges.begin(); iter != ranges.end(); ++iter )
+			ParticleEmitter::launch( mCpuParticles.data() + iter->offset, iter->lifecycle.getLiveCount(), getLaunchCenter( *iter ), mStartVelocity );
+		return;
+	}
+	
+	gl::GlslProgRef reinitProg = mCompactLayout ? mReinitCompactProg : mReinitProg;
+	gl::ScopedGlslProg prog( reinitProg );
+	gl::ScopedState rasterizer( GL_RASTERIZER_DISCARD, true );
+	reinitProg->uniform( "uStartVelocity", mStartVelocity );
+	
+	// same per range passes as updateGpu(), into the destination and swapped
+	gl::ScopedVao source( mAttributes[mSourceIndex] );
+	size_t stride = mCompactLayout ? sizeof(CompactParticle) : sizeof(Particle);
+	for( auto iter = ranges.begin(); iter != ranges.end(); ++iter ) {
+		size_t live = iter->lifecycle.getLiveCount();
+		reinitProg->uniform( "uCenter", getLaunchCenter( *iter ) );
+		gl::bindBufferRange( GL_TRANSFORM_FEEDBACK_BUFFER, 0, mParticleBuffer[mDestinationIndex], iter->offset * stride, live * stride );
+		gl::beginTransformFeedback( GL_POINTS );
+		gl::drawArrays( GL_POINTS, iter->offset, live );
+		gl::endTransformFeedback();
+	}
 	
-	// As long as we're active, we'll draw the particles
-	mActive = true;
+	std::swap( mSourceIndex, mDestinationIndex );
+}
+
+
+void TextParticlesApp::readUpdateTime()
+{
+	// PICK UP the last timing once it's available, instead of waiting for it
+	if( ! mUpdateQueryPending )
+		return;
+	
+	GLuint available = 0;
+	glGetQueryObjectuiv( mUpdateQuery, GL_QUERY_RESULT_AVAILABLE, &available );
+	if( ! available )
+		return;
+	
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v( mUpdateQuery, GL_QUERY_RESULT, &elapsed );
+	mUpdateMs = elapsed / 1.0e6f;
+	mParticlesPerSec = ( elapsed > 0 ) ? mLiveCount / ( elapsed / 1.0e3f ) : 0.0f;
+	mUpdateQueryPending = false;
+	recordThroughput();
 }
 
 
@@ -247,9 +741,65 @@ void TextParticlesApp::mouseDrag( MouseEvent event )
 }
 
 
+void TextParticlesApp::fileDrop( FileDropEvent event )
+{
+	playImageSource( event.getFile( 0 ) );
+}
+
+
 void TextParticlesApp::editMode()
 {
-	mActive = false;
+	// STOP every running explosion, typing alone no longer does
+	mImageEmitter.stop();
+	mPool.clear();
+	mLiveCount = 0;
+	mExplosionCount = 0;
+}
+
+
+void TextParticlesApp::checkTextSurface()
+{
+	// WAIT for the glyphs the edits below use, so every one of them is laid out and not just queued
+	const u32string letters = U"abcdefghijklmnopqrstuvwxyzAVWTfij.,' ";
+	GlyphAtlas &atlas = mTextRaster->getGlyphAtlas();
+	for( auto code : letters )
+		atlas.get( code );
+	Timer timer( true );
+	while( atlas.getPendingCount() > 0 && timer.getSeconds() < 5.0 ) {
+		atlas.update();
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	}
+	
+	// TYPE and delete at random on top of the current text, comparing with a layout from scratch after every edit
+	Rand rand( 1 );
+	int checks = 0, mismatches = 0, unchecked = 0;
+	auto check = [&]() {
+		int differing = mTextRaster->verify();
+		checks++;
+		if( differing < 0 )
+			unchecked++;
+		else if( differing > 0 ) {
+			mismatches++;
+			CI_LOG_W( "text surface differs from a fresh layout in " << differing << " pixels after " << checks - 1 << " edits" );
+		}
+	};
+	check();
+	for( int i = 0; i < 500; ++i ) {
+		if( mTextRaster->getLength() > 0 && rand.nextFloat() < 0.4f )
+			mTextRaster->popBack();
+		else
+			mTextRaster->append( letters[rand.nextUint( uint32_t( letters.size() ) )] );
+		check();
+	}
+	
+	// PUT BACK what was typed
+	mTextRaster->clear();
+	for( auto code : mString )
+		mTextRaster->append( code );
+	updateTextSurface();
+	
+	CI_LOG_I( "text surface check: " << mismatches << " of " << checks << " edits differ from a fresh layout, "
+			  << unchecked << " couldn't be checked" );
 }
 
 
@@ -266,29 +816,31 @@ void TextParticlesApp::keyDown( KeyEvent event )
 	switch( event.getCode() ){
 		case KeyEvent::KEY_RETURN:
 			// EXPLODE
-			setupVBO();
+			explode();
 			break;
 		
 		case KeyEvent::KEY_BACKSPACE:
-			editMode();
-	
 			// REMOVE last character
 			if( mString.length() > 0 ){
 				mString.pop_back();
+				mTextRaster->popBack();
 			}
-			drawTextToFbo();
+			updateTextSurface();
 			break;
 		
 		default:
 			if( event.isControlDown() && event.getCode() == KeyEvent::KEY_r ){
 				editMode();
 			}
-			else if( event.getChar() ){
+			else if( event.isControlDown() && event.getCode() == KeyEvent::KEY_t ){
+				checkTextSurface();
+			}
+			else if( event.getCharUtf32() ){
 				
-				editMode();
-				// ADD new character
-				mString.append( string( 1, event.getChar() ) );
-				drawTextToFbo();
+				// ADD new character, its glyph may still be on the way
+				mString.push_back( char32_t( event.getCharUtf32() ) );
+				mTextRaster->append( event.getCharUtf32() );
+				updateTextSurface();
 			}
 			
 		break;
@@ -298,28 +850,68 @@ void TextParticlesApp::keyDown( KeyEvent event )
 
 void TextParticlesApp::update()
 {
-	if( !mActive )
+	// LAY OUT characters whose glyphs came back from the atlas workers
+	if( mTextRaster->update() )
+		updateTextSurface();
+	
+	// START the image frame that's due, if a worker has it ready
+	updateImageSource();
+	
+	// once every explosion has faded out there is nothing left to simulate
+	if( mPool.empty() )
 		return;
+	
+	if( mCpuUpdate )
+		updateCpu();
+	else
+		updateGpu();
+	updateDepthSort();
+	updateRecording();
+	
+	mPool.advance( mDampingSpeed );
+	mLiveCount = mPool.getLiveCount();
+	mExplosionCount = mPool.getRanges().size();
+	mMbPerFrame = getBytesPerFrame( mLiveCount, mCompactLayout ) / ( 1024.0f * 1024.0f );
+}
+
+
+void TextParticlesApp::updateGpu()
+{
+	readUpdateTime();
 
 	// Update particles on the GPU
-	gl::ScopedGlslProg prog( mUpdateProg );
+	gl::GlslProgRef updateProg = mCompactLayout ? mUpdateCompactProg : mUpdateProg;
+	gl::ScopedGlslProg prog( updateProg );
 	gl::ScopedState rasterizer( GL_RASTERIZER_DISCARD, true );	// turn off fragment stage
 	mPerlin3dTex->bind(0);
-	mUpdateProg->uniform( "uPerlinTex", 0 );
-	mUpdateProg->uniform( "uStep", mStep.value() );
-	mUpdateProg->uniform( "uDampingSpeed", mDampingSpeed );
-	mUpdateProg->uniform( "uNoiseOffset", mNoiseOffset );
-	mUpdateProg->uniform( "uEndColor", mEndColor );
+	updateProg->uniform( "uPerlinTex", 0 );
+	updateProg->uniform( "uDampingSpeed", mDampingSpeed );
+	updateProg->uniform( "uNoiseOffset", mNoiseOffset );
+	updateProg->uniform( "uEndColor", mEndColor );
 	
 	// Bind the source data (Attributes refer to specific buffers).
 	gl::ScopedVao source( mAttributes[mSourceIndex] );
-	// Bind destination as buffer base.
-	gl::bindBufferBase( GL_TRANSFORM_FEEDBACK_BUFFER, 0, mParticleBuffer[mDestinationIndex] );
-	gl::beginTransformFeedback( GL_POINTS );
-
-	// Draw source into destination, performing our vertex transformations.
-	gl::drawArrays( GL_POINTS, 0, mTextParticleCount );
-	gl::endTransformFeedback();
+	size_t stride = mCompactLayout ? sizeof(CompactParticle) : sizeof(Particle);
+	if( ! mUpdateQueryPending )
+		glBeginQuery( GL_TIME_ELAPSED, mUpdateQuery );
+	
+	// Draw source into destination, one explosion at a time. Transform feedback writes from the start of
+	// the bound range, so each explosion binds its own range to land in the same place it was read from.
+	// Only the live particles at the front of each range are touched, the rest are already invisible.
+	const auto &ranges = mPool.getRanges();
+	for( auto iter = ranges.begin(); iter != ranges.end(); ++iter ) {
+		size_t live = iter->lifecycle.getLiveCount();
+		updateProg->uniform( "uStep", getStep( *iter ) );
+		gl::bindBufferRange( GL_TRANSFORM_FEEDBACK_BUFFER, 0, mParticleBuffer[mDestinationIndex], iter->offset * stride, live * stride );
+		gl::beginTransformFeedback( GL_POINTS );
+		gl::drawArrays( GL_POINTS, iter->offset, live );
+		gl::endTransformFeedback();
+	}
+	
+	if( ! mUpdateQueryPending ) {
+		glEndQuery( GL_TIME_ELAPSED );
+		mUpdateQueryPending = true;
+	}
 	
 	mPerlin3dTex->unbind();
 	
@@ -328,43 +920,411 @@ void TextParticlesApp::update()
 }
 
 
-void TextParticlesApp::drawTextToFbo()
+void TextParticlesApp::updateCpu()
 {
+	ParticleSolver::Params params;
+	params.dampingSpeed = mDampingSpeed;
+	params.noiseOffset = mNoiseOffset;
+	params.endColor = mEndColor;
+	
+	const auto &ranges = mPool.getRanges();
+	Timer timer( true );
+	for( auto iter = ranges.begin(); iter != ranges.end(); ++iter ) {
+		params.step = getStep( *iter );
+		mSolver.update( mCpuParticles.data() + iter->offset, iter->lifecycle.getLiveCount(), params );
+	}
+	double seconds = timer.getSeconds();
+	mUpdateMs = seconds * 1000.0;
+	mParticlesPerSec = ( seconds > 0.0 ) ? mLiveCount / seconds / 1.0e6 : 0.0f;
+	recordThroughput();
+	
+	// UPLOAD the live particles of each range into the buffer that is drawn, no transform feedback involved.
+	// One staging batch for all of them, the compact layout is packed straight into it
+	size_t stride = mCompactLayout ? sizeof(CompactParticle) : sizeof(Particle);
+	uint8_t *staging = mUploader.begin( mPool.getLiveCount() * stride );
+	if( ! staging )
+		return;
+	
+	size_t written = 0;
+	for( auto iter = ranges.begin(); iter != ranges.end(); ++iter ) {
+		size_t offset = iter->offset, live = iter->lifecycle.getLiveCount();
+		if( mCompactLayout )
+			packDynamicParticles( mCpuParticles.data() + offset, live, reinterpret_cast<CompactParticle*>( staging + written ) );
+		else
+			std::memcpy( staging + written, mCpuParticles.data() + offset, live * stride );
+		mUploader.copy( written, mParticleBuffer[mSourceIndex], offset * stride, live * stride );
+		written += live * stride;
+	}
+	mUploader.end();
+}
+
+
+void TextParticlesApp::checkSolver()
+{
+	// only the full layout runs particleUpdate.vs, the shader the solver is a port of
+	if( mCpuUpdate || mCompactLayout || mPool.empty() ) {
+		CI_LOG_W( "the solver check needs running explosions updated on the GPU, with Compact Layout off" );
+		return;
+	}
+	
+	const auto &ranges = mPool.getRanges();
+	vector<ParticleReadback::Segment> segments;
+	for( auto iter = ranges.begin(); iter != ranges.end(); ++iter ) {
+		ParticleReadback::Segment segment;
+		segment.offset = iter->offset;
+		segment.count = iter->lifecycle.getLiveCount();
+		segment.tag = iter->id;
+		segments.push_back( segment );
+	}
+	
+	// STEP the live ranges once on the GPU, same passes as updateGpu(). They go into the destination
+	// buffer without a swap, the next update overwrites it anyway
 	{
-		vec2 size = mTextFbo->getSize();
-		gl::ScopedFramebuffer scpFbo( mTextFbo );
-		gl::clear( ColorA( 0 , 0, 0, 0 ) );
-		gl::ScopedViewport scpVp( ivec2(), size );
-		gl::ScopedMatrices scpMtrx;
-		gl::ScopedColor scpCol( 1, 1, 1);
+		gl::ScopedGlslProg prog( mUpdateProg );
+		gl::ScopedState rasterizer( GL_RASTERIZER_DISCARD, true );
+		mPerlin3dTex->bind(0);
+		mUpdateProg->uniform( "uPerlinTex", 0 );
+		mUpdateProg->uniform( "uDampingSpeed", mDampingSpeed );
+		mUpdateProg->uniform( "uNoiseOffset", mNoiseOffset );
+		mUpdateProg->uniform( "uEndColor", mEndColor );
+		
+		gl::ScopedVao source( mAttributes[mSourceIndex] );
+		for( auto iter = ranges.begin(); iter != ranges.end(); ++iter ) {
+			size_t live = iter->lifecycle.getLiveCount();
+			mUpdateProg->uniform( "uStep", getStep( *iter ) );
+			gl::bindBufferRange( GL_TRANSFORM_FEEDBACK_BUFFER, 0, mParticleBuffer[mDestinationIndex], iter->offset * sizeof(Particle), live * sizeof(Particle) );
+			gl::beginTransformFeedback( GL_POINTS );
+			gl::drawArrays( GL_POINTS, iter->offset, live );
+			gl::endTransformFeedback();
+		}
+		mPerlin3dTex->unbind();
+	}
+	
+	// READ BACK the particles before and after the step. Waiting on the GPU is fine for a one off
+	ParticleReadback readback;
+	readback.request( mParticleBuffer[mSourceIndex], sizeof(Particle), segments, 0 );
+	readback.request( mParticleBuffer[mDestinationIndex], sizeof(Particle), segments, 1 );
+	glFinish();
+	
+	vector<Particle> before, after;
+	auto copyFrame = [&]( const ParticleReadback::Frame &frame ) {
+		size_t count = 0;
+		for( auto seg = frame.segments->begin(); seg != frame.segments->end(); ++seg )
+			count += seg->count;
+		const Particle *data = reinterpret_cast<const Particle*>( frame.data );
+		( frame.id == 0 ? before : after ).assign( data, data + count );
+	};
+	readback.poll( copyFrame );
+	readback.poll( copyFrame );
+	if( before.empty() || before.size() != after.size() ) {
+		CI_LOG_E( "couldn't read the particles back for the solver check" );
+		return;
+	}
+	
+	// STEP the same particles on the CPU, range by range with the same step
+	ParticleSolver::Params params;
+	params.dampingSpeed = mDampingSpeed;
+	params.noiseOffset = mNoiseOffset;
+	params.endColor = mEndColor;
+	size_t offset = 0;
+	for( auto iter = ranges.begin(); iter != ranges.end(); ++iter ) {
+		size_t live = iter->lifecycle.getLiveCount();
+		params.step = getStep( *iter );
+		mSolver.update( before.data() + offset, live, params );
+		offset += live;
+	}
+	
+	// COMPARE, the GPU filters the Perlin texture at lower precision so small differences are expected
+	float maxPos = 0.0f, maxColor = 0.0f, maxDamping = 0.0f;
+	for( size_t i = 0; i < before.size(); ++i ) {
+		const Particle &cpu = before[i], &gpu = after[i];
+		maxPos = std::max( maxPos, std::max( length( cpu.pos - gpu.pos ), length( cpu.ppos - gpu.ppos ) ) );
+		vec4 color = abs( vec4( cpu.color.r, cpu.color.g, cpu.color.b, cpu.color.a ) - vec4( gpu.color.r, gpu.color.g, gpu.color.b, gpu.color.a ) );
+		maxColor = std::max( maxColor, std::max( std::max( color.x, color.y ), std::max( color.z, color.w ) ) );
+		maxDamping = std::max( maxDamping, std::abs( cpu.damping - gpu.damping ) );
+	}
+	mSolverError = maxPos;
+	CI_LOG_I( "CPU solver vs particleUpdate.vs over " << before.size() << " particles, max error: position " << maxPos
+			  << ", color " << maxColor << ", damping " << maxDamping );
+}
+
+
+void TextParticlesApp::benchmarkSolver()
+{
+	// TIME the CPU solver on random particles from 100k to 10M, the range it's meant to keep up with
+	ParticleSolver::Params params;
+	params.dampingSpeed = mDampingSpeed;
+	params.noiseOffset = mNoiseOffset;
+	params.endColor = mEndColor;
+	Rand rand( 1 );
+	for( size_t count = 100000; count <= 10000000; count *= 10 ) {
+		vector<Particle> particles( count );
+		for( auto iter = particles.begin(); iter != particles.end(); ++iter ) {
+			iter->pos = vec3( rand.nextFloat( 0, 1280 ), rand.nextFloat( 0, 720 ), rand.nextFloat( -500, 500 ) );
+			iter->ppos = iter->pos - rand.nextVec3() * rand.nextFloat( 0, 5 );
+			iter->color = ColorA( 1, 1, 1, 1 );
+			iter->damping = rand.nextFloat( 0.5f, 1.0f );
+			iter->texcoord = vec2( rand.nextFloat(), rand.nextFloat() );
+			iter->invmass = rand.nextFloat( 0.1f, 1.0f );
+		}
+		
+		const int runs = 5;
+		Timer timer( true );
+		for( int i = 0; i < runs; ++i )
+			mSolver.update( particles.data(), count, params );
+		double seconds = timer.getSeconds() / runs;
+		CI_LOG_I( "CPU solver update of " << count << " particles: " << seconds * 1000.0 << " ms, "
+				  << count / seconds / 1.0e6 << " M particles / sec" );
+	}
+}
+
+
+void TextParticlesApp::benchmarkLayouts()
+{
+	// TIME the GPU update of 1M random particles in each layout, in buffers of their own so the running
+	// explosions aren't touched, and log it next to the bytes each layout moves a frame
+	const size_t count = 1000000;
+	const int runs = 20;
+	Rand rand( 1 );
+	vector<Particle> particles( count );
+	for( auto iter = particles.begin(); iter != particles.end(); ++iter ) {
+		iter->pos = vec3( rand.nextFloat( 0, 1280 ), rand.nextFloat( 0, 720 ), rand.nextFloat( -500, 500 ) );
+		iter->ppos = iter->pos - rand.nextVec3() * rand.nextFloat( 0, 5 );
+		iter->color = ColorA( 1, 1, 1, 1 );
+		iter->damping = rand.nextFloat( 0.5f, 1.0f );
+		iter->texcoord = vec2( rand.nextFloat(), rand.nextFloat() );
+		iter->invmass = rand.nextFloat( 0.1f, 1.0f );
+	}
+	vector<CompactParticle> dynamic;
+	vector<ParticleStatic> statics;
+	packParticles( particles, &dynamic, &statics );
+	
+	GLuint query;
+	glGenQueries( 1, &query );
+	mPerlin3dTex->bind( 0 );
+	for( int compact = 0; compact < 2; ++compact ) {
+		size_t stride = compact ? sizeof(CompactParticle) : sizeof(Particle);
+		gl::VboRef source = compact ? gl::Vbo::create( GL_ARRAY_BUFFER, dynamic, GL_STATIC_DRAW ) : gl::Vbo::create( GL_ARRAY_BUFFER, particles, GL_STATIC_DRAW );
+		gl::VboRef destination = gl::Vbo::create( GL_ARRAY_BUFFER, count * stride, nullptr, GL_DYNAMIC_DRAW );
+		gl::VboRef staticBuffer = compact ? gl::Vbo::create( GL_ARRAY_BUFFER, statics, GL_STATIC_DRAW ) : gl::VboRef();
+		gl::VaoRef attributes = createAttributes( source, staticBuffer );
 		
-		vec2 stringSize = mTextureFont->measureString( mString );
-		float descent = mTextureFont->getDescent();
-		float ascent = mTextureFont->getAscent();
-		mTextSize = stringSize + vec2( 0, descent );
+		gl::GlslProgRef updateProg = compact ? mUpdateCompactProg : mUpdateProg;
+		gl::ScopedGlslProg prog( updateProg );
+		gl::ScopedState rasterizer( GL_RASTERIZER_DISCARD, true );
+		gl::ScopedVao vao( attributes );
+		updateProg->uniform( "uPerlinTex", 0 );
+		updateProg->uniform( "uStep", mStepMax );
+		updateProg->uniform( "uDampingSpeed", mDampingSpeed );
+		updateProg->uniform( "uNoiseOffset", mNoiseOffset );
+		updateProg->uniform( "uEndColor", mEndColor );
+		gl::bindBufferBase( GL_TRANSFORM_FEEDBACK_BUFFER, 0, destination );
 		
-		// OPTIONALLY, draw the text metrics
-		/*
-		// string size - RED
-		gl::color(1, 0, 0);
-		gl::drawSolidRect( Rectf( -10, 0, stringSize.x + 10.0, stringSize.y ) );
-		// ascent - CYAN
-		gl::color(0, 1, 1);
-		gl::drawSolidRect( Rectf( 0, stringSize.y - ascent, stringSize.x, ascent ) );
-		// descent - YELLOW
-		gl::color(1, 1, 0);
-		gl::drawSolidRect( Rectf( 0, stringSize.y-descent, stringSize.x, stringSize.y ) );
-		// above ascent
-		gl::color( 0, 1, 0 );
-		gl::drawSolidRect( Rectf( 0, 0, stringSize.x, stringSize.y-ascent ) );*/
+		// the first run is left out, it pays for any setup the driver defers to the first draw
+		for( int i = 0; i <= runs; ++i ) {
+			if( i == 1 )
+				glBeginQuery( GL_TIME_ELAPSED, query );
+			gl::beginTransformFeedback( GL_POINTS );
+			gl::drawArrays( GL_POINTS, 0, GLsizei( count ) );
+			gl::endTransformFeedback();
+		}
+		glEndQuery( GL_TIME_ELAPSED );
 		
-		// DRAW string to FBO
-		gl::color(1, 1, 1);
-		mTextureFont->drawString( mString, vec2( 0, stringSize.y - descent ) );
+		// waits for the GPU, fine for a one off
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v( query, GL_QUERY_RESULT, &elapsed );
+		double seconds = elapsed / 1.0e9 / runs;
+		CI_LOG_I( ( compact ? "compact" : "full" ) << " layout update of " << count << " particles: " << seconds * 1000.0 << " ms, "
+				  << ( seconds > 0.0 ? count / seconds / 1.0e6 : 0.0 ) << " M particles / sec, "
+				  << getBytesPerFrame( count, compact != 0 ) / ( 1024.0 * 1024.0 ) << " MB per frame with the render" );
+	}
+	mPerlin3dTex->unbind();
+	glDeleteQueries( 1, &query );
+}
+
+
+void TextParticlesApp::updateDepthSort()
+{
+	if( ! mDepthSort ) {
+		mSortedRanges.clear();
+		return;
+	}
+	
+	// SORT the positions that came back from an earlier request, if they're in
+	mSortReadback.poll( [&]( const ParticleReadback::Frame &frame ) {
+		Timer timer( true );
+		mSortedRanges.clear();
+		const uint8_t *data = frame.data;
+		for( auto seg = frame.segments->begin(); seg != frame.segments->end(); ++seg ) {
+			// explosions that were evicted since the request are skipped
+			const auto &ranges = mPool.getRanges();
+			for( auto iter = ranges.begin(); iter != ranges.end(); ++iter ) {
+				if( iter->id == seg->tag )
+					sortRange( *iter, data, frame.stride, seg->count );
+			}
+			data += seg->count * frame.stride;
+		}
+		mSortMs = timer.getSeconds() * 1000.0;
+	});
+	
+	if( ++mFramesSinceSort < mSortInterval )
+		return;
+	mFramesSinceSort = 0;
+	
+	// the CPU path has the positions at hand, sort them right away
+	const auto &ranges = mPool.getRanges();
+	if( mCpuUpdate ) {
+		Timer timer( true );
+		mSortedRanges.clear();
+		for( auto iter = ranges.begin(); iter != ranges.end(); ++iter )
+			sortRange( *iter, reinterpret_cast<const uint8_t*>( mCpuParticles.data() + iter->offset ), sizeof(Particle), iter->lifecycle.getLiveCount() );
+		mSortMs = timer.getSeconds() * 1000.0;
+		return;
+	}
+	
+	// otherwise ask for the live ranges, they're sorted when they arrive a frame or two from now
+	vector<ParticleReadback::Segment> segments;
+	for( auto iter = ranges.begin(); iter != ranges.end(); ++iter ) {
+		ParticleReadback::Segment segment;
+		segment.offset = iter->offset;
+		segment.count = iter->lifecycle.getLiveCount();
+		segment.tag = iter->id;
+		segments.push_back( segment );
+	}
+	size_t stride = mCompactLayout ? sizeof(CompactParticle) : sizeof(Particle);
+	mSortReadback.request( mParticleBuffer[mSourceIndex], stride, segments, getElapsedFrames() );
+}
+
+
+void TextParticlesApp::sortRange( const ParticlePool::Range &range, const uint8_t *data, size_t stride, size_t count )
+{
+	// same model view the range is drawn with, both layouts start with the position
+	mat4 modelView = getTextureViewMatrix( mCam, getWindowSize() ) * glm::translate( vec3( range.textSize * vec2( -0.5 ), 0 ) );
+	mSorter.sort( data, stride, count, modelView, &mSortOrder );
+	
+	// UPLOAD as absolute indices into the range's own slice of the index buffer
+	for( auto iter = mSortOrder.begin(); iter != mSortOrder.end(); ++iter )
+		*iter += uint32_t( range.offset );
+	mSortIndices->bufferSubData( range.offset * sizeof(uint32_t), mSortOrder.size() * sizeof(uint32_t), mSortOrder.data() );
+	
+	SortedRange sorted;
+	sorted.rangeId = range.id;
+	sorted.count = count;
+	mSortedRanges.push_back( sorted );
+}
+
+
+void TextParticlesApp::benchmarkSort()
+{
+	// TIME the sort on random positions at growing counts, to see where the refresh interval needs to go up
+	ParticleSorter sorter;
+	vector<uint32_t> order;
+	mat4 modelView = getTextureViewMatrix( mCam, getWindowSize() );
+	Rand rand( 1 );
+	for( size_t count = 125000; count <= 2000000; count *= 2 ) {
+		vector<vec3> positions( count );
+		for( auto iter = positions.begin(); iter != positions.end(); ++iter )
+			*iter = vec3( rand.nextFloat( 0, 1280 ), rand.nextFloat( 0, 720 ), rand.nextFloat( -500, 500 ) );
+		
+		const int runs = 5;
+		Timer timer( true );
+		for( int i = 0; i < runs; ++i )
+			sorter.sort( positions.data(), sizeof(vec3), count, modelView, &order );
+		CI_LOG_I( "depth sort of " << count << " particles: " << timer.getSeconds() * 1000.0 / runs << " ms" );
+	}
+}
+
+
+void TextParticlesApp::toggleRecording()
+{
+	if( mRecording ) {
+		// a new folder per take, so takes never overwrite each other
+		fs::path directory = getDocumentsDirectory() / ( "TextParticles_" + toString( time( nullptr ) ) );
+		mReadbacksSkipped = 0;
+		mRecorder.start( directory, ParticleRecorder::Format( mRecordFormat ) );
+		mRecording = mRecorder.isRecording();
+	}
+	else {
+		mRecordReadback.clear();
+		mRecordTranslates.clear();
+		// waits for the few frames still queued, only when stopping
+		mRecorder.stop();
+	}
+}
+
+
+void TextParticlesApp::updateRecording()
+{
+	if( ! mRecorder.isRecording() )
+		return;
+	
+	// the same translation every explosion is drawn with, so the frames match what's on screen
+	const auto &ranges = mPool.getRanges();
+	vector<vec3> translates;
+	for( auto iter = ranges.begin(); iter != ranges.end(); ++iter )
+		translates.push_back( vec3( iter->textSize * vec2( -0.5 ), 0 ) );
+	
+	if( mCpuUpdate ) {
+		// the particles are already on the CPU, the recorder copies them right away
+		vector<ParticleRecorder::Run> runs;
+		size_t i = 0;
+		for( auto iter = ranges.begin(); iter != ranges.end(); ++iter, ++i ) {
+			ParticleRecorder::Run run;
+			run.data = reinterpret_cast<const uint8_t*>( mCpuParticles.data() + iter->offset );
+			run.count = iter->lifecycle.getLiveCount();
+			run.translate = translates[i];
+			runs.push_back( run );
+		}
+		mRecorder.addFrame( getElapsedFrames(), runs, sizeof(Particle), false );
+	}
+	else {
+		// WRITE the copy that came back from an earlier frame, it's handed to the writer thread as is
+		bool consumed = mRecordReadback.poll( [&]( const ParticleReadback::Frame &frame ) {
+			const vector<vec3> &frameTranslates = mRecordTranslates.front();
+			vector<ParticleRecorder::Run> runs;
+			const uint8_t *data = frame.data;
+			for( size_t i = 0; i < frame.segments->size(); ++i ) {
+				ParticleRecorder::Run run;
+				run.data = data;
+				run.count = (*frame.segments)[i].count;
+				run.translate = frameTranslates[i];
+				runs.push_back( run );
+				data += run.count * frame.stride;
+			}
+			mRecorder.addFrame( uint32_t( frame.id ), runs, frame.stride, frame.stride == sizeof(CompactParticle) );
+		});
+		if( consumed )
+			mRecordTranslates.pop_front();
+		
+		// REQUEST this frame's copy, it's ready to map a frame or two from now
+		vector<ParticleReadback::Segment> segments;
+		for( auto iter = ranges.begin(); iter != ranges.end(); ++iter ) {
+			ParticleReadback::Segment segment;
+			segment.offset = iter->offset;
+			segment.count = iter->lifecycle.getLiveCount();
+			segment.tag = iter->id;
+			segments.push_back( segment );
+		}
+		size_t stride = mCompactLayout ? sizeof(CompactParticle) : sizeof(Particle);
+		if( mRecordReadback.request( mParticleBuffer[mSourceIndex], stride, segments, getElapsedFrames() ) )
+			mRecordTranslates.push_back( translates );
+		else
+			mReadbacksSkipped++;
 	}
 	
-	// GET Texture from FBO
-	mTextSurf = Surface( mTextFbo->readPixels8u( mTextFbo->getBounds() ) );
+	mFramesRecorded = mRecorder.getWrittenCount();
+	mFramesDropped = mRecorder.getDroppedCount() + mReadbacksSkipped;
+}
+
+
+void TextParticlesApp::updateTextSurface()
+{
+	// the rasterizer already changed only the glyphs that were touched, just upload the result
+	mTextSize = mTextRaster->getTextSize();
+	if( ! mTextTex )
+		mTextTex = gl::Texture::create( mTextRaster->getSurface() );
+	else
+		mTextTex->update( mTextRaster->getSurface() );
 }
 
 
@@ -374,9 +1334,16 @@ void TextParticlesApp::lookAtTexture( const CameraPersp &cam, const ci::vec2 &si
 	auto ctx = gl::context();
 	ctx->getModelMatrixStack().back() = mat4();
 	ctx->getProjectionMatrixStack().back() = cam.getProjectionMatrix();
-	ctx->getViewMatrixStack().back() = cam.getViewMatrix();
-	ctx->getViewMatrixStack().back() *= glm::scale( vec3( 1, -1, 1 ) );									// invert Y axis so increasing Y goes down.
-	ctx->getViewMatrixStack().back() *= glm::translate( vec3( size.x / 2, (float) - size.y / 2, 0 ) );	// shift origin up to upper-left corner.
+	ctx->getViewMatrixStack().back() = getTextureViewMatrix( cam, size );
+}
+
+
+mat4 TextParticlesApp::getTextureViewMatrix( const CameraPersp &cam, const ci::vec2 &size ) const
+{
+	mat4 view = cam.getViewMatrix();
+	view *= glm::scale( vec3( 1, -1, 1 ) );									// invert Y axis so increasing Y goes down.
+	view *= glm::translate( vec3( size.x / 2, (float) - size.y / 2, 0 ) );	// shift origin up to upper-left corner.
+	return view;
 }
 
 
@@ -392,30 +1359,152 @@ void TextParticlesApp::draw()
 		// SET matrices so that by default, we are looking at a rect the size of the window
 		lookAtTexture( mCam, getWindowSize() );
 		
-		gl::translate( mTextSize * vec2( -0.5 ) );
-		
 		gl::ScopedDepth scpDepth(	true );
 //		gl::ScopedColor scpColor( 1, 0, 0 );
 //		gl::drawStrokedRect( Rectf( 0, 0, mTextSize.x, mTextSize.y ) );
 		
 		gl::color( Color::white() );
-		if( mActive ){
+		if( ! mPool.empty() ) {
 			gl::ScopedGlslProg render( mRenderProg );
 			gl::ScopedVao vao( mAttributes[mSourceIndex] );
-			gl::context()->setDefaultShaderVars();
-			gl::drawArrays( GL_POINTS, 0, mTextParticleCount );
-			
-		}else{
-			if( mString.length() > 0 )
-				gl::draw( mTextFbo->getColorTexture() );
+			gl::ScopedBuffer indices( mSortIndices );
+			const auto &ranges = mPool.getRanges();
+			for( auto iter = ranges.begin(); iter != ranges.end(); ++iter ) {
+				// each explosion is centered on the text it came from
+				gl::ScopedModelMatrix model;
+				gl::translate( iter->textSize * vec2( -0.5 ) );
+				gl::context()->setDefaultShaderVars();
+				// sparser particles are drawn bigger so the text keeps its weight
+				gl::pointSize( iter->pointSize );
+				
+				// DRAW back to front when there is an order for this explosion, in buffer order otherwise
+				const SortedRange *sorted = nullptr;
+				for( auto s = mSortedRanges.begin(); s != mSortedRanges.end(); ++s ) {
+					if( s->rangeId == iter->id )
+						sorted = &*s;
+				}
+				if( sorted )
+					gl::drawElements( GL_POINTS, sorted->count, GL_UNSIGNED_INT, (const GLvoid*)( iter->offset * sizeof(uint32_t) ) );
+				else
+					gl::drawArrays( GL_POINTS, iter->offset, iter->lifecycle.getLiveCount() );
+			}
+			gl::pointSize( 1.0f );
 		}
 		
+		// the word being typed sits on top of the explosions that are still running
+		if( mString.length() > 0 ) {
+			gl::ScopedModelMatrix model;
+			gl::translate( mTextSize * vec2( -0.5 ) );
+			gl::draw( mTextTex );
+		}
 	}
 	
 	mParams->draw();
 }
 
+void TextParticlesApp::cleanup()
+{
+	// KEEP every glyph rasterized this run for the next launch
+	if( mTextRaster && mTextRaster->getGlyphAtlas().save() )
+		CI_LOG_I( "saved " << mTextRaster->getGlyphAtlas().getGlyphCount() << " glyphs" );
+}
+
+
+//! Lays a few fixed strings out with TextRasterizer and compares the alpha of each with the image checked in under
+//! assets/golden, or writes those images when \a write is set. Glyphs are rasterized on the CPU, so neither a
+//! window nor a GL context is needed. Returns false if any string is missing its golden or differs from it.
+static bool runTextGoldens( const ivec2 &surfaceSize, bool write )
+{
+	const u32string strings[] = { U"Cinder", U"AVWTfij.,'", U"particles 1234567890" };
+	const int TOLERANCE = 1;	// levels of alpha a pixel may be off by before it counts as differing
+	
+	fs::path fontPath = getAssetPath( "SourceSansPro-Bold.ttf" );
+	if( fontPath.empty() ) {
+		CI_LOG_E( "can't find the font for the text goldens" );
+		return false;
+	}
+	Font font( loadFile( fontPath ), 120 );
+	fs::path directory = fontPath.parent_path() / "golden";
+	if( write )
+		fs::create_directories( directory );
+	
+	bool passed = true;
+	for( size_t i = 0; i < sizeof( strings ) / sizeof( strings[0] ); ++i ) {
+		// LAY OUT with no glyph cache, so the font itself is what's being checked
+		TextRasterizer raster( font, surfaceSize );
+		for( auto code : strings[i] )
+			raster.append( code );
+		Timer timer( true );
+		while( raster.getPendingCount() > 0 && timer.getSeconds() < 5.0 ) {
+			raster.update();
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+		}
+		fs::path path = directory / ( "text_" + toString( i ) + ".png" );
+		if( raster.getPendingCount() > 0 ) {
+			CI_LOG_E( "glyphs for " << path.filename().string() << " never arrived" );
+			passed = false;
+			continue;
+		}
+		
+		// CROP to the text, the rest of the surface is empty
+		vec2 textSize = raster.getTextSize();
+		Area area( 0, 0, std::min( int( ceil( textSize.x ) ), surfaceSize.x ), std::min( int( ceil( textSize.y ) ), surfaceSize.y ) );
+		Surface8u text = raster.getSurface().clone( area );
+		if( write ) {
+			writeImage( path, text.getChannelAlpha() );
+			CI_LOG_I( "wrote " << path.string() );
+			continue;
+		}
+		
+		if( ! fs::exists( path ) ) {
+			CI_LOG_E( "no golden " << path.string() << ", write them with --write-text-goldens" );
+			passed = false;
+			continue;
+		}
+		Channel8u golden( loadImage( path ) );
+		if( golden.getWidth() != text.getWidth() || golden.getHeight() != text.getHeight() ) {
+			CI_LOG_E( path.filename().string() << " is " << golden.getWidth() << "x" << golden.getHeight() << ", the text is "
+					  << text.getWidth() << "x" << text.getHeight() );
+			passed = false;
+			continue;
+		}
+		
+		// COMPARE alpha, glyph edges may be a level off between font renderer versions
+		int differing = 0, maxDiff = 0;
+		uint8_t inc = text.getPixelInc();
+		uint8_t a = text.getAlphaOffset();
+		for( int y = 0; y < text.getHeight(); ++y ) {
+			const uint8_t *actual = text.getData( ivec2( 0, y ) );
+			const uint8_t *expected = golden.getData( ivec2( 0, y ) );
+			for( int x = 0; x < text.getWidth(); ++x, actual += inc, expected += golden.getIncrement() ) {
+				int diff = std::abs( int( actual[a] ) - int( *expected ) );
+				maxDiff = std::max( maxDiff, diff );
+				differing += ( diff > TOLERANCE ) ? 1 : 0;
+			}
+		}
+		if( differing > 0 ) {
+			CI_LOG_E( path.filename().string() << " differs in " << differing << " pixels, by up to " << maxDiff );
+			passed = false;
+		}
+		else
+			CI_LOG_I( path.filename().string() << " matches" );
+	}
+	return passed;
+}
+
 
 CINDER_APP( TextParticlesApp, RendererGl, [] ( App::Settings *settings ) {
 	settings->setWindowSize( 1280, 720 );
+	
+	// HEADLESS text goldens, `TextParticles --check-text-goldens` or `--write-text-goldens` to replace them. Runs
+	// before the app or its window exist, on a surface the size of the default window, then quits.
+	const auto &args = settings->getCommandLineArgs();
+	bool check = find( args.begin(), args.end(), "--check-text-goldens" ) != args.end();
+	bool write = find( args.begin(), args.end(), "--write-text-goldens" ) != args.end();
+	if( check || write ) {
+		bool passed = runTextGoldens( settings->getWindowSize(), write );
+		if( ! write )
+			CI_LOG_I( "text goldens " << ( passed ? "passed" : "FAILED" ) );
+		settings->setShouldQuit();
+	}
 }  )
@@ -0,0 +1,181 @@
+//
+//  TextRasterizer.cpp
+//  TextParticles
+//
+
+#include "TextRasterizer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+using namespace std;
+
+// -------------------------------------------------------------------------------------------------
+// TextRasterizer
+// -------------------------------------------------------------------------------------------------
+TextRasterizer::TextRasterizer( const Font &font, const ivec2 &surfaceSize, const fs::path &cacheFile )
+: mAtlas( font, cacheFile ), mSurface( surfaceSize.x, surfaceSize.y, true ), mPen( 0.0f ),
+	mLineHeight( font.getAscent() + font.getDescent() )
+{
+	clear();
+}
+
+void TextRasterizer::append( uint32_t code )
+{
+	mCodes.push_back( code );
+	layout();
+}
+
+bool TextRasterizer::update()
+{
+	if( ! mAtlas.update() || mPens.size() == mCodes.size() )
+		return false;
+	
+	size_t laidOut = mPens.size();
+	layout();
+	return mPens.size() != laidOut;
+}
+
+void TextRasterizer::layout()
+{
+	// STOP at the first glyph that isn't ready, the ones after it wait their turn
+	while( mPens.size() < mCodes.size() ) {
+		const Glyph *glyph = mAtlas.get( mCodes[mPens.size()] );
+		if( ! glyph )
+			break;
+		
+		mPens.push_back( mPen );
+		mWidths.push_back( glyph->bounds.getWidth() );
+		blit( *glyph, mPen );
+		mPen += glyph->advance;
+		mLineHeight = std::max( mLineHeight, float( glyph->bounds.getHeight() ) );
+	}
+}
+
+void TextRasterizer::popBack()
+{
+	if( mCodes.empty() )
+		return;
+	
+	mCodes.pop_back();
+	// nothing was drawn for it yet
+	if( mPens.size() <= mCodes.size() )
+		return;
+	
+	// CLEAR what the last glyph covered
+	int x1 = int( floor( mPens.back() ) );
+	clearColumns( x1, x1 + mWidths.back() );
+	mPen = mPens.back();
+	mPens.pop_back();
+	mWidths.pop_back();
+	
+	// REDRAW the neighbors that reached into the cleared columns. Blits take the max, so
+	// laying them out again only fills back in what was cleared
+	size_t first = mPens.size();
+	for( size_t i = 0; i < mPens.size(); ++i ) {
+		if( int( floor( mPens[i] ) ) + mWidths[i] > x1 ) {
+			first = i;
+			break;
+		}
+	}
+	if( first < mPens.size() ) {
+		mPen = mPens[first];
+		mPens.resize( first );
+		mWidths.resize( first );
+		layout();
+	}
+}
+
+int TextRasterizer::verify()
+{
+	// SET ASIDE the incremental result and lay the same characters out on a blank surface
+	Surface8u incremental = mSurface.clone();
+	vector<uint32_t> codes = mCodes;
+	vector<float> pens = mPens;
+	vector<int> widths = mWidths;
+	float pen = mPen, lineHeight = mLineHeight;
+	
+	clear();
+	mCodes.assign( codes.begin(), codes.begin() + pens.size() );
+	layout();
+	
+	int differing = -1;
+	if( mPens.size() == pens.size() ) {
+		differing = 0;
+		uint8_t inc = mSurface.getPixelInc();
+		uint8_t a = mSurface.getAlphaOffset();
+		for( int y = 0; y < mSurface.getHeight(); ++y ) {
+			const uint8_t *fresh = mSurface.getData( ivec2( 0, y ) );
+			const uint8_t *built = incremental.getData( ivec2( 0, y ) );
+			for( int x = 0; x < mSurface.getWidth(); ++x, fresh += inc, built += inc )
+				differing += ( fresh[a] != built[a] ) ? 1 : 0;
+		}
+	}
+	
+	// PUT BACK the incremental state, including characters still waiting for their glyphs
+	mSurface = incremental;
+	mCodes = codes;
+	mPens = pens;
+	mWidths = widths;
+	mPen = pen;
+	mLineHeight = lineHeight;
+	return differing;
+}
+
+void TextRasterizer::clear()
+{
+	mCodes.clear();
+	mPens.clear();
+	mWidths.clear();
+	mPen = 0.0f;
+	
+	// white everywhere, transparent until a glyph is written
+	uint8_t inc = mSurface.getPixelInc();
+	uint8_t r = mSurface.getRedOffset(), g = mSurface.getGreenOffset(), b = mSurface.getBlueOffset(), a = mSurface.getAlphaOffset();
+	for( int y = 0; y < mSurface.getHeight(); ++y ) {
+		uint8_t *pixel = mSurface.getData( ivec2( 0, y ) );
+		for( int x = 0; x < mSurface.getWidth(); ++x, pixel += inc ) {
+			pixel[r] = pixel[g] = pixel[b] = 255;
+			pixel[a] = 0;
+		}
+	}
+}
+
+void TextRasterizer::blit( const Glyph &glyph, float x )
+{
+	int w = glyph.bounds.getWidth();
+	int left = int( floor( x ) );
+	int x1 = std::max( left, 0 );
+	int x2 = std::min( left + w, mSurface.getWidth() );
+	int h = std::min( glyph.bounds.getHeight(), mSurface.getHeight() );
+	if( x1 >= x2 )
+		return;
+	
+	// MAX keeps overlapping glyphs from cutting into each other
+	uint8_t inc = mSurface.getPixelInc();
+	uint8_t a = mSurface.getAlphaOffset();
+	int pageSize = mAtlas.getPageSize();
+	const uint8_t *page = mAtlas.getPageData( glyph.page ) + glyph.bounds.y1 * pageSize + glyph.bounds.x1;
+	for( int y = 0; y < h; ++y ) {
+		uint8_t *pixel = mSurface.getData( ivec2( x1, y ) );
+		const uint8_t *coverage = page + y * pageSize + ( x1 - left );
+		for( int px = x1; px < x2; ++px, pixel += inc, ++coverage )
+			pixel[a] = std::max( pixel[a], *coverage );
+	}
+}
+
+void TextRasterizer::clearColumns( int x1, int x2 )
+{
+	x1 = std::max( x1, 0 );
+	x2 = std::min( x2, mSurface.getWidth() );
+	if( x1 >= x2 )
+		return;
+	
+	uint8_t inc = mSurface.getPixelInc();
+	uint8_t a = mSurface.getAlphaOffset();
+	for( int y = 0; y < mSurface.getHeight(); ++y ) {
+		uint8_t *pixel = mSurface.getData( ivec2( x1, y ) );
+		for( int px = x1; px < x2; ++px, pixel += inc )
+			pixel[a] = 0;
+	}
+}